@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "textErr.h"
+#include "fileMap.h"
+#include "textMan.h"
+
+#define OPTIONAL_ARGS \
+    OPTIONAL_SIZE_ARG(max_mb, (size_t)64, "--max-mb", "MiB", "Largest generated input") \
+    OPTIONAL_STRING_ARG(only, "", "--only", "name", "Run only cases whose name contains this") \
+    OPTIONAL_STRING_ARG(dir, "/tmp", "--dir", "path", "Where to write the generated inputs") \
+
+#include "easyargs.h"
+
+// how long a case repeats its operation for, at least once
+#define BENCH_BUDGET_NS ((uint64_t)300 * 1000000)
+// lines scrolled in one direction per sweep
+#define BENCH_SCROLL_MAX ((size_t)100000)
+// viewport height; a screen holds only a sliver of one 1 MiB line, so the
+// long-lines input gets a couple of lines
+#define BENCH_VIEWLINES 50
+#define BENCH_VIEWLINES_LONG 2
+// line length of the long-lines input, line break included
+#define BENCH_LONG_LINE ((size_t)1 << 20)
+
+typedef enum {
+
+    BENCH_CODE = 0,
+    BENCH_LONG,
+    BENCH_BINARY,
+    BENCH_KINDS
+
+} bench_kind;
+
+static const char* const bench_kind_names[BENCH_KINDS] = { "code", "long", "binary" };
+
+typedef struct {
+
+    bench_kind kind;
+    size_t size;
+    char path[512];
+
+} bench_input;
+
+// what a case measured: `ops` operations in `ns`, moving `bytes` bytes of
+// text (0 where throughput means nothing)
+typedef struct {
+
+    size_t ops;
+    uint64_t ns;
+    size_t bytes;
+
+} bench_result;
+
+typedef textErr (*bench_run)(const bench_input* in, bench_result* out);
+
+typedef struct {
+
+    const char* name;
+    bench_run run;
+
+} bench_case;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_rand_state = 0x9e3779b97f4a7c15ULL;
+
+// xorshift, seeded the same every run so inputs are identical across builds
+static uint64_t bench_rand(void) {
+    uint64_t x = bench_rand_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    bench_rand_state = x;
+    return x;
+}
+
+/* INPUTS */
+
+// fill `buf` with `len` bytes of the given kind, carrying the column of
+// the line being written across calls. code is short, partly indented lines,
+// long is 1 MiB lines and binary is random bytes (so a line break every 256
+// bytes on average, and NULs).
+static void bench_fill(bench_kind kind, char* buf, size_t len, size_t* column) {
+
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz_(){};=+*, 0123456789";
+
+    for ( size_t i = 0; i < len; i++ ) {
+
+        char c = alphabet[bench_rand() % (sizeof(alphabet) - 1)];
+
+        if ( kind == BENCH_BINARY ) {
+            c = (char)(bench_rand() & 0xff);
+        } else if ( kind == BENCH_LONG && *column == BENCH_LONG_LINE - 1 ) {
+            c = '\n';
+        } else if ( kind == BENCH_CODE && *column > 0 && bench_rand() % 40 == 0 ) {
+            c = '\n';
+        } else if ( kind == BENCH_CODE && *column < 8 && bench_rand() % 3 == 0 ) {
+            c = ' ';
+        }
+
+        buf[i] = c;
+        *column = c == '\n' ? 0 : *column + 1;
+
+    }
+
+}
+
+// write the input to disk a block at a time, so the parent process (and the
+// children forked off it) stays small
+static textErr bench_generate(bench_input* in, const char* dir) {
+
+    snprintf(in->path, sizeof(in->path), "%s/%s-%zu.txt", dir, bench_kind_names[in->kind], in->size);
+
+    FILE* fp = fopen(in->path, "wb");
+    if ( fp == NULL ) { return ERR_IO; }
+
+    char* block = (char*)malloc((size_t)1 << 20);
+    if ( block == NULL ) {
+        fclose(fp);
+        return ERR_MEM;
+    }
+
+    size_t column = 0;
+    size_t left = in->size;
+    while ( left > 0 ) {
+        size_t n = left < ((size_t)1 << 20) ? left : ((size_t)1 << 20);
+        bench_fill(in->kind, block, n, &column);
+        if ( fwrite(block, 1, n, fp) != n ) { break; }
+        left -= n;
+    }
+
+    free(block);
+    if ( fclose(fp) != 0 || left > 0 ) { return ERR_IO; }
+
+    return ERR_NONE;
+
+}
+
+static size_t bench_viewlines(const bench_input* in) {
+    return in->kind == BENCH_LONG ? BENCH_VIEWLINES_LONG : BENCH_VIEWLINES;
+}
+
+static textErr bench_open(const bench_input* in, size_t viewlines, filebuf** fb) {
+
+    filemap* map = NULL;
+    textErr ret = filemap_open(&map, in->path);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = filebuf_init(fb, viewlines);
+    if ( ret == ERR_NONE ) { ret = filebuf_load(fb, map, in->path); }
+    if ( ret != ERR_NONE ) { filemap_close(&map); }
+
+    return ret;
+
+}
+
+/* CASES */
+
+// linebuf_parse of the whole input into a fresh view. it stops at the first
+// NUL, so binary inputs only parse up to there.
+static textErr bench_parse(const bench_input* in, bench_result* out) {
+
+    FILE* fp = fopen(in->path, "rb");
+    if ( fp == NULL ) { return ERR_IO; }
+
+    char* text = (char*)malloc(in->size + 1);
+    if ( text == NULL ) {
+        fclose(fp);
+        return ERR_MEM;
+    }
+    size_t got = fread(text, 1, in->size, fp);
+    fclose(fp);
+    text[got] = '\0';
+
+    uint64_t start = bench_now_ns();
+    textErr ret = ERR_NONE;
+
+    for ( size_t round = 0; ret == ERR_NONE && (round == 0 || bench_now_ns() - start < BENCH_BUDGET_NS); round++ ) {
+
+        viewbuf* view = NULL;
+        ret = viewbuf_init(&view, 64);
+        if ( ret != ERR_NONE ) { break; }
+
+        size_t chars = 0;
+        uint64_t t = bench_now_ns();
+        ret = linebuf_parse(&view, text, SIZE_MAX, &chars);
+        out->ns += bench_now_ns() - t;
+        out->ops += view->lines;
+        out->bytes += chars;
+
+        viewbuf_destroy(&view);
+
+    }
+
+    free(text);
+
+    return ret;
+
+}
+
+// mapping the file and filling the first screen
+static textErr bench_load(const bench_input* in, bench_result* out) {
+
+    uint64_t start = bench_now_ns();
+    textErr ret = ERR_NONE;
+
+    while ( ret == ERR_NONE && (out->ops == 0 || bench_now_ns() - start < BENCH_BUDGET_NS) ) {
+
+        filebuf* fb = NULL;
+        uint64_t t = bench_now_ns();
+        ret = bench_open(in, bench_viewlines(in), &fb);
+        out->ns += bench_now_ns() - t;
+        out->ops += 1;
+
+        if ( fb != NULL ) { filebuf_destroy(&fb); }
+
+    }
+
+    return ret;
+
+}
+
+// load until the background line index is done and the total is known
+static textErr bench_index(const bench_input* in, bench_result* out) {
+
+    uint64_t start = bench_now_ns();
+    textErr ret = ERR_NONE;
+
+    while ( ret == ERR_NONE && (out->ops == 0 || bench_now_ns() - start < BENCH_BUDGET_NS) ) {
+
+        filebuf* fb = NULL;
+        uint64_t t = bench_now_ns();
+        ret = bench_open(in, bench_viewlines(in), &fb);
+
+        size_t lines = 0;
+        while ( ret == ERR_NONE && (ret = filebuf_line_count(&fb, &lines)) == ERR_BUSY ) {
+            ret = ERR_NONE;
+            usleep(200);
+        }
+        out->ns += bench_now_ns() - t;
+        out->ops += 1;
+        out->bytes += in->size;
+
+        if ( fb != NULL ) { filebuf_destroy(&fb); }
+
+    }
+
+    return ret;
+
+}
+
+// growing and shrinking the viewport between the usual height and four
+// times that
+static textErr bench_resize(const bench_input* in, bench_result* out) {
+
+    const size_t small = bench_viewlines(in);
+    filebuf* fb = NULL;
+    textErr ret = bench_open(in, small, &fb);
+
+    uint64_t start = bench_now_ns();
+    while ( ret == ERR_NONE && bench_now_ns() - start < BENCH_BUDGET_NS ) {
+
+        fb->viewlines = fb->viewlines == small ? 4 * small : small;
+        uint64_t t = bench_now_ns();
+        ret = filebuf_resize(&fb);
+        out->ns += bench_now_ns() - t;
+        out->ops += 1;
+
+    }
+
+    if ( fb != NULL ) { filebuf_destroy(&fb); }
+
+    return ret;
+
+}
+
+// scroll down through the file a line at a time and back up again
+static textErr bench_scroll(const bench_input* in, bench_result* out) {
+
+    filebuf* fb = NULL;
+    textErr ret = bench_open(in, bench_viewlines(in), &fb);
+
+    uint64_t start = bench_now_ns();
+    while ( ret == ERR_NONE && (out->ops == 0 || bench_now_ns() - start < BENCH_BUDGET_NS) ) {
+
+        size_t steps = 0;
+        size_t before = fb->prewindow_len;
+        uint64_t t = bench_now_ns();
+        while ( steps < BENCH_SCROLL_MAX && (ret = filebuf_scroll_down(&fb)) == ERR_NONE ) {
+            steps += 1;
+            if ( (steps & 1023) == 0 && bench_now_ns() - start > BENCH_BUDGET_NS ) { break; }
+        }
+        if ( ret == ERR_EOF ) { ret = ERR_NONE; }
+        size_t moved = fb->prewindow_len - before;
+
+        for ( size_t i = 0; i < steps && ret == ERR_NONE; i++ ) {
+            ret = filebuf_scroll_up(&fb);
+        }
+        out->ns += bench_now_ns() - t;
+
+        // a file no taller than the viewport has nothing to scroll
+        if ( steps == 0 ) { break; }
+        out->ops += 2 * steps;
+        out->bytes += 2 * moved;
+
+    }
+
+    if ( fb != NULL ) { filebuf_destroy(&fb); }
+
+    return ret;
+
+}
+
+// typing and deleting a byte, then splitting and joining a line, at random
+// places in the viewport
+static textErr bench_edit(const bench_input* in, bench_result* out) {
+
+    filebuf* fb = NULL;
+    textErr ret = bench_open(in, bench_viewlines(in), &fb);
+
+    uint64_t start = bench_now_ns();
+    while ( ret == ERR_NONE && fb->view->lines > 0 && bench_now_ns() - start < BENCH_BUDGET_NS ) {
+
+        size_t line = bench_rand() % fb->view->lines;
+        linebuf* lb = viewbuf_line(fb->view, line);
+        size_t width = lb->len - (lb->len > 0 && lb->line[lb->len - 1] == '\n' ? 1 : 0);
+        size_t pos = bench_rand() % (width + 1);
+        const char* text = (out->ops & 2) ? "\n" : "x";
+
+        uint64_t t = bench_now_ns();
+        ret = filebuf_insert(&fb, line, pos, text, 1);
+        if ( ret == ERR_NONE ) { ret = filebuf_erase(&fb, line, pos, 1); }
+        out->ns += bench_now_ns() - t;
+        out->ops += 2;
+
+    }
+
+    if ( fb != NULL ) { filebuf_destroy(&fb); }
+
+    return ret;
+
+}
+
+static const bench_case bench_cases[] = {
+    { "parse", bench_parse },
+    { "load", bench_load },
+    { "index", bench_index },
+    { "resize", bench_resize },
+    { "scroll", bench_scroll },
+    { "edit", bench_edit },
+};
+
+/* DRIVER */
+
+static void bench_size_str(char* buf, size_t buflen, double bytes) {
+    if ( bytes >= (double)(1 << 20) ) {
+        snprintf(buf, buflen, "%.1f MiB", bytes / (double)(1 << 20));
+    } else {
+        snprintf(buf, buflen, "%.0f KiB", bytes / 1024.0);
+    }
+}
+
+// run one case in a child of its own, so the peak RSS it reports is its own
+// and a crash takes down only that line of the report
+static int bench_one(const bench_case* c, const bench_input* in) {
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if ( pid < 0 ) { return 1; }
+
+    if ( pid == 0 ) {
+
+        bench_result res = { 0 };
+        textErr ret = c->run(in, &res);
+
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+
+        char size[32];
+        char rss[32];
+        char rate[32] = "-";
+        char per[32] = "-";
+        bench_size_str(size, sizeof(size), (double)in->size);
+        bench_size_str(rss, sizeof(rss), (double)ru.ru_maxrss * 1024.0);
+        if ( res.ops > 0 ) { snprintf(per, sizeof(per), "%.1f", (double)res.ns / (double)res.ops); }
+        if ( res.bytes > 0 && res.ns > 0 ) {
+            snprintf(rate, sizeof(rate), "%.1f", (double)res.bytes / (double)(1 << 20) / ((double)res.ns / 1e9));
+        }
+
+        if ( ret != ERR_NONE ) {
+            printf("%-8s %-7s %10s  failed: %s\n", c->name, bench_kind_names[in->kind], size, textErr_tostr(ret));
+        } else {
+            printf("%-8s %-7s %10s %10zu %12s %10s %11s\n", c->name, bench_kind_names[in->kind], size, res.ops, per, rate, rss);
+        }
+
+        fflush(stdout);
+        _exit(ret == ERR_NONE ? 0 : 1);
+
+    }
+
+    int status = 0;
+    if ( waitpid(pid, &status, 0) < 0 ) { return 1; }
+    if ( WIFSIGNALED(status) ) {
+        printf("%-8s %-7s  killed by signal %d\n", c->name, bench_kind_names[in->kind], WTERMSIG(status));
+        return 1;
+    }
+
+    return WEXITSTATUS(status) != 0;
+
+}
+
+int main(int argc, char** argv) {
+
+    args_t args = make_default_args();
+
+    if (!parse_args(argc, argv, &args)) {
+        return 1;
+    }
+
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s/textbench-XXXXXX", args.dir);
+    if ( mkdtemp(dir) == NULL ) {
+        printf("Failed to create a directory in <%s>\n", args.dir);
+        return 1;
+    }
+
+    // three sizes per kind, a factor of 16 apart, up to --max-mb
+    const size_t max = args.max_mb << 20;
+    const size_t sizes[] = { (size_t)256 << 10, (size_t)4 << 20, (size_t)64 << 20, (size_t)1 << 30 };
+
+    printf("%-8s %-7s %10s %10s %12s %10s %11s\n", "case", "input", "size", "ops", "ns/op", "MB/s", "peak RSS");
+
+    int failed = 0;
+    for ( int kind = 0; kind < BENCH_KINDS; kind++ ) {
+        for ( size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= max; s++ ) {
+
+            bench_input in = { .kind = (bench_kind)kind, .size = sizes[s] };
+
+            // a 1 MiB line needs a few of them to make a file
+            if ( in.kind == BENCH_LONG && in.size < ((size_t)4 << 20) ) { continue; }
+
+            textErr ret = bench_generate(&in, dir);
+            if ( ret != ERR_NONE ) {
+                printf("Failed to write <%s>, reason: %s\n", in.path, textErr_tostr(ret));
+                failed = 1;
+                break;
+            }
+
+            for ( size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++ ) {
+                if ( strstr(bench_cases[i].name, args.only) == NULL ) { continue; }
+                failed |= bench_one(&bench_cases[i], &in);
+            }
+
+            unlink(in.path);
+
+        }
+    }
+
+    rmdir(dir);
+
+    return failed;
+
+}
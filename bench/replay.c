@@ -0,0 +1,440 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "textErr.h"
+#include "fileMap.h"
+#include "frameStats.h"
+#include "termScreen.h"
+#include "textMan.h"
+#include "windowMan.h"
+
+#define OPTIONAL_ARGS \
+    OPTIONAL_STRING_ARG(input, "", "--input", "path", "File to edit; a generated C file when empty") \
+    OPTIONAL_STRING_ARG(script, "", "--script", "path", "Key script; the built-in one when empty") \
+    OPTIONAL_SIZE_ARG(lines, (size_t)200000, "--lines", "n", "Lines in the generated file") \
+    OPTIONAL_SIZE_ARG(rows, (size_t)50, "--rows", "n", "Screen height") \
+    OPTIONAL_SIZE_ARG(cols, (size_t)120, "--cols", "n", "Screen width") \
+
+#define BOOLEAN_ARGS \
+    BOOLEAN_ARG(dump, "--dump", "Print the screen after the script") \
+    BOOLEAN_ARG(stats, "--stats", "Show the frame cost display and print its summary") \
+
+#include "easyargs.h"
+
+// a script is one command per line, '#' starts a comment:
+//   <key> [count]    press a key, count times; keys are up, down, left,
+//                    right, pageup, pagedown, home, end, enter, backspace,
+//                    delete, esc and ctrl-<letter>
+//   type <text>      type the rest of the line, a key at a time
+//   goto <target>    ctrl+g and the target as one keystroke, e.g. 50%
+//   resize <r> <c>   change the screen size
+//   paste <bytes>    paste that much generated C at the cursor, as a
+//                    terminal with bracketed paste would send it
+//   burst <command>  queue all the keys of a key or type command at once,
+//                    as a fast typist or a key repeat would, and time the
+//                    frames it takes to catch up as one
+// each command is reported on a line of its own.
+static const char replay_default_script[] =
+    "down 3000\n"
+    "up 3000\n"
+    "goto 50%\n"
+    "right 80\n"
+    "left 80\n"
+    "type static int replayed = 0; /* typed */\n"
+    "enter 40\n"
+    "backspace 40\n"
+    "ctrl-w\n"
+    "right 300\n"
+    "ctrl-w\n"
+    "resize 60 160\n"
+    "down 500\n"
+    "burst down 500\n"
+    "pagedown 200\n"
+    "pageup 200\n"
+    "end\n"
+    "home\n"
+    "burst type int burst = 1; /* typed ahead */\n"
+    "paste 50000\n";
+
+// render passes after a key before the frame is given up on; a key takes
+// two, one that reads it and one that draws what it did
+#define REPLAY_MAX_PASSES 16
+
+typedef struct {
+
+    uint64_t* ns;
+    size_t* cells;
+    size_t len;
+    size_t cap;
+
+} replay_samples;
+
+static uint64_t replay_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static textErr replay_record(replay_samples* s, uint64_t ns, size_t cells) {
+
+    if ( s->len == s->cap ) {
+        size_t newcap = s->cap ? s->cap * 2 : 256;
+        uint64_t* grown_ns = (uint64_t*)realloc(s->ns, sizeof(uint64_t) * newcap);
+        if ( grown_ns == NULL ) { return ERR_MEM; }
+        s->ns = grown_ns;
+        size_t* grown_cells = (size_t*)realloc(s->cells, sizeof(size_t) * newcap);
+        if ( grown_cells == NULL ) { return ERR_MEM; }
+        s->cells = grown_cells;
+        s->cap = newcap;
+    }
+
+    s->ns[s->len] = ns;
+    s->cells[s->len] = cells;
+    s->len += 1;
+
+    return ERR_NONE;
+
+}
+
+static int replay_cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int replay_cmp_size(const void* a, const void* b) {
+    size_t x = *(const size_t*)a;
+    size_t y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+
+// sorts the samples in place
+static void replay_report(const char* label, replay_samples* s) {
+
+    if ( s->len == 0 ) {
+        printf("%-28s %6d\n", label, 0);
+        return;
+    }
+
+    size_t total = 0;
+    for ( size_t i = 0; i < s->len; i++ ) { total += s->cells[i]; }
+
+    qsort(s->ns, s->len, sizeof(uint64_t), replay_cmp_u64);
+    qsort(s->cells, s->len, sizeof(size_t), replay_cmp_size);
+    size_t p50 = (s->len - 1) / 2;
+    size_t p99 = (s->len - 1) * 99 / 100;
+
+    printf("%-28s %6zu %10.1f %10.1f %10.1f %8zu %8zu %10zu\n", label, s->len,
+           (double)s->ns[p50] / 1e3, (double)s->ns[p99] / 1e3, (double)s->ns[s->len - 1] / 1e3,
+           s->cells[p50], s->cells[p99], total);
+
+}
+
+// one keystroke: queue its keys, then render until the frame showing what
+// they did is drawn, the way the editor's main loop does
+static textErr replay_frame(windowman_t* wm, filebuf* fb, replay_samples* section, replay_samples* all) {
+
+    termscreen* screen = wm->screen;
+    size_t cells = screen->cells;
+    textErr ret = ERR_NONE;
+
+    uint64_t t = replay_now_ns();
+    int passes = 0;
+    do {
+        ret = windowman_render(wm, fb);
+        passes += 1;
+    } while ( ret == ERR_NONE && wm->dirty && !wm->quit && passes < REPLAY_MAX_PASSES );
+    uint64_t ns = replay_now_ns() - t;
+
+    if ( ret != ERR_NONE ) { return ret; }
+    cells = screen->cells - cells;
+
+    ret = replay_record(section, ns, cells);
+    if ( ret == ERR_NONE && all != NULL ) { ret = replay_record(all, ns, cells); }
+
+    return ret;
+
+}
+
+static int replay_key_code(const char* name) {
+
+    static const struct { const char* name; int key; } keys[] = {
+        { "up", TERMSCREEN_KEY_UP },
+        { "down", TERMSCREEN_KEY_DOWN },
+        { "left", TERMSCREEN_KEY_LEFT },
+        { "right", TERMSCREEN_KEY_RIGHT },
+        { "backspace", TERMSCREEN_KEY_BACKSPACE },
+        { "delete", TERMSCREEN_KEY_DELETE },
+        { "pageup", TERMSCREEN_KEY_PAGE_UP },
+        { "pagedown", TERMSCREEN_KEY_PAGE_DOWN },
+        { "home", TERMSCREEN_KEY_HOME },
+        { "end", TERMSCREEN_KEY_END },
+        { "enter", 10 },
+        { "esc", 27 },
+    };
+
+    for ( size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++ ) {
+        if ( strcmp(name, keys[i].name) == 0 ) { return keys[i].key; }
+    }
+    if ( strncmp(name, "ctrl-", 5) == 0 && islower((unsigned char)name[5]) && name[6] == '\0' ) {
+        return name[5] - 'a' + 1;
+    }
+
+    return -1;
+
+}
+
+// split the first word of `line` off, returning the rest
+static char* replay_word(char* line) {
+    char* arg = line;
+    while ( *arg != '\0' && !isspace((unsigned char)*arg) ) { arg++; }
+    if ( *arg != '\0' ) { *arg++ = '\0'; }
+    while ( isspace((unsigned char)*arg) ) { arg++; }
+    return arg;
+}
+
+// run one script line; false if it isn't a command
+static bool replay_command(char* line, termscreen** screen, windowman_t* wm, filebuf* fb,
+                           replay_samples* section, replay_samples* all, textErr* ret) {
+
+    char* arg = replay_word(line);
+
+    bool burst = strcmp(line, "burst") == 0;
+    if ( burst ) {
+        line = arg;
+        arg = replay_word(line);
+    }
+
+    if ( strcmp(line, "type") == 0 ) {
+        for ( ; *arg != '\0' && *ret == ERR_NONE; arg++ ) {
+            *ret = termscreen_grid_push(screen, (unsigned char)*arg);
+            if ( *ret == ERR_NONE && !burst ) { *ret = replay_frame(wm, fb, section, all); }
+        }
+        if ( *ret == ERR_NONE && burst ) { *ret = replay_frame(wm, fb, section, all); }
+        return true;
+    }
+
+    if ( burst && strcmp(line, "goto") != 0 && strcmp(line, "resize") != 0 && replay_key_code(line) != -1 ) {
+        long count = *arg != '\0' ? strtol(arg, NULL, 10) : 1;
+        for ( long i = 0; i < count && *ret == ERR_NONE; i++ ) { *ret = termscreen_grid_push(screen, replay_key_code(line)); }
+        if ( *ret == ERR_NONE ) { *ret = replay_frame(wm, fb, section, all); }
+        return true;
+    }
+    if ( burst ) { return false; }
+
+    if ( strcmp(line, "goto") == 0 ) {
+        *ret = termscreen_grid_push(screen, WINDOWMAN_KEY_GOTO);
+        for ( ; *arg != '\0' && *ret == ERR_NONE; arg++ ) { *ret = termscreen_grid_push(screen, (unsigned char)*arg); }
+        if ( *ret == ERR_NONE ) { *ret = termscreen_grid_push(screen, 10); }
+        if ( *ret == ERR_NONE ) { *ret = replay_frame(wm, fb, section, all); }
+        return true;
+    }
+
+    if ( strcmp(line, "resize") == 0 ) {
+        int rows = 0;
+        int cols = 0;
+        if ( sscanf(arg, "%d %d", &rows, &cols) != 2 ) { return false; }
+        *ret = termscreen_grid_resize(screen, rows, cols);
+        if ( *ret == ERR_NONE ) { *ret = replay_frame(wm, fb, section, all); }
+        return true;
+    }
+
+    if ( strcmp(line, "paste") == 0 ) {
+        size_t bytes = (size_t)strtoul(arg, NULL, 10);
+        char* text = (char*)malloc(bytes + 64);
+        if ( text == NULL ) {
+            *ret = ERR_MEM;
+            return true;
+        }
+        size_t len = 0;
+        for ( size_t i = 0; len < bytes; i++ ) {
+            len += (size_t)sprintf(&text[len], "    int pasted_%zu = %zu; /* pasted */\n", i, i);
+        }
+        *ret = termscreen_grid_paste(screen, text, len);
+        free(text);
+        if ( *ret == ERR_NONE ) { *ret = replay_frame(wm, fb, section, all); }
+        return true;
+    }
+
+    int key = replay_key_code(line);
+    if ( key == -1 ) { return false; }
+
+    long count = *arg != '\0' ? strtol(arg, NULL, 10) : 1;
+    for ( long i = 0; i < count && *ret == ERR_NONE; i++ ) {
+        *ret = termscreen_grid_push(screen, key);
+        if ( *ret == ERR_NONE ) { *ret = replay_frame(wm, fb, section, all); }
+    }
+
+    return true;
+
+}
+
+// C source, so the highlighter has comments, strings and keywords to color
+static textErr replay_generate(char* path, size_t lines) {
+
+    int fd = mkstemps(path, 2);
+    if ( fd < 0 ) { return ERR_IO; }
+
+    FILE* fp = fdopen(fd, "w");
+    if ( fp == NULL ) {
+        close(fd);
+        return ERR_IO;
+    }
+
+    for ( size_t i = 0; i < lines; i += 8 ) {
+        fprintf(fp, "/* block %zu: a comment that\n", i / 8);
+        fprintf(fp, "   runs over two lines */\n");
+        fprintf(fp, "static int func_%zu(int a, const char* s) {\n", i / 8);
+        fprintf(fp, "    int x = a * %zu + 0x1f; // trailing comment\n", i);
+        fprintf(fp, "    if ( x > 42 ) { return printf(\"%%d %%s\\n\", x, s); }\n");
+        fprintf(fp, "    return x;\n");
+        fprintf(fp, "}\n");
+        fprintf(fp, "\n");
+    }
+
+    if ( fclose(fp) != 0 ) { return ERR_IO; }
+
+    return ERR_NONE;
+
+}
+
+static void replay_dump(const termscreen* screen, size_t rows, size_t cols) {
+
+    for ( size_t y = 0; y < rows; y++ ) {
+        const char* text = termscreen_grid_row(screen, (int)y, NULL);
+        if ( text == NULL ) { break; }
+        size_t len = cols;
+        while ( len > 0 && text[len - 1] == ' ' ) { len -= 1; }
+        printf("%.*s\n", (int)len, text);
+    }
+
+}
+
+int main(int argc, char** argv) {
+
+    args_t args = make_default_args();
+
+    if (!parse_args(argc, argv, &args)) {
+        return 1;
+    }
+
+    char generated[64] = "/tmp/textreplay-XXXXXX.c";
+    const char* path = args.input;
+    if ( path[0] == '\0' ) {
+        textErr ret = replay_generate(generated, args.lines);
+        if ( ret != ERR_NONE ) {
+            printf("Failed to write <%s>, reason: %s\n", generated, textErr_tostr(ret));
+            return 1;
+        }
+        path = generated;
+    }
+
+    char* script = NULL;
+    if ( args.script[0] != '\0' ) {
+        FILE* fp = fopen(args.script, "rb");
+        if ( fp != NULL ) {
+            fseek(fp, 0, SEEK_END);
+            long len = ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+            script = len >= 0 ? (char*)malloc((size_t)len + 1) : NULL;
+            if ( script != NULL ) { script[fread(script, 1, (size_t)len, fp)] = '\0'; }
+            fclose(fp);
+        }
+        if ( script == NULL ) {
+            printf("Failed to read <%s>\n", args.script);
+            return 1;
+        }
+    } else {
+        script = strdup(replay_default_script);
+    }
+
+    filemap* map = NULL;
+    filebuf* fb = NULL;
+    termscreen* screen = NULL;
+    windowman_t* wm = NULL;
+
+    textErr ret = filemap_open(&map, path);
+    if ( ret == ERR_NONE ) { ret = filebuf_init(&fb, 1); }
+    if ( ret == ERR_NONE ) { ret = filebuf_load(&fb, map, path); }
+    if ( ret == ERR_NONE ) { ret = termscreen_grid(&screen, (int)args.rows, (int)args.cols); }
+    if ( ret == ERR_NONE ) { ret = windowman_init(&wm, screen); }
+    if ( ret == ERR_NONE && args.stats ) { ret = framestats_init(&wm->stats); }
+    if ( ret != ERR_NONE ) {
+        printf("Failed to open <%s>, reason: %s\n", path, textErr_tostr(ret));
+        return 1;
+    }
+
+    printf("%-28s %6s %10s %10s %10s %8s %8s %10s\n", "command", "keys", "p50 us", "p99 us", "max us", "cells50", "cells99", "cells");
+
+    replay_samples section = { 0 };
+    replay_samples all = { 0 };
+
+    // the first screen, then the rest once the line count is in, so it
+    // doesn't change the status row in the middle of the script
+    ret = replay_frame(wm, fb, &section, NULL);
+    replay_report("(first frame)", &section);
+    size_t total = 0;
+    while ( ret == ERR_NONE && (ret = filebuf_line_count(&fb, &total)) == ERR_BUSY ) {
+        ret = ERR_NONE;
+        usleep(1000);
+    }
+    if ( ret == ERR_NONE ) {
+        section.len = 0;
+        ret = replay_frame(wm, fb, &section, NULL);
+    }
+
+    for ( char* line = strtok(script, "\n"); line != NULL && ret == ERR_NONE; line = strtok(NULL, "\n") ) {
+
+        char* hash = strchr(line, '#');
+        if ( hash != NULL ) { *hash = '\0'; }
+        while ( isspace((unsigned char)*line) ) { line++; }
+        size_t len = strlen(line);
+        while ( len > 0 && isspace((unsigned char)line[len - 1]) ) { line[--len] = '\0'; }
+        if ( len == 0 ) { continue; }
+
+        char label[29];
+        snprintf(label, sizeof(label), "%s", line);
+
+        section.len = 0;
+        if ( !replay_command(line, &screen, wm, fb, &section, &all, &ret) ) {
+            printf("%-28s unknown command\n", label);
+            continue;
+        }
+        if ( ret == ERR_NONE ) { replay_report(label, &section); }
+
+    }
+
+    if ( ret != ERR_NONE ) {
+        printf("Replay failed: %s\n", textErr_tostr(ret));
+    } else {
+        replay_report("(all keys)", &all);
+        if ( wm->stats != NULL ) {
+            printf("\n");
+            framestats_print(wm->stats, stdout);
+        }
+        if ( args.dump ) {
+            int rows, cols;
+            termscreen_size(screen, &rows, &cols);
+            replay_dump(screen, (size_t)rows, (size_t)cols);
+        }
+    }
+
+    free(section.ns);
+    free(section.cells);
+    free(all.ns);
+    free(all.cells);
+    free(script);
+
+    if ( wm->stats != NULL ) { framestats_destroy(&wm->stats); }
+    windowman_destroy(&wm);
+    termscreen_destroy(&screen);
+    filebuf_destroy(&fb);
+    if ( path == generated ) { unlink(generated); }
+
+    return ret == ERR_NONE ? 0 : 1;
+
+}
@@ -0,0 +1,244 @@
+
+#include <ncurses.h>
+
+#include "termScreen.h"
+#include "syntaxHighlight.h"
+
+static void cursesscreen_size(termscreen* s, int* rows, int* cols) {
+    int h, w;
+    getmaxyx(stdscr, h, w);
+    *rows = h;
+    *cols = w;
+}
+
+static void cursesscreen_clear_all(termscreen* s) {
+    clear();
+}
+
+static void cursesscreen_clear_row(termscreen* s, int y, int x) {
+    move(y, x);
+    clrtoeol();
+}
+
+static void cursesscreen_put(termscreen* s, int y, int x, const char* str, int len, int attr) {
+
+    int cls = attr & TERMSCREEN_CLASS_MASK;
+    if ( cls != SYNTAX_PLAIN ) { attron(COLOR_PAIR(cls)); }
+    if ( attr & TERMSCREEN_REVERSE ) { attron(A_REVERSE); }
+    mvaddnstr(y, x, str, len);
+    if ( attr & TERMSCREEN_REVERSE ) { attroff(A_REVERSE); }
+    if ( cls != SYNTAX_PLAIN ) { attroff(COLOR_PAIR(cls)); }
+
+}
+
+static void cursesscreen_hrule(termscreen* s, int y, int x, int len) {
+    mvhline(y, x, ACS_HLINE, len);
+}
+
+static void cursesscreen_vrule(termscreen* s, int y, int x) {
+    mvaddch(y, x, ACS_VLINE);
+}
+
+static void cursesscreen_invert(termscreen* s, int y, int x) {
+    chtype c = mvinch(y, x) & A_CHARTEXT;
+    mvaddch(y, x, c | A_REVERSE);
+}
+
+// the terminal does the move with its own scroll region
+static void cursesscreen_scroll_rows(termscreen* s, int top, int bottom, int n) {
+
+    scrollok(stdscr, TRUE);
+    setscrreg(top, bottom);
+    scrl(n);
+    setscrreg(0, getmaxy(stdscr) - 1);
+    scrollok(stdscr, FALSE);
+
+}
+
+static void cursesscreen_flush(termscreen* s) {
+    refresh();
+}
+
+// with bracketed paste on, the terminal sends a paste as ESC[200~, the text,
+// ESC[201~. after an escape, read the rest of the start marker; if it isn't
+// there, put back what was read and the escape is just an escape.
+static bool cursesscreen_paste_start(void) {
+
+    static const char start[] = "[200~";
+    int got[sizeof(start) - 1];
+    size_t n = 0;
+
+    while ( n < sizeof(start) - 1 ) {
+        int ch = getch();
+        if ( ch == ERR ) { break; }
+        got[n++] = ch;
+        if ( ch != start[n - 1] ) { break; }
+    }
+    if ( n == sizeof(start) - 1 && got[n - 1] == '~' ) { return true; }
+
+    while ( n > 0 ) { ungetch(got[--n]); }
+    return false;
+
+}
+
+// read the pasted text up to the end marker into the screen's paste. the
+// text is already on its way, so a pause means the end marker got lost.
+static void cursesscreen_paste_read(termscreen* s) {
+
+    static const char end[] = "\033[201~";
+    char chunk[512];
+    size_t n = 0;
+    size_t matched = 0;
+
+    s->paste_len = 0;
+    timeout(200);
+
+    int ch;
+    while ( (ch = getch()) != ERR ) {
+
+        if ( ch == end[matched] ) {
+            matched += 1;
+            if ( matched == sizeof(end) - 1 ) { break; }
+            continue;
+        }
+
+        // a false start of the end marker is pasted text after all
+        for ( size_t i = 0; i < matched; i++ ) {
+            if ( n == sizeof(chunk) ) {
+                termscreen_paste_add(s, chunk, n);
+                n = 0;
+            }
+            chunk[n++] = end[i];
+        }
+        matched = 0;
+        if ( ch == end[0] ) {
+            matched = 1;
+            continue;
+        }
+
+        if ( ch > 0xff ) { continue; }
+        if ( n == sizeof(chunk) ) {
+            termscreen_paste_add(s, chunk, n);
+            n = 0;
+        }
+        chunk[n++] = ch == '\r' ? '\n' : (char)ch;
+
+    }
+
+    termscreen_paste_add(s, chunk, n);
+    timeout(0);
+
+}
+
+static int cursesscreen_key(termscreen* s) {
+
+    timeout(0);
+    int ch = getch();
+
+    if ( ch == 27 && cursesscreen_paste_start() ) {
+        cursesscreen_paste_read(s);
+        return TERMSCREEN_KEY_PASTE;
+    }
+
+    switch ( ch ) {
+        case ERR: return -1;
+        case KEY_UP: return TERMSCREEN_KEY_UP;
+        case KEY_DOWN: return TERMSCREEN_KEY_DOWN;
+        case KEY_LEFT: return TERMSCREEN_KEY_LEFT;
+        case KEY_RIGHT: return TERMSCREEN_KEY_RIGHT;
+        case KEY_BACKSPACE: return TERMSCREEN_KEY_BACKSPACE;
+        case KEY_DL: return TERMSCREEN_KEY_DELETE;
+        case KEY_PPAGE: return TERMSCREEN_KEY_PAGE_UP;
+        case KEY_NPAGE: return TERMSCREEN_KEY_PAGE_DOWN;
+        case KEY_HOME: return TERMSCREEN_KEY_HOME;
+        case KEY_END: return TERMSCREEN_KEY_END;
+        default: return ch;
+    }
+
+}
+
+// blocks until enter is pressed
+static void cursesscreen_prompt(termscreen* s, const char* label, char* buf, int buflen) {
+
+    move(0, 0);
+    clrtoeol();
+    mvprintw(0, 0, "%s", label);
+
+    echo();
+    curs_set(1);
+    timeout(-1);
+
+    getnstr(buf, buflen - 1);
+
+    noecho();
+    curs_set(0);
+
+}
+
+static void cursesscreen_close(termscreen* s) {
+    fputs("\033[?2004l", stdout);
+    fflush(stdout);
+    endwin();
+}
+
+static const termscreen_ops cursesscreen_ops = {
+    cursesscreen_size,
+    cursesscreen_clear_all,
+    cursesscreen_clear_row,
+    cursesscreen_put,
+    cursesscreen_hrule,
+    cursesscreen_vrule,
+    cursesscreen_invert,
+    cursesscreen_scroll_rows,
+    cursesscreen_flush,
+    cursesscreen_key,
+    cursesscreen_prompt,
+    cursesscreen_close,
+};
+
+textErr termscreen_curses(termscreen** inst) {
+
+    if ( inst == NULL ) { return ERR_NULL; }
+
+    termscreen* s = (termscreen*)calloc(1, sizeof(termscreen));
+    if ( s == NULL ) { return ERR_MEM; }
+
+    if ( initscr() == NULL ) {
+        free(s);
+        return ERR_MEM;
+    }
+
+    cbreak();            // disable line buffering
+    noecho();            // don't echo typed characters
+    keypad(stdscr, TRUE);// enable function and arrow keys
+    intrflush(stdscr, FALSE);
+    set_escdelay(25);    // escape on its own cancels a search
+    idlok(stdscr, TRUE); // let refresh scroll with insert/delete line
+
+    // try to hide the cursor
+    curs_set(0);
+
+    // have pastes marked, so they go in as one edit instead of as keys
+    fputs("\033[?2004h", stdout);
+    fflush(stdout);
+
+    if ( has_colors() ) {
+        start_color();
+
+        // one pair per syntax class, on the terminal's own background
+        short bg = use_default_colors() == OK ? -1 : COLOR_BLACK;
+        init_pair(SYNTAX_KEYWORD, COLOR_YELLOW, bg);
+        init_pair(SYNTAX_TYPE, COLOR_GREEN, bg);
+        init_pair(SYNTAX_STRING, COLOR_MAGENTA, bg);
+        init_pair(SYNTAX_NUMBER, COLOR_RED, bg);
+        init_pair(SYNTAX_COMMENT, COLOR_CYAN, bg);
+        init_pair(SYNTAX_PREPROC, COLOR_BLUE, bg);
+        s->colors = COLOR_PAIRS > SYNTAX_CLASSES;
+    }
+
+    s->ops = &cursesscreen_ops;
+    *inst = s;
+
+    return ERR_NONE;
+
+}
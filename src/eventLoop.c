@@ -0,0 +1,143 @@
+#include "eventLoop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+// signal handlers can't take a context, so the active loop is global
+static eventloop* eventloop_active = NULL;
+
+static void eventloop_signal(int sig) {
+
+    int saved = errno;
+
+    if ( eventloop_active != NULL ) {
+        unsigned char b = (unsigned char)sig;
+        ssize_t wrote = write(eventloop_active->signal_pipe[1], &b, 1);
+        (void)wrote; // a full pipe already has a wakeup pending
+
+        if ( sig == SIGWINCH ) {
+            struct sigaction* prev = &eventloop_active->prev_winch;
+            if ( (prev->sa_flags & SA_SIGINFO) == 0 && prev->sa_handler != SIG_DFL && prev->sa_handler != SIG_IGN ) {
+                prev->sa_handler(sig);
+            }
+        }
+    }
+
+    errno = saved;
+
+}
+
+textErr eventloop_init(eventloop** inst, int input_fd) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL || eventloop_active != NULL ) { return ERR_NULL; }
+
+    ref = (eventloop*)calloc(1, sizeof(eventloop));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    ref->input_fd = input_fd;
+
+    if ( pipe(ref->signal_pipe) != 0 ) {
+        free(ref);
+        ref = NULL;
+        return ERR_IO;
+    }
+
+    for ( int i = 0; i < 2; i++ ) {
+        fcntl(ref->signal_pipe[i], F_SETFL, fcntl(ref->signal_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(ref->signal_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    eventloop_active = ref;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = eventloop_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+
+    sigaction(SIGWINCH, &sa, &ref->prev_winch);
+    sigaction(SIGINT, &sa, &ref->prev_int);
+    sigaction(SIGTERM, &sa, &ref->prev_term);
+
+    return ERR_NONE;
+
+}
+
+// wait for the next event. a negative timeout waits forever.
+textErr eventloop_wait(eventloop** inst, int timeout_ms, event_kind* event) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || event == NULL ) { return ERR_NULL; }
+
+    while ( true ) {
+
+        struct pollfd fds[2] = {
+            { .fd = ref->input_fd, .events = POLLIN },
+            { .fd = ref->signal_pipe[0], .events = POLLIN },
+        };
+
+        int ready = poll(fds, 2, timeout_ms);
+        if ( ready < 0 ) {
+            if ( errno == EINTR ) { continue; }
+            return ERR_IO;
+        }
+
+        if ( ready == 0 ) {
+            *event = EVENT_TIMER;
+            return ERR_NONE;
+        }
+
+        if ( fds[1].revents & POLLIN ) {
+
+            event_kind kind = EVENT_TIMER;
+            unsigned char sigs[16];
+            ssize_t got = 0;
+            while ( (got = read(ref->signal_pipe[0], sigs, sizeof(sigs))) > 0 ) {
+                for ( ssize_t i = 0; i < got; i++ ) {
+                    if ( sigs[i] == SIGWINCH && kind < EVENT_RESIZE ) { kind = EVENT_RESIZE; }
+                    if ( sigs[i] == SIGINT || sigs[i] == SIGTERM ) { kind = EVENT_QUIT; }
+                }
+            }
+
+            if ( kind != EVENT_TIMER ) {
+                *event = kind;
+                return ERR_NONE;
+            }
+
+        }
+
+        if ( fds[0].revents & (POLLIN | POLLHUP | POLLERR) ) {
+            // a closed terminal reads as EOF forever; treat it as a quit
+            *event = (fds[0].revents & POLLIN) ? EVENT_INPUT : EVENT_QUIT;
+            return ERR_NONE;
+        }
+
+    }
+
+}
+
+textErr eventloop_destroy(eventloop** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    sigaction(SIGWINCH, &ref->prev_winch, NULL);
+    sigaction(SIGINT, &ref->prev_int, NULL);
+    sigaction(SIGTERM, &ref->prev_term, NULL);
+
+    eventloop_active = NULL;
+
+    close(ref->signal_pipe[0]);
+    close(ref->signal_pipe[1]);
+
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
@@ -0,0 +1,37 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+typedef enum {
+
+    EVENT_TIMER = 0,
+    EVENT_INPUT = 1,
+    EVENT_RESIZE = 2,
+    EVENT_QUIT = 3,
+
+} event_kind;
+
+// eventloop blocks in poll() until stdin has input, a signal arrives or a
+// timeout expires, so an idle editor doesn't use any CPU. signals reach the
+// loop through a self-pipe; SIGWINCH is passed on to the handler that was
+// installed before (ncurses' own, which queues KEY_RESIZE).
+typedef struct {
+
+    int input_fd;
+    int signal_pipe[2];
+
+    struct sigaction prev_winch;
+    struct sigaction prev_int;
+    struct sigaction prev_term;
+
+} eventloop;
+
+textErr eventloop_init(eventloop** inst, int input_fd);
+textErr eventloop_wait(eventloop** inst, int timeout_ms, event_kind* event);
+textErr eventloop_destroy(eventloop** inst);
+
+#endif /* EVENTLOOP_H */
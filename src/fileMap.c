@@ -0,0 +1,282 @@
+#include "fileMap.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static textErr filemap_read_fd(int fd, char** data, size_t* len) {
+
+    size_t cap = 4096;
+    size_t used = 0;
+
+    char* buf = (char*)malloc(cap);
+    if ( buf == NULL ) { return ERR_MEM; }
+
+    while ( true ) {
+
+        if ( used == cap ) {
+            char* grown = (char*)realloc(buf, cap*2);
+            if ( grown == NULL ) { free(buf); return ERR_MEM; }
+            buf = grown;
+            cap *= 2;
+        }
+
+        ssize_t got = read(fd, &buf[used], cap - used);
+        if ( got < 0 ) { free(buf); return ERR_IO; }
+        if ( got == 0 ) { break; }
+
+        used += (size_t)got;
+
+    }
+
+    *data = buf;
+    *len = used;
+
+    return ERR_NONE;
+
+}
+
+// files larger than this share of physical memory are streamed rather than
+// mapped; touching all of them would push everything else out of memory
+#define FILEMAP_STREAM_SHARE 2
+
+static size_t filemap_stream_threshold(void) {
+
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long size = sysconf(_SC_PAGESIZE);
+    if ( pages <= 0 || size <= 0 ) { return SIZE_MAX; }
+
+    return (size_t)pages / FILEMAP_STREAM_SHARE * (size_t)size;
+
+}
+
+// take over `fd` as a streamed file of `len` bytes
+static textErr filemap_stream_fd(filemap* map, int fd, size_t len) {
+
+    map->windows = (filemap_window*)calloc(FILEMAP_WINDOWS, sizeof(filemap_window));
+    if ( map->windows == NULL ) { return ERR_MEM; }
+
+    for ( size_t i = 0; i < FILEMAP_WINDOWS; i++ ) {
+        map->windows[i].start = SIZE_MAX;
+    }
+
+    map->data = NULL;
+    map->len = len;
+    map->fd = fd;
+    map->streamed = true;
+
+    return ERR_NONE;
+
+}
+
+textErr filemap_open(filemap** inst, const char* path) {
+    #define ref (*inst)
+
+    if ( inst == NULL || path == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    int fd = open(path, O_RDONLY);
+    if ( fd < 0 ) { return ERR_IO; }
+
+    struct stat st;
+    if ( fstat(fd, &st) != 0 ) {
+        close(fd);
+        return ERR_IO;
+    }
+
+    ref = (filemap*)calloc(1, sizeof(filemap));
+    if ( ref == NULL ) {
+        close(fd);
+        return ERR_MEM;
+    }
+
+    ref->fd = -1;
+
+    if ( S_ISREG(st.st_mode) && (size_t)st.st_size >= filemap_stream_threshold() ) {
+        textErr ret = filemap_stream_fd(ref, fd, (size_t)st.st_size);
+        if ( ret != ERR_NONE ) {
+            close(fd);
+            free(ref);
+            ref = NULL;
+        }
+        return ret;
+    }
+
+    if ( S_ISREG(st.st_mode) && st.st_size > 0 ) {
+
+        // the mapping is never written to, so pages stay shared with the
+        // page cache and are only faulted in when read
+        void* addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( addr != MAP_FAILED ) {
+            ref->data = (char*)addr;
+            ref->len = (size_t)st.st_size;
+            ref->mapped = true;
+            close(fd);
+            return ERR_NONE;
+        }
+
+        // couldn't map it, so read it piecemeal instead of all at once
+        textErr ret = filemap_stream_fd(ref, fd, (size_t)st.st_size);
+        if ( ret != ERR_NONE ) {
+            close(fd);
+            free(ref);
+            ref = NULL;
+        }
+        return ret;
+
+    }
+
+    textErr ret = filemap_read_fd(fd, &ref->data, &ref->len);
+    close(fd);
+
+    if ( ret != ERR_NONE ) {
+        free(ref);
+        ref = NULL;
+        return ret;
+    }
+
+    ref->mapped = false;
+
+    return ERR_NONE;
+
+}
+
+// open a regular file in streaming mode regardless of its size
+textErr filemap_stream(filemap** inst, const char* path) {
+    #define ref (*inst)
+
+    if ( inst == NULL || path == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    int fd = open(path, O_RDONLY);
+    if ( fd < 0 ) { return ERR_IO; }
+
+    struct stat st;
+    if ( fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ) {
+        close(fd);
+        return ERR_IO;
+    }
+
+    ref = (filemap*)calloc(1, sizeof(filemap));
+    if ( ref == NULL ) {
+        close(fd);
+        return ERR_MEM;
+    }
+
+    textErr ret = filemap_stream_fd(ref, fd, (size_t)st.st_size);
+    if ( ret != ERR_NONE ) {
+        close(fd);
+        free(ref);
+        ref = NULL;
+    }
+
+    return ret;
+
+}
+
+// point `out` at `len` bytes starting at `offset`. for streamed files the
+// range must not cross a FILEMAP_WINDOW boundary, and the bytes stay valid
+// until the next fetch. if a read fails `out` still points at `len` bytes
+// (zeros) so callers that can't fail don't have to, and ERR_IO is returned.
+textErr filemap_fetch(filemap** inst, size_t offset, size_t len, const char** out) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || out == NULL ) { return ERR_NULL; }
+    if ( offset > ref->len || len > ref->len - offset ) { return ERR_EOF; }
+
+    if ( !ref->streamed ) {
+        *out = ref->data + offset;
+        return ERR_NONE;
+    }
+
+    size_t start = offset - offset % FILEMAP_WINDOW;
+    if ( offset + len > start + FILEMAP_WINDOW ) { return ERR_EOF; }
+
+    // hit, or else evict the least recently used window
+    filemap_window* win = &ref->windows[0];
+    for ( size_t i = 0; i < FILEMAP_WINDOWS; i++ ) {
+        filemap_window* cur = &ref->windows[i];
+        if ( cur->start == start ) {
+            win = cur;
+            break;
+        }
+        if ( cur->used < win->used ) { win = cur; }
+    }
+
+    textErr ret = ERR_NONE;
+
+    if ( win->start != start ) {
+
+        if ( win->data == NULL ) {
+            win->data = (char*)malloc(FILEMAP_WINDOW);
+            if ( win->data == NULL ) { return ERR_MEM; }
+        }
+
+        size_t want = (ref->len - start < FILEMAP_WINDOW) ? ref->len - start : FILEMAP_WINDOW;
+        size_t got = 0;
+        while ( got < want ) {
+            ssize_t n = pread(ref->fd, win->data + got, want - got, (off_t)(start + got));
+            if ( n <= 0 ) { break; }
+            got += (size_t)n;
+        }
+
+        if ( got < want ) {
+            memset(win->data + got, 0, want - got);
+            ref->failed = true;
+            win->start = SIZE_MAX;
+            ret = ERR_IO;
+        } else {
+            win->start = start;
+        }
+
+    }
+
+    win->used = ++ref->tick;
+    *out = win->data + (offset - start);
+
+    return ret;
+
+}
+
+textErr filemap_wrap(filemap** inst, char* data, size_t len) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+    if ( data == NULL && len != 0 ) { return ERR_NULL; }
+
+    ref = (filemap*)calloc(1, sizeof(filemap));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    ref->data = data;
+    ref->len = len;
+    ref->mapped = false;
+    ref->fd = -1;
+
+    return ERR_NONE;
+
+}
+
+textErr filemap_close(filemap** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    if ( ref->streamed ) {
+        for ( size_t i = 0; i < FILEMAP_WINDOWS; i++ ) { free(ref->windows[i].data); }
+        free(ref->windows);
+        close(ref->fd);
+    } else if ( ref->mapped ) {
+        munmap(ref->data, ref->len);
+    } else {
+        free(ref->data);
+    }
+
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
@@ -0,0 +1,50 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+// streamed files are read in aligned windows of this size, and at most
+// FILEMAP_WINDOWS of them are held at once
+#define FILEMAP_WINDOW ((size_t)64 * 1024)
+#define FILEMAP_WINDOWS 64
+
+typedef struct {
+
+    char* data;
+    size_t start;
+    uint64_t used;
+
+} filemap_window;
+
+// filemap is the backing store for a file's original bytes.
+// regular files are mapped read-only, so only the pages that are actually
+// read are ever faulted in. anything that can't be mapped (pipes, empty
+// files) falls back to an owned heap buffer.
+// files too large to keep resident are streamed instead: `data` is NULL and
+// bytes are read on demand with pread into a fixed set of windows, so memory
+// use doesn't depend on the file size. `failed` sticks once a read fails.
+typedef struct {
+
+    char* data;
+    size_t len;
+
+    bool mapped;
+
+    int fd;
+    bool streamed;
+    bool failed;
+    filemap_window* windows;
+    uint64_t tick;
+
+} filemap;
+
+textErr filemap_open(filemap** inst, const char* path);
+textErr filemap_stream(filemap** inst, const char* path);
+textErr filemap_fetch(filemap** inst, size_t offset, size_t len, const char** out);
+textErr filemap_wrap(filemap** inst, char* data, size_t len);
+textErr filemap_close(filemap** inst);
+
+#endif /* FILEMAP_H */
@@ -0,0 +1,282 @@
+#define _GNU_SOURCE
+#include "fileSave.h"
+#include "textTrace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+// iovecs gathered per writev call
+#define FILESAVE_IOV 256
+
+// buffer for copying original ranges when the kernel can't do it for us
+#define FILESAVE_COPY ((size_t)256 * 1024)
+
+static textErr filesave_writev(filesave* fs, int fd, struct iovec* iov, int count) {
+
+    while ( count > 0 ) {
+
+        ssize_t n = writev(fd, iov, count);
+        if ( n < 0 ) {
+            if ( errno == EINTR ) { continue; }
+            return ERR_IO;
+        }
+
+        atomic_fetch_add_explicit(&fs->written, (size_t)n, memory_order_relaxed);
+
+        // skip what was written, which may end partway into an iovec
+        size_t done = (size_t)n;
+        while ( count > 0 && done >= iov->iov_len ) {
+            done -= iov->iov_len;
+            iov += 1;
+            count -= 1;
+        }
+        if ( count > 0 ) {
+            iov->iov_base = (char*)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+
+    }
+
+    return ERR_NONE;
+
+}
+
+// copy a range of the original file into `fd`, in the kernel when possible
+static textErr filesave_copy(filesave* fs, int fd, size_t start, size_t len) {
+
+    loff_t in = (loff_t)start;
+
+    while ( len > 0 ) {
+
+        ssize_t n = copy_file_range(fs->original_fd, &in, fd, NULL, len, 0);
+        if ( n < 0 && errno == EINTR ) { continue; }
+        if ( n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP) ) { break; }
+        if ( n <= 0 ) { return ERR_IO; }
+
+        atomic_fetch_add_explicit(&fs->written, (size_t)n, memory_order_relaxed);
+        len -= (size_t)n;
+
+    }
+
+    if ( len == 0 ) { return ERR_NONE; }
+
+    // no copy_file_range between these files, so bounce through a buffer
+    char* buf = (char*)malloc(FILESAVE_COPY);
+    if ( buf == NULL ) { return ERR_MEM; }
+
+    textErr ret = ERR_NONE;
+    while ( len > 0 && ret == ERR_NONE ) {
+
+        size_t want = (len < FILESAVE_COPY) ? len : FILESAVE_COPY;
+        ssize_t got = pread(fs->original_fd, buf, want, (off_t)in);
+        if ( got < 0 && errno == EINTR ) { continue; }
+        if ( got <= 0 ) {
+            ret = ERR_IO;
+            break;
+        }
+
+        struct iovec iov = { buf, (size_t)got };
+        ret = filesave_writev(fs, fd, &iov, 1);
+
+        in += got;
+        len -= (size_t)got;
+
+    }
+
+    free(buf);
+
+    return ret;
+
+}
+
+// write every piece to `fd`. pieces held in memory are gathered into one
+// writev per FILESAVE_IOV pieces; original pieces of a streamed file are
+// copied file to file without passing through this process.
+static textErr filesave_write(filesave* fs, int fd) {
+
+    struct iovec iov[FILESAVE_IOV];
+    int count = 0;
+
+    for ( size_t i = 0; i < fs->count; i++ ) {
+
+        const piece* p = &fs->pieces[i];
+        if ( p->len == 0 ) { continue; }
+
+        if ( p->src == PIECE_ORIGINAL && fs->original == NULL ) {
+            textErr ret = filesave_writev(fs, fd, iov, count);
+            if ( ret != ERR_NONE ) { return ret; }
+            count = 0;
+
+            ret = filesave_copy(fs, fd, p->start, p->len);
+            if ( ret != ERR_NONE ) { return ret; }
+            continue;
+        }
+
+        const char* base = (p->src == PIECE_ORIGINAL) ? fs->original : fs->add;
+        iov[count].iov_base = (void*)(base + p->start);
+        iov[count].iov_len = p->len;
+        count += 1;
+
+        if ( count == FILESAVE_IOV ) {
+            textErr ret = filesave_writev(fs, fd, iov, count);
+            if ( ret != ERR_NONE ) { return ret; }
+            count = 0;
+        }
+
+    }
+
+    return filesave_writev(fs, fd, iov, count);
+
+}
+
+// make the rename itself durable
+static void filesave_sync_dir(const char* path) {
+
+    char* copy = strdup(path);
+    if ( copy == NULL ) { return; }
+
+    int dfd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    if ( dfd >= 0 ) {
+        fsync(dfd);
+        close(dfd);
+    }
+
+    free(copy);
+
+}
+
+static void* filesave_worker(void* arg) {
+
+    TRACE_SCOPE(__func__);
+    filesave* fs = (filesave*)arg;
+    textErr ret = ERR_NONE;
+
+    size_t pathlen = strlen(fs->path);
+    char* tmp = (char*)malloc(pathlen + 8);
+    if ( tmp == NULL ) { ret = ERR_MEM; }
+
+    int fd = -1;
+    if ( ret == ERR_NONE ) {
+        snprintf(tmp, pathlen + 8, "%s.XXXXXX", fs->path);
+        fd = mkstemp(tmp);
+        if ( fd < 0 ) { ret = ERR_IO; }
+    }
+
+    if ( ret == ERR_NONE ) {
+        // keep the permissions of the file being replaced
+        struct stat st;
+        mode_t mode = 0644;
+        if ( stat(fs->path, &st) == 0 ) { mode = st.st_mode & 07777; }
+        fchmod(fd, mode);
+
+        ret = filesave_write(fs, fd);
+    }
+
+    if ( ret == ERR_NONE && fsync(fd) != 0 ) { ret = ERR_IO; }
+    if ( fd >= 0 && close(fd) != 0 && ret == ERR_NONE ) { ret = ERR_IO; }
+
+    if ( ret == ERR_NONE && rename(tmp, fs->path) != 0 ) { ret = ERR_IO; }
+
+    if ( ret == ERR_NONE ) {
+        filesave_sync_dir(fs->path);
+    } else if ( fd >= 0 ) {
+        unlink(tmp);
+    }
+
+    free(tmp);
+
+    fs->status = ret;
+    atomic_store_explicit(&fs->done, 1, memory_order_release);
+
+    return NULL;
+
+}
+
+// snapshot `text` and start writing it to `path` in the background. `map`
+// backs the piece table's original pieces and must outlive the save.
+textErr filesave_start(filesave** inst, piecetable** text, filemap* map, const char* path) {
+    #define ref (*inst)
+
+    if ( inst == NULL || text == NULL || *text == NULL || map == NULL || path == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    ref = (filesave*)calloc(1, sizeof(filesave));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    piecetable* pt = *text;
+
+    ref->len = pt->len;
+    ref->original = map->streamed ? NULL : map->data;
+    ref->original_fd = map->streamed ? map->fd : -1;
+    atomic_init(&ref->done, 0);
+    atomic_init(&ref->written, 0);
+
+    textErr ret = piecetable_pieces(text, &ref->pieces, &ref->count);
+
+    // the add buffer may move when the editor appends to it, so the save
+    // gets its own copy of what the pieces refer to
+    if ( ret == ERR_NONE && pt->add_len > 0 ) {
+        ref->add = (char*)malloc(pt->add_len);
+        if ( ref->add == NULL ) {
+            ret = ERR_MEM;
+        } else {
+            memcpy(ref->add, pt->add, pt->add_len);
+        }
+    }
+
+    if ( ret == ERR_NONE ) {
+        ref->path = strdup(path);
+        if ( ref->path == NULL ) { ret = ERR_MEM; }
+    }
+
+    if ( ret == ERR_NONE && pthread_create(&ref->worker, NULL, filesave_worker, ref) != 0 ) {
+        ret = ERR_MEM;
+    }
+
+    if ( ret != ERR_NONE ) {
+        free(ref->pieces);
+        free(ref->add);
+        free(ref->path);
+        free(ref);
+        ref = NULL;
+    }
+
+    return ret;
+
+}
+
+// nonzero once the worker has finished
+int filesave_done(filesave** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return 0; }
+
+    return atomic_load_explicit(&ref->done, memory_order_acquire);
+
+}
+
+// wait for the save to end, free it and return how it went
+textErr filesave_finish(filesave** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    pthread_join(ref->worker, NULL);
+
+    textErr ret = ref->status;
+
+    free(ref->pieces);
+    free(ref->add);
+    free(ref->path);
+    free(ref);
+    ref = NULL;
+
+    return ret;
+
+}
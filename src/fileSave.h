@@ -0,0 +1,44 @@
+#ifndef FILESAVE_H
+#define FILESAVE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "textErr.h"
+#include "fileMap.h"
+#include "pieceTable.h"
+
+// filesave writes a snapshot of a piece table to disk on a worker thread.
+// the snapshot is the piece list plus a private copy of the add buffer; the
+// original bytes are read straight from the file map, which never changes,
+// so the editor can keep going while the save runs.
+// the data goes to a temporary file next to the target, is fsync'd and then
+// renamed over the target, so a crash leaves either the old or the new file
+// but never a mix. nothing but `done` and `written` may be touched until
+// `done` is set.
+typedef struct {
+
+    piece* pieces;
+    size_t count;
+
+    const char* original;
+    int original_fd;
+
+    char* add;
+
+    size_t len;
+    char* path;
+
+    pthread_t worker;
+    atomic_int done;
+    atomic_size_t written;
+    textErr status;
+
+} filesave;
+
+textErr filesave_start(filesave** inst, piecetable** text, filemap* map, const char* path);
+int filesave_done(filesave** inst);
+textErr filesave_finish(filesave** inst);
+
+#endif /* FILESAVE_H */
@@ -0,0 +1,129 @@
+
+#include <time.h>
+
+#include "frameStats.h"
+
+textErr framestats_init(framestats** inst) {
+
+    if ( inst == NULL ) { return ERR_NULL; }
+
+    *inst = (framestats*)calloc(1, sizeof(framestats));
+    if ( *inst == NULL ) { return ERR_MEM; }
+
+    return ERR_NONE;
+
+}
+
+textErr framestats_destroy(framestats** inst) {
+
+    if ( inst == NULL || *inst == NULL ) { return ERR_NULL; }
+
+    free(*inst);
+    *inst = NULL;
+
+    return ERR_NONE;
+
+}
+
+uint64_t framestats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static size_t framestats_bucket(uint64_t ns) {
+
+    uint64_t us = ns / 1000;
+    size_t b = 0;
+    while ( us > 0 && b < FRAMESTATS_BUCKETS - 1 ) {
+        us >>= 1;
+        b += 1;
+    }
+
+    return b;
+
+}
+
+void framestats_record(framestats** inst, uint64_t ns, size_t rows, size_t cells, size_t allocs, size_t mallocs) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return; }
+
+    ref->frames += 1;
+    ref->buckets[framestats_bucket(ns)] += 1;
+
+    ref->ns_total += ns;
+    ref->rows_total += rows;
+    ref->cells_total += cells;
+    ref->allocs_total += allocs;
+    ref->mallocs_total += mallocs;
+    if ( ns > ref->ns_max ) { ref->ns_max = ns; }
+    if ( rows > ref->rows_max ) { ref->rows_max = rows; }
+    if ( cells > ref->cells_max ) { ref->cells_max = cells; }
+    if ( allocs > ref->allocs_max ) { ref->allocs_max = allocs; }
+
+    ref->last_ns = ns;
+    ref->last_rows = rows;
+    ref->last_cells = cells;
+    ref->last_allocs = allocs;
+    ref->last_mallocs = mallocs;
+
+}
+
+// upper bound in microseconds of the bucket the p'th percentile frame is in
+static uint64_t framestats_percentile(const framestats* stats, size_t p) {
+
+    size_t want = (stats->frames * p + 99) / 100;
+    size_t seen = 0;
+    for ( size_t b = 0; b < FRAMESTATS_BUCKETS; b++ ) {
+        seen += stats->buckets[b];
+        if ( seen >= want ) { return (uint64_t)1 << b; }
+    }
+
+    return (uint64_t)1 << (FRAMESTATS_BUCKETS - 1);
+
+}
+
+void framestats_print(const framestats* stats, FILE* fp) {
+
+    if ( stats == NULL || fp == NULL ) { return; }
+
+    fprintf(fp, "%zu frames\n", stats->frames);
+    if ( stats->frames == 0 ) { return; }
+
+    double n = (double)stats->frames;
+    fprintf(fp, "frame time:     mean %.1f us, p50 < %llu us, p99 < %llu us, max %.1f us\n",
+            (double)stats->ns_total / n / 1e3,
+            (unsigned long long)framestats_percentile(stats, 50),
+            (unsigned long long)framestats_percentile(stats, 99),
+            (double)stats->ns_max / 1e3);
+    fprintf(fp, "rows redrawn:   mean %.1f, max %zu\n", (double)stats->rows_total / n, stats->rows_max);
+    fprintf(fp, "cells written:  mean %.1f, max %zu\n", (double)stats->cells_total / n, stats->cells_max);
+    fprintf(fp, "line allocs:    mean %.1f, max %zu, %zu from malloc\n",
+            (double)stats->allocs_total / n, stats->allocs_max, stats->mallocs_total);
+
+    // one bar per bucket from the first to the last one used, scaled to
+    // the fullest
+    size_t first = 0;
+    size_t last = FRAMESTATS_BUCKETS - 1;
+    size_t most = 0;
+    while ( stats->buckets[first] == 0 ) { first += 1; }
+    while ( stats->buckets[last] == 0 ) { last -= 1; }
+    for ( size_t b = first; b <= last; b++ ) {
+        if ( stats->buckets[b] > most ) { most = stats->buckets[b]; }
+    }
+
+    fprintf(fp, "\n%12s %10s\n", "frame time", "frames");
+    for ( size_t b = first; b <= last; b++ ) {
+        int bar = (int)(stats->buckets[b] * 50 / most);
+        if ( stats->buckets[b] > 0 && bar == 0 ) { bar = 1; }
+        char bound[24];
+        if ( b == FRAMESTATS_BUCKETS - 1 ) {
+            snprintf(bound, sizeof(bound), ">= %llu us", (unsigned long long)1 << (b - 1));
+        } else {
+            snprintf(bound, sizeof(bound), "< %llu us", (unsigned long long)1 << b);
+        }
+        fprintf(fp, "%12s %10zu %.*s\n", bound, stats->buckets[b], bar, "##################################################");
+    }
+
+}
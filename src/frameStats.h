@@ -0,0 +1,49 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+// frame times go in power-of-two buckets of microseconds: bucket 0 is under
+// 1 us, bucket i is [2^(i-1), 2^i) us, and the last one takes the rest
+#define FRAMESTATS_BUCKETS 24
+
+// framestats sums up what every frame cost: how long it took, the text rows
+// it redrew, the screen cells it wrote and the line allocations it made
+// (`mallocs` of them falling through to the system allocator). the last
+// frame is kept as is for the on-screen display.
+typedef struct {
+
+    size_t frames;
+    size_t buckets[FRAMESTATS_BUCKETS];
+
+    uint64_t ns_total;
+    uint64_t ns_max;
+    size_t rows_total;
+    size_t rows_max;
+    size_t cells_total;
+    size_t cells_max;
+    size_t allocs_total;
+    size_t allocs_max;
+    size_t mallocs_total;
+
+    uint64_t last_ns;
+    size_t last_rows;
+    size_t last_cells;
+    size_t last_allocs;
+    size_t last_mallocs;
+
+} framestats;
+
+textErr framestats_init(framestats** inst);
+textErr framestats_destroy(framestats** inst);
+
+uint64_t framestats_now(void);
+void framestats_record(framestats** inst, uint64_t ns, size_t rows, size_t cells, size_t allocs, size_t mallocs);
+
+// the summary and a histogram of frame times
+void framestats_print(const framestats* stats, FILE* fp);
+
+#endif /* FRAMESTATS_H */
@@ -0,0 +1,470 @@
+#include "lineIndex.h"
+#include "lineScan.h"
+#include "textTrace.h"
+
+#include <string.h>
+#include <unistd.h>
+
+// bytes scanned between checks of the cancel flag
+#define LINEINDEX_SLICE ((size_t)1 << 20)
+
+static textErr lineindex_push(lineindex_part* part, size_t pos, size_t* prev) {
+
+    if ( part->newlines % LINEINDEX_BLOCK == 0 ) {
+
+        if ( part->cp_count == part->cp_cap ) {
+            size_t newcap = part->cp_cap ? part->cp_cap*2 : 256;
+            size_t* pos_grown = (size_t*)realloc(part->cp_pos, sizeof(size_t) * newcap);
+            if ( pos_grown == NULL ) { return ERR_MEM; }
+            part->cp_pos = pos_grown;
+            size_t* byte_grown = (size_t*)realloc(part->cp_byte, sizeof(size_t) * newcap);
+            if ( byte_grown == NULL ) { return ERR_MEM; }
+            part->cp_byte = byte_grown;
+            part->cp_cap = newcap;
+        }
+
+        part->cp_pos[part->cp_count] = pos;
+        part->cp_byte[part->cp_count] = part->stream_len;
+        part->cp_count += 1;
+
+    } else {
+
+        // a size_t delta never needs more than 10 varint bytes
+        if ( part->stream_len + 10 > part->stream_cap ) {
+            size_t newcap = part->stream_cap ? part->stream_cap*2 : 4096;
+            uint8_t* grown = (uint8_t*)realloc(part->stream, newcap);
+            if ( grown == NULL ) { return ERR_MEM; }
+            part->stream = grown;
+            part->stream_cap = newcap;
+        }
+
+        size_t delta = pos - *prev;
+        while ( delta >= 0x80 ) {
+            part->stream[part->stream_len++] = (uint8_t)(delta | 0x80);
+            delta >>= 7;
+        }
+        part->stream[part->stream_len++] = (uint8_t)delta;
+
+    }
+
+    *prev = pos;
+    part->newlines += 1;
+
+    return ERR_NONE;
+
+}
+
+static size_t lineindex_decode(const uint8_t* stream, size_t* byte) {
+
+    size_t value = 0;
+    unsigned shift = 0;
+
+    while ( true ) {
+        uint8_t b = stream[(*byte)++];
+        value |= (size_t)(b & 0x7f) << shift;
+        if ( (b & 0x80) == 0 ) { break; }
+        shift += 7;
+    }
+
+    return value;
+
+}
+
+// called by every worker as it finishes. the last one adds up the parts:
+// each part's base is the newline count of all parts before it.
+static void lineindex_part_done(lineindex_part* part) {
+
+    lineindex* idx = part->owner;
+
+    if ( atomic_fetch_sub_explicit(&idx->pending, 1, memory_order_acq_rel) != 1 ) { return; }
+
+    size_t base = 0;
+    textErr status = ERR_NONE;
+
+    for ( size_t i = 0; i < idx->part_count; i++ ) {
+        idx->parts[i].base = base;
+        base += idx->parts[i].newlines;
+        if ( status == ERR_NONE ) { status = idx->parts[i].status; }
+    }
+
+    idx->newlines = base;
+    idx->status = status;
+    atomic_store_explicit(&idx->ready, 1, memory_order_release);
+
+}
+
+static void* lineindex_worker(void* arg) {
+
+    TRACE_SCOPE(__func__);
+    lineindex_part* part = (lineindex_part*)arg;
+    lineindex* idx = part->owner;
+
+    size_t prev = 0;
+    textErr ret = ERR_NONE;
+
+    for ( size_t slice = part->start; slice < part->end && ret == ERR_NONE; slice += LINEINDEX_SLICE ) {
+
+        if ( atomic_load_explicit(&idx->cancel, memory_order_relaxed) ) {
+            ret = ERR_EOF;
+            break;
+        }
+
+        size_t end = (part->end - slice < LINEINDEX_SLICE) ? part->end : slice + LINEINDEX_SLICE;
+        const char* cur = &idx->data[slice];
+        const char* stop = &idx->data[end];
+
+        while ( cur < stop ) {
+            const char* nl = linescan_find(cur, (size_t)(stop - cur), '\n');
+            if ( nl == NULL ) { break; }
+
+            ret = lineindex_push(part, (size_t)(nl - idx->data), &prev);
+            if ( ret != ERR_NONE ) { break; }
+
+            cur = nl + 1;
+        }
+
+    }
+
+    part->status = ret;
+    lineindex_part_done(part);
+
+    return NULL;
+
+}
+
+// counts-only variant of the worker for streamed files: read the part a
+// slice at a time and record the newlines in each chunk
+static void* lineindex_fd_worker(void* arg) {
+
+    TRACE_SCOPE(__func__);
+    lineindex_part* part = (lineindex_part*)arg;
+    lineindex* idx = part->owner;
+
+    textErr ret = ERR_NONE;
+
+    // slices are whole chunks so no chunk straddles two reads
+    size_t slice_len = LINEINDEX_SLICE - LINEINDEX_SLICE % idx->chunk;
+    if ( slice_len == 0 ) { slice_len = idx->chunk; }
+
+    char* buf = (char*)malloc(slice_len);
+    if ( buf == NULL ) { ret = ERR_MEM; }
+
+    for ( size_t slice = part->start; slice < part->end && ret == ERR_NONE; slice += slice_len ) {
+
+        if ( atomic_load_explicit(&idx->cancel, memory_order_relaxed) ) {
+            ret = ERR_EOF;
+            break;
+        }
+
+        size_t want = (part->end - slice < slice_len) ? part->end - slice : slice_len;
+        size_t got = 0;
+        while ( got < want ) {
+            ssize_t n = pread(idx->fd, buf + got, want - got, (off_t)(slice + got));
+            if ( n <= 0 ) { break; }
+            got += (size_t)n;
+        }
+        if ( got < want ) {
+            ret = ERR_IO;
+            break;
+        }
+
+        for ( size_t off = 0; off < want; off += idx->chunk ) {
+            size_t n = (want - off < idx->chunk) ? want - off : idx->chunk;
+            size_t nl = linescan_count(&buf[off], n, '\n');
+            idx->chunk_nl[(slice + off) / idx->chunk] = nl;
+            part->newlines += nl;
+        }
+
+    }
+
+    free(buf);
+
+    part->status = ret;
+    lineindex_part_done(part);
+
+    return NULL;
+
+}
+
+// cut [0, len) into one part per core, each a multiple of `align` bytes
+// long, and start a worker on each
+static textErr lineindex_spawn(lineindex* idx, size_t align, void* (*worker)(void*)) {
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t count = (cores > 0) ? (size_t)cores : 1;
+    if ( count > LINEINDEX_THREADS_MAX ) { count = LINEINDEX_THREADS_MAX; }
+
+    size_t most = (idx->len + LINEINDEX_MIN_PART - 1) / LINEINDEX_MIN_PART;
+    if ( count > most ) { count = most; }
+    if ( count == 0 ) { count = 1; }
+
+    size_t size = (idx->len + count - 1) / count;
+    size = (size + align - 1) / align * align;
+    if ( size == 0 ) { size = align; }
+
+    // rounding up may leave the last parts with nothing to do
+    count = (idx->len + size - 1) / size;
+    if ( count == 0 ) { count = 1; }
+
+    idx->parts = (lineindex_part*)calloc(count, sizeof(lineindex_part));
+    if ( idx->parts == NULL ) { return ERR_MEM; }
+    idx->part_count = count;
+    atomic_init(&idx->pending, count);
+
+    for ( size_t i = 0; i < count; i++ ) {
+        lineindex_part* part = &idx->parts[i];
+        part->owner = idx;
+        part->start = i * size;
+        part->end = (idx->len - part->start < size) ? idx->len : part->start + size;
+    }
+
+    for ( size_t i = 0; i < count; i++ ) {
+
+        lineindex_part* part = &idx->parts[i];
+        if ( pthread_create(&part->worker, NULL, worker, part) == 0 ) {
+            idx->started += 1;
+            continue;
+        }
+
+        if ( i == 0 ) {
+            free(idx->parts);
+            idx->parts = NULL;
+            return ERR_MEM;
+        }
+
+        // the parts already running still have to be waited for; the index
+        // just won't become usable
+        for ( ; i < count; i++ ) {
+            idx->parts[i].status = ERR_MEM;
+            lineindex_part_done(&idx->parts[i]);
+        }
+
+    }
+
+    return ERR_NONE;
+
+}
+
+textErr lineindex_start(lineindex** inst, const char* data, size_t len) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+    if ( data == NULL && len != 0 ) { return ERR_NULL; }
+
+    ref = (lineindex*)calloc(1, sizeof(lineindex));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    ref->data = data;
+    ref->len = len;
+    ref->fd = -1;
+    atomic_init(&ref->ready, 0);
+    atomic_init(&ref->cancel, 0);
+
+    if ( lineindex_spawn(ref, 4096, lineindex_worker) != ERR_NONE ) {
+        free(ref);
+        ref = NULL;
+        return ERR_MEM;
+    }
+
+    return ERR_NONE;
+
+}
+
+// count the newlines of every `chunk` bytes of the file behind `fd`. the
+// descriptor must stay open until the index is destroyed.
+textErr lineindex_start_fd(lineindex** inst, int fd, size_t len, size_t chunk) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL || fd < 0 || chunk == 0 ) { return ERR_NULL; }
+
+    ref = (lineindex*)calloc(1, sizeof(lineindex));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    ref->len = len;
+    ref->fd = fd;
+    ref->chunk = chunk;
+    ref->chunk_count = (len + chunk - 1) / chunk;
+    atomic_init(&ref->ready, 0);
+    atomic_init(&ref->cancel, 0);
+
+    ref->chunk_nl = (size_t*)calloc(ref->chunk_count ? ref->chunk_count : 1, sizeof(size_t));
+    if ( ref->chunk_nl == NULL ) {
+        free(ref);
+        ref = NULL;
+        return ERR_MEM;
+    }
+
+    // parts are whole chunks so every chunk is counted by a single worker
+    if ( lineindex_spawn(ref, chunk, lineindex_fd_worker) != ERR_NONE ) {
+        free(ref->chunk_nl);
+        free(ref);
+        ref = NULL;
+        return ERR_MEM;
+    }
+
+    return ERR_NONE;
+
+}
+
+textErr lineindex_destroy(lineindex** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    atomic_store(&ref->cancel, 1);
+    for ( size_t i = 0; i < ref->started; i++ ) { pthread_join(ref->parts[i].worker, NULL); }
+
+    for ( size_t i = 0; i < ref->part_count; i++ ) {
+        free(ref->parts[i].stream);
+        free(ref->parts[i].cp_pos);
+        free(ref->parts[i].cp_byte);
+    }
+
+    free(ref->parts);
+    free(ref->chunk_nl);
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
+
+// nonzero once the workers have finished and the index can be queried
+int lineindex_ready(lineindex** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return 0; }
+    if ( !atomic_load_explicit(&ref->ready, memory_order_acquire) ) { return 0; }
+
+    return ref->status == ERR_NONE;
+
+}
+
+textErr lineindex_newlines(lineindex** inst, size_t* newlines) {
+    #define ref (*inst)
+
+    if ( newlines == NULL ) { return ERR_NULL; }
+    if ( !lineindex_ready(inst) ) { return ERR_BUSY; }
+
+    *newlines = ref->newlines;
+
+    return ERR_NONE;
+
+}
+
+// position of the n'th (0-based) newline
+textErr lineindex_nth(lineindex** inst, size_t n, size_t* pos) {
+    #define ref (*inst)
+
+    if ( pos == NULL ) { return ERR_NULL; }
+    if ( !lineindex_ready(inst) ) { return ERR_BUSY; }
+    if ( ref->chunk_nl != NULL ) { return ERR_EOF; }
+    if ( n >= ref->newlines ) { return ERR_EOF; }
+
+    const lineindex_part* part = ref->parts;
+    while ( n >= part->base + part->newlines ) { part += 1; }
+    n -= part->base;
+
+    size_t block = n / LINEINDEX_BLOCK;
+    size_t p = part->cp_pos[block];
+    size_t byte = part->cp_byte[block];
+
+    for ( size_t i = 0; i < n % LINEINDEX_BLOCK; i++ ) {
+        p += lineindex_decode(part->stream, &byte);
+    }
+
+    *pos = p;
+
+    return ERR_NONE;
+
+}
+
+// number of newlines strictly before `offset`
+textErr lineindex_count_before(lineindex** inst, size_t offset, size_t* count) {
+    #define ref (*inst)
+
+    if ( count == NULL ) { return ERR_NULL; }
+    if ( !lineindex_ready(inst) ) { return ERR_BUSY; }
+    if ( ref->chunk_nl != NULL ) { return ERR_EOF; }
+
+    if ( offset == 0 ) {
+        *count = 0;
+        return ERR_NONE;
+    }
+
+    // the part holding the last byte before offset
+    const lineindex_part* part = &ref->parts[ref->part_count - 1];
+    for ( size_t i = 0; i < ref->part_count; i++ ) {
+        if ( offset - 1 < ref->parts[i].end ) {
+            part = &ref->parts[i];
+            break;
+        }
+    }
+
+    // last block whose first newline lies before offset
+    size_t lo = 0;
+    size_t hi = part->cp_count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( part->cp_pos[mid] < offset ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if ( lo == 0 ) {
+        *count = part->base;
+        return ERR_NONE;
+    }
+
+    size_t block = lo - 1;
+    size_t p = part->cp_pos[block];
+    size_t byte = part->cp_byte[block];
+    size_t n = block * LINEINDEX_BLOCK + 1;
+
+    size_t in_block = part->newlines - block * LINEINDEX_BLOCK;
+    if ( in_block > LINEINDEX_BLOCK ) { in_block = LINEINDEX_BLOCK; }
+
+    for ( size_t i = 1; i < in_block; i++ ) {
+        p += lineindex_decode(part->stream, &byte);
+        if ( p >= offset ) { break; }
+        n += 1;
+    }
+
+    *count = part->base + n;
+
+    return ERR_NONE;
+
+}
+
+// number of newlines in [start, start+len). a counts-only index can only
+// answer for a single whole chunk and returns ERR_EOF for anything else.
+textErr lineindex_count_range(lineindex** inst, size_t start, size_t len, size_t* count) {
+    #define ref (*inst)
+
+    if ( count == NULL ) { return ERR_NULL; }
+    if ( !lineindex_ready(inst) ) { return ERR_BUSY; }
+
+    if ( ref->chunk_nl != NULL ) {
+        size_t chunk = start / ref->chunk;
+        if ( start % ref->chunk != 0 || chunk >= ref->chunk_count ) { return ERR_EOF; }
+        if ( len != ref->chunk && start + len != ref->len ) { return ERR_EOF; }
+        *count = ref->chunk_nl[chunk];
+        return ERR_NONE;
+    }
+
+    size_t before = 0;
+    size_t through = 0;
+    textErr ret = lineindex_count_before(inst, start, &before);
+    if ( ret != ERR_NONE ) { return ret; }
+    ret = lineindex_count_before(inst, start + len, &through);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    *count = through - before;
+
+    return ERR_NONE;
+
+}
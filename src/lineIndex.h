@@ -0,0 +1,94 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+// newlines between two checkpoints in the compressed stream
+#define LINEINDEX_BLOCK 128
+
+// ranges smaller than this aren't worth a thread of their own
+#define LINEINDEX_MIN_PART ((size_t)8 << 20)
+#define LINEINDEX_THREADS_MAX 16
+
+struct lineindex;
+
+// one range of the file, indexed by its own thread. positions are absolute;
+// `base` is the number of newlines in all earlier parts, filled in once
+// every part is done.
+typedef struct {
+
+    struct lineindex* owner;
+    pthread_t worker;
+
+    size_t start;
+    size_t end;
+
+    uint8_t* stream;
+    size_t stream_len;
+    size_t stream_cap;
+
+    // first newline of each block and where its successors start in `stream`
+    size_t* cp_pos;
+    size_t* cp_byte;
+    size_t cp_count;
+    size_t cp_cap;
+
+    size_t newlines;
+    size_t base;
+
+    textErr status;
+
+} lineindex_part;
+
+// lineindex records the position of every newline in a read-only buffer.
+// positions are stored as LEB128 varint deltas (usually one or two bytes per
+// line) with an absolute checkpoint every LINEINDEX_BLOCK newlines, so any
+// lookup decodes at most one block.
+// the buffer is split into up to one range per core and each range is
+// indexed on its own thread with the vectorized newline scanner; the last
+// thread to finish prefix-sums the per-range counts so lookups can pick the
+// right range. nothing but `ready` may be touched until it is set.
+// for files that are too big to keep per-line data for, an index started
+// with lineindex_start_fd reads the file with pread and only keeps the
+// newline count of every `chunk` bytes; it answers lineindex_count_range for
+// chunk-aligned ranges and nothing else.
+typedef struct lineindex {
+
+    const char* data;
+    size_t len;
+
+    int fd;
+    size_t chunk;
+    size_t* chunk_nl;
+    size_t chunk_count;
+
+    lineindex_part* parts;
+    size_t part_count;
+    size_t started;
+
+    size_t newlines;
+
+    atomic_size_t pending;
+    atomic_int ready;
+    atomic_int cancel;
+    textErr status;
+
+} lineindex;
+
+textErr lineindex_start(lineindex** inst, const char* data, size_t len);
+textErr lineindex_start_fd(lineindex** inst, int fd, size_t len, size_t chunk);
+textErr lineindex_destroy(lineindex** inst);
+
+int lineindex_ready(lineindex** inst);
+
+textErr lineindex_newlines(lineindex** inst, size_t* newlines);
+textErr lineindex_nth(lineindex** inst, size_t n, size_t* pos);
+textErr lineindex_count_before(lineindex** inst, size_t offset, size_t* count);
+textErr lineindex_count_range(lineindex** inst, size_t start, size_t len, size_t* count);
+
+#endif /* LINEINDEX_H */
@@ -0,0 +1,180 @@
+#include "linePool.h"
+#include "textMan.h"
+
+// free blocks store the next pointer in their first bytes
+typedef struct linepool_free {
+    struct linepool_free* next;
+} linepool_free;
+
+static textErr linepool_add_slab(linepool** inst, size_t size, void** slab) {
+
+    #define ref (*inst)
+
+    if ( ref->slab_count == ref->slab_cap ) {
+        size_t newcap = ref->slab_cap ? ref->slab_cap*2 : 16;
+        void** grown = (void**)realloc(ref->slabs, sizeof(void*) * newcap);
+        if ( grown == NULL ) { return ERR_MEM; }
+        ref->slabs = grown;
+        ref->slab_cap = newcap;
+    }
+
+    *slab = malloc(size);
+    if ( *slab == NULL ) { return ERR_MEM; }
+
+    ref->slabs[ref->slab_count] = *slab;
+    ref->slab_count += 1;
+    ref->mallocs += 1;
+
+    return ERR_NONE;
+
+}
+
+// size class whose blocks hold `size` bytes
+static size_t linepool_class(size_t size) {
+
+    size_t cls = 0;
+    while ( ((size_t)1 << (LINEPOOL_MIN_SHIFT + cls)) < size ) { cls += 1; }
+
+    return cls;
+
+}
+
+textErr linepool_init(linepool** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    ref = (linepool*)calloc(1, sizeof(linepool));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    return ERR_NONE;
+
+}
+
+textErr linepool_destroy(linepool** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    for ( size_t i = 0; i < ref->slab_count; i++ ) {
+        free(ref->slabs[i]);
+    }
+    free(ref->slabs);
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
+
+textErr linepool_alloc_node(linepool** inst, struct linebuf** node) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || node == NULL ) { return ERR_NULL; }
+
+    if ( ref->free_nodes == NULL ) {
+
+        void* slab = NULL;
+        textErr ret = linepool_add_slab(inst, sizeof(linebuf) * LINEPOOL_NODES_PER_SLAB, &slab);
+        if ( ret != ERR_NONE ) { return ret; }
+
+        linebuf* nodes = (linebuf*)slab;
+        for ( size_t i = 0; i < LINEPOOL_NODES_PER_SLAB; i++ ) {
+            linepool_free* f = (linepool_free*)&nodes[i];
+            f->next = (linepool_free*)ref->free_nodes;
+            ref->free_nodes = f;
+        }
+
+    }
+
+    linebuf* n = (linebuf*)ref->free_nodes;
+    ref->free_nodes = ((linepool_free*)n)->next;
+
+    memset(n, 0, sizeof(linebuf));
+    ref->nodes_live += 1;
+    ref->allocs += 1;
+
+    *node = n;
+
+    return ERR_NONE;
+
+}
+
+void linepool_free_node(linepool** inst, struct linebuf* node) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || node == NULL ) { return; }
+
+    linepool_free* f = (linepool_free*)node;
+    f->next = (linepool_free*)ref->free_nodes;
+    ref->free_nodes = f;
+    ref->nodes_live -= 1;
+
+}
+
+// hand out a block of at least `size` bytes. `cap` is set to the usable
+// size, which is what linepool_free_text needs back.
+textErr linepool_alloc_text(linepool** inst, size_t size, char** text, size_t* cap) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || text == NULL || cap == NULL ) { return ERR_NULL; }
+
+    ref->allocs += 1;
+
+    if ( size > LINEPOOL_MAX_BLOCK ) {
+        *text = (char*)malloc(size);
+        if ( *text == NULL ) { return ERR_MEM; }
+        ref->mallocs += 1;
+        *cap = size;
+        return ERR_NONE;
+    }
+
+    size_t cls = linepool_class(size);
+    size_t block = (size_t)1 << (LINEPOOL_MIN_SHIFT + cls);
+
+    if ( ref->free_text[cls] == NULL ) {
+
+        size_t slabsize = (block * 4 > LINEPOOL_SLAB_SIZE) ? block * 4 : LINEPOOL_SLAB_SIZE;
+
+        void* slab = NULL;
+        textErr ret = linepool_add_slab(inst, slabsize, &slab);
+        if ( ret != ERR_NONE ) { return ret; }
+
+        for ( size_t off = 0; off + block <= slabsize; off += block ) {
+            linepool_free* f = (linepool_free*)((char*)slab + off);
+            f->next = (linepool_free*)ref->free_text[cls];
+            ref->free_text[cls] = f;
+        }
+
+    }
+
+    linepool_free* f = (linepool_free*)ref->free_text[cls];
+    ref->free_text[cls] = f->next;
+    ref->text_live += block;
+
+    *text = (char*)f;
+    *cap = block;
+
+    return ERR_NONE;
+
+}
+
+void linepool_free_text(linepool** inst, char* text, size_t cap) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || text == NULL ) { return; }
+
+    if ( cap > LINEPOOL_MAX_BLOCK ) {
+        free(text);
+        return;
+    }
+
+    size_t cls = linepool_class(cap);
+
+    linepool_free* f = (linepool_free*)text;
+    f->next = (linepool_free*)ref->free_text[cls];
+    ref->free_text[cls] = f;
+    ref->text_live -= cap;
+
+}
@@ -0,0 +1,51 @@
+#ifndef LINEPOOL_H
+#define LINEPOOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+struct linebuf;
+
+// text blocks come in power-of-two classes from 16 bytes to 64 KiB; longer
+// lines go straight to malloc
+#define LINEPOOL_MIN_SHIFT 4
+#define LINEPOOL_CLASSES 13
+#define LINEPOOL_MAX_BLOCK ((size_t)1 << (LINEPOOL_MIN_SHIFT + LINEPOOL_CLASSES - 1))
+
+#define LINEPOOL_SLAB_SIZE ((size_t)256 * 1024)
+#define LINEPOOL_NODES_PER_SLAB 256
+
+// linepool recycles linebuf nodes and their text. both are carved out of
+// large slabs and returned to per-class free lists instead of the system
+// allocator, so lines scrolling through the viewport don't malloc or free
+// once the pool has warmed up. slabs are only released by linepool_destroy.
+typedef struct linepool {
+
+    void* free_nodes;
+    void* free_text[LINEPOOL_CLASSES];
+
+    void** slabs;
+    size_t slab_count;
+    size_t slab_cap;
+
+    size_t nodes_live;
+    size_t text_live;
+
+    // nodes and blocks handed out, and how many of those went to malloc
+    // (new slabs and blocks too long for a class)
+    size_t allocs;
+    size_t mallocs;
+
+} linepool;
+
+textErr linepool_init(linepool** inst);
+textErr linepool_destroy(linepool** inst);
+
+textErr linepool_alloc_node(linepool** inst, struct linebuf** node);
+void linepool_free_node(linepool** inst, struct linebuf* node);
+
+textErr linepool_alloc_text(linepool** inst, size_t size, char** text, size_t* cap);
+void linepool_free_text(linepool** inst, char* text, size_t cap);
+
+#endif /* LINEPOOL_H */
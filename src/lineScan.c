@@ -0,0 +1,412 @@
+#include "lineScan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LINESCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef struct {
+
+    const char* name;
+    const char* (*find)(const char*, size_t, char);
+    const char* (*rfind)(const char*, size_t, char);
+    size_t (*count)(const char*, size_t, char);
+    const char* (*find_str)(const char*, size_t, const char*, size_t);
+    const char* (*rfind_str)(const char*, size_t, const char*, size_t);
+    const char* (*terminator)(const char*);
+
+} linescan_impl;
+
+// SCALAR
+
+static const char* linescan_find_scalar(const char* data, size_t len, char c) {
+
+    for ( size_t i = 0; i < len; i++ ) {
+        if ( data[i] == c ) { return &data[i]; }
+    }
+
+    return NULL;
+
+}
+
+static const char* linescan_rfind_scalar(const char* data, size_t len, char c) {
+
+    for ( size_t i = len; i > 0; i-- ) {
+        if ( data[i-1] == c ) { return &data[i-1]; }
+    }
+
+    return NULL;
+
+}
+
+static size_t linescan_count_scalar(const char* data, size_t len, char c) {
+
+    size_t count = 0;
+    for ( size_t i = 0; i < len; i++ ) {
+        count += (data[i] == c);
+    }
+
+    return count;
+
+}
+
+// callers guarantee 2 <= patlen <= len for the _str kernels; the public
+// wrappers handle the rest
+
+static const char* linescan_find_str_scalar(const char* data, size_t len, const char* pat, size_t patlen) {
+
+    const char last = pat[patlen-1];
+
+    for ( size_t i = 0; i + patlen <= len; i++ ) {
+        if ( data[i] == pat[0] && data[i+patlen-1] == last && memcmp(&data[i+1], &pat[1], patlen-2) == 0 ) {
+            return &data[i];
+        }
+    }
+
+    return NULL;
+
+}
+
+static const char* linescan_rfind_str_scalar(const char* data, size_t len, const char* pat, size_t patlen) {
+
+    const char last = pat[patlen-1];
+
+    for ( size_t i = len - patlen + 1; i > 0; i-- ) {
+        const char* at = &data[i-1];
+        if ( at[0] == pat[0] && at[patlen-1] == last && memcmp(&at[1], &pat[1], patlen-2) == 0 ) {
+            return at;
+        }
+    }
+
+    return NULL;
+
+}
+
+static const char* linescan_terminator_scalar(const char* str) {
+
+    while ( *str != '\n' && *str != '\0' ) { str++; }
+
+    return str;
+
+}
+
+#ifdef LINESCAN_X86
+
+// SSE2
+
+__attribute__((target("sse2")))
+static const char* linescan_find_sse2(const char* data, size_t len, char c) {
+
+    const __m128i needle = _mm_set1_epi8(c);
+
+    size_t i = 0;
+    for ( ; i + 16 <= len; i += 16 ) {
+        __m128i v = _mm_loadu_si128((const __m128i*)&data[i]);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if ( mask ) { return &data[i + (size_t)__builtin_ctz(mask)]; }
+    }
+
+    return linescan_find_scalar(&data[i], len - i, c);
+
+}
+
+__attribute__((target("sse2")))
+static const char* linescan_rfind_sse2(const char* data, size_t len, char c) {
+
+    const __m128i needle = _mm_set1_epi8(c);
+
+    size_t i = len;
+    for ( ; i >= 16; i -= 16 ) {
+        __m128i v = _mm_loadu_si128((const __m128i*)&data[i - 16]);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if ( mask ) { return &data[i - 16 + (size_t)(31 - __builtin_clz(mask))]; }
+    }
+
+    return linescan_rfind_scalar(data, i, c);
+
+}
+
+__attribute__((target("sse2")))
+static size_t linescan_count_sse2(const char* data, size_t len, char c) {
+
+    const __m128i needle = _mm_set1_epi8(c);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t count = 0;
+    size_t i = 0;
+
+    // compare results are -1 per match, so subtracting them counts matches
+    // per byte lane. lanes are flushed into 64 bit sums before they can wrap.
+    while ( i + 16 <= len ) {
+        __m128i acc = _mm_setzero_si128();
+        size_t stop = len - i < 255*16 ? len - (len - i) % 16 : i + 255*16;
+        for ( ; i < stop; i += 16 ) {
+            __m128i v = _mm_loadu_si128((const __m128i*)&data[i]);
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, needle));
+        }
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += (size_t)_mm_cvtsi128_si64(sums) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+
+    return count + linescan_count_scalar(&data[i], len - i, c);
+
+}
+
+// candidate starts are where the first byte matches and the byte
+// patlen-1 further on matches the last one
+__attribute__((target("sse2")))
+static const char* linescan_find_str_sse2(const char* data, size_t len, const char* pat, size_t patlen) {
+
+    const __m128i first = _mm_set1_epi8(pat[0]);
+    const __m128i last = _mm_set1_epi8(pat[patlen-1]);
+
+    size_t i = 0;
+    for ( ; i + patlen - 1 + 16 <= len; i += 16 ) {
+        __m128i a = _mm_loadu_si128((const __m128i*)&data[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&data[i + patlen - 1]);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while ( mask ) {
+            const char* at = &data[i + (size_t)__builtin_ctz(mask)];
+            if ( memcmp(&at[1], &pat[1], patlen-2) == 0 ) { return at; }
+            mask &= mask - 1;
+        }
+    }
+
+    return linescan_find_str_scalar(&data[i], len - i, pat, patlen);
+
+}
+
+__attribute__((target("sse2")))
+static const char* linescan_rfind_str_sse2(const char* data, size_t len, const char* pat, size_t patlen) {
+
+    const __m128i first = _mm_set1_epi8(pat[0]);
+    const __m128i last = _mm_set1_epi8(pat[patlen-1]);
+
+    // `starts` candidate positions are left; check the highest 16 each round
+    size_t starts = len - patlen + 1;
+    for ( ; starts >= 16; starts -= 16 ) {
+        size_t i = starts - 16;
+        __m128i a = _mm_loadu_si128((const __m128i*)&data[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&data[i + patlen - 1]);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while ( mask ) {
+            unsigned bit = 31 - (unsigned)__builtin_clz(mask);
+            const char* at = &data[i + bit];
+            if ( memcmp(&at[1], &pat[1], patlen-2) == 0 ) { return at; }
+            mask &= ~(1u << bit);
+        }
+    }
+
+    if ( starts == 0 ) { return NULL; }
+
+    return linescan_rfind_str_scalar(data, starts + patlen - 1, pat, patlen);
+
+}
+
+// aligned loads never cross a page boundary, so reading the rest of the
+// block that holds the terminator is safe even though it's past the string
+__attribute__((target("sse2"), no_sanitize_address))
+static const char* linescan_terminator_sse2(const char* str) {
+
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t misalign = (uintptr_t)str & 15;
+    const char* block = str - misalign;
+
+    __m128i v = _mm_load_si128((const __m128i*)block);
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, zero)));
+    mask &= ~0u << misalign;
+
+    while ( mask == 0 ) {
+        block += 16;
+        v = _mm_load_si128((const __m128i*)block);
+        mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, zero)));
+    }
+
+    return block + __builtin_ctz(mask);
+
+}
+
+// AVX2
+
+__attribute__((target("avx2")))
+static const char* linescan_find_avx2(const char* data, size_t len, char c) {
+
+    const __m256i needle = _mm256_set1_epi8(c);
+
+    size_t i = 0;
+    for ( ; i + 32 <= len; i += 32 ) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)&data[i]);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+        if ( mask ) { return &data[i + (size_t)__builtin_ctz(mask)]; }
+    }
+
+    return linescan_find_sse2(&data[i], len - i, c);
+
+}
+
+__attribute__((target("avx2")))
+static const char* linescan_rfind_avx2(const char* data, size_t len, char c) {
+
+    const __m256i needle = _mm256_set1_epi8(c);
+
+    size_t i = len;
+    for ( ; i >= 32; i -= 32 ) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)&data[i - 32]);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+        if ( mask ) { return &data[i - 32 + (size_t)(31 - __builtin_clz(mask))]; }
+    }
+
+    return linescan_rfind_sse2(data, i, c);
+
+}
+
+__attribute__((target("avx2")))
+static size_t linescan_count_avx2(const char* data, size_t len, char c) {
+
+    const __m256i needle = _mm256_set1_epi8(c);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t count = 0;
+    size_t i = 0;
+
+    while ( i + 32 <= len ) {
+        __m256i acc = _mm256_setzero_si256();
+        size_t stop = len - i < 255*32 ? len - (len - i) % 32 : i + 255*32;
+        for ( ; i < stop; i += 32 ) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)&data[i]);
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, needle));
+        }
+        __m256i sums = _mm256_sad_epu8(acc, zero);
+        count += (size_t)_mm256_extract_epi64(sums, 0) + (size_t)_mm256_extract_epi64(sums, 1)
+               + (size_t)_mm256_extract_epi64(sums, 2) + (size_t)_mm256_extract_epi64(sums, 3);
+    }
+
+    return count + linescan_count_sse2(&data[i], len - i, c);
+
+}
+
+__attribute__((target("avx2")))
+static const char* linescan_find_str_avx2(const char* data, size_t len, const char* pat, size_t patlen) {
+
+    const __m256i first = _mm256_set1_epi8(pat[0]);
+    const __m256i last = _mm256_set1_epi8(pat[patlen-1]);
+
+    size_t i = 0;
+    for ( ; i + patlen - 1 + 32 <= len; i += 32 ) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&data[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&data[i + patlen - 1]);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while ( mask ) {
+            const char* at = &data[i + (size_t)__builtin_ctz(mask)];
+            if ( memcmp(&at[1], &pat[1], patlen-2) == 0 ) { return at; }
+            mask &= mask - 1;
+        }
+    }
+
+    return linescan_find_str_sse2(&data[i], len - i, pat, patlen);
+
+}
+
+__attribute__((target("avx2")))
+static const char* linescan_rfind_str_avx2(const char* data, size_t len, const char* pat, size_t patlen) {
+
+    const __m256i first = _mm256_set1_epi8(pat[0]);
+    const __m256i last = _mm256_set1_epi8(pat[patlen-1]);
+
+    size_t starts = len - patlen + 1;
+    for ( ; starts >= 32; starts -= 32 ) {
+        size_t i = starts - 32;
+        __m256i a = _mm256_loadu_si256((const __m256i*)&data[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&data[i + patlen - 1]);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while ( mask ) {
+            unsigned bit = 31 - (unsigned)__builtin_clz(mask);
+            const char* at = &data[i + bit];
+            if ( memcmp(&at[1], &pat[1], patlen-2) == 0 ) { return at; }
+            mask &= ~(1u << bit);
+        }
+    }
+
+    if ( starts == 0 ) { return NULL; }
+
+    return linescan_rfind_str_sse2(data, starts + patlen - 1, pat, patlen);
+
+}
+
+#endif /* LINESCAN_X86 */
+
+static linescan_impl linescan_active = {
+    "scalar",
+    linescan_find_scalar,
+    linescan_rfind_scalar,
+    linescan_count_scalar,
+    linescan_find_str_scalar,
+    linescan_rfind_str_scalar,
+    linescan_terminator_scalar,
+};
+
+__attribute__((constructor))
+static void linescan_resolve(void) {
+
+    #ifdef LINESCAN_X86
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("avx2") ) {
+        linescan_active.name = "avx2";
+        linescan_active.find = linescan_find_avx2;
+        linescan_active.rfind = linescan_rfind_avx2;
+        linescan_active.count = linescan_count_avx2;
+        linescan_active.find_str = linescan_find_str_avx2;
+        linescan_active.rfind_str = linescan_rfind_str_avx2;
+        linescan_active.terminator = linescan_terminator_sse2;
+    } else if ( __builtin_cpu_supports("sse2") ) {
+        linescan_active.name = "sse2";
+        linescan_active.find = linescan_find_sse2;
+        linescan_active.rfind = linescan_rfind_sse2;
+        linescan_active.count = linescan_count_sse2;
+        linescan_active.find_str = linescan_find_str_sse2;
+        linescan_active.rfind_str = linescan_rfind_str_sse2;
+        linescan_active.terminator = linescan_terminator_sse2;
+    }
+    #endif
+
+}
+
+const char* linescan_find(const char* data, size_t len, char c) {
+    return linescan_active.find(data, len, c);
+}
+
+const char* linescan_rfind(const char* data, size_t len, char c) {
+    return linescan_active.rfind(data, len, c);
+}
+
+size_t linescan_count(const char* data, size_t len, char c) {
+    return linescan_active.count(data, len, c);
+}
+
+const char* linescan_find_str(const char* data, size_t len, const char* pat, size_t patlen) {
+    if ( patlen == 0 ) { return data; }
+    if ( patlen > len ) { return NULL; }
+    if ( patlen == 1 ) { return linescan_active.find(data, len, pat[0]); }
+    return linescan_active.find_str(data, len, pat, patlen);
+}
+
+const char* linescan_rfind_str(const char* data, size_t len, const char* pat, size_t patlen) {
+    if ( patlen == 0 ) { return data + len; }
+    if ( patlen > len ) { return NULL; }
+    if ( patlen == 1 ) { return linescan_active.rfind(data, len, pat[0]); }
+    return linescan_active.rfind_str(data, len, pat, patlen);
+}
+
+const char* linescan_terminator(const char* str) {
+    return linescan_active.terminator(str);
+}
+
+const char* linescan_backend(void) {
+    return linescan_active.name;
+}
@@ -0,0 +1,25 @@
+#ifndef LINESCAN_H
+#define LINESCAN_H
+
+#include <stddef.h>
+
+// vectorized byte scanners used for every line-boundary search. the kernel
+// (AVX2, SSE2 or scalar) is picked once at startup from what the CPU
+// supports; all variants return identical results.
+
+const char* linescan_find(const char* data, size_t len, char c);
+const char* linescan_rfind(const char* data, size_t len, char c);
+size_t linescan_count(const char* data, size_t len, char c);
+
+// first / last occurrence of `pat` in `data`. candidates are filtered on the
+// pattern's first and last byte a vector at a time and only those are
+// compared in full.
+const char* linescan_find_str(const char* data, size_t len, const char* pat, size_t patlen);
+const char* linescan_rfind_str(const char* data, size_t len, const char* pat, size_t patlen);
+
+// first '\n' or '\0' in a NUL-terminated string
+const char* linescan_terminator(const char* str);
+
+const char* linescan_backend(void);
+
+#endif /* LINESCAN_H */
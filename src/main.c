@@ -1,79 +1,128 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include <ncurses.h>
+#include <unistd.h>
 
 #include "textErr.h"
+#include "eventLoop.h"
+#include "fileMap.h"
+#include "frameStats.h"
+#include "termScreen.h"
 #include "textMan.h"
+#include "textTrace.h"
 #include "windowMan.h"
 
 #define REQUIRED_ARGS \
     REQUIRED_STRING_ARG(input_file, "input", "Input file path") \
 
+#define OPTIONAL_ARGS \
+    OPTIONAL_SIZE_ARG(undo_mb, (size_t)16, "--undo-mb", "MiB", "Memory kept for undo history") \
+
+#define BOOLEAN_ARGS \
+    BOOLEAN_ARG(stream, "--stream", "Read the file on demand instead of mapping it") \
+    BOOLEAN_ARG(stats, "--stats", "Show frame costs on screen and print a summary at exit") \
+
 #include "easyargs.h"
 
 int main(int argc, char** argv) {
 
+    TRACE_MAIN();
+
     args_t args = make_default_args();
 
     if (!parse_args(argc, argv, &args)) {
         return 1;
     }
 
-    FILE* fptr = fopen(args.input_file, "rb");
-    if ( fptr == NULL ) {
-        printf("Failed to open <%s>\n", args.input_file);
+    // map the file instead of reading it; pages are only faulted in as the
+    // viewport reaches them. huge files (or --stream) are read on demand
+    // into a fixed-size cache instead.
+    filemap* map = NULL;
+    textErr ret = args.stream ? filemap_stream(&map, args.input_file) : filemap_open(&map, args.input_file);
+    if ( ret != ERR_NONE ) {
+        printf("Failed to open <%s>, reason: %s\n", args.input_file, textErr_tostr(ret));
         return 1;
     }
 
-    fseek(fptr, 0, SEEK_END);
-    long file_size = ftell(fptr);
-    rewind(fptr);
-
-    // Allocate an extra byte and NUL-terminate to make strlen-safe consumers happy
-    char* strbuf = (char*)calloc(sizeof(char), (size_t)file_size + 1);
-    if ( strbuf == NULL ) { return 1; }
-
-    size_t bytes_read = fread(strbuf, 1, (size_t)file_size, fptr);
-    (void)bytes_read; // bytes_read may be less than file_size; buffer remains NUL-terminated
-    strbuf[file_size] = '\0';
-
-    fclose(fptr);
-
     filebuf* file_ctx = NULL;
-    textErr ret = filebuf_init(&file_ctx, 1);
+    ret = filebuf_init(&file_ctx, 1);
     if ( ret != ERR_NONE ) { 
         printf("Failed to initialize filebuf, reason: %s\n", textErr_tostr(ret));
         return 1;
     }
 
-    ret = filebuf_load(&file_ctx, strbuf, args.input_file);
+    undojournal_limit(&file_ctx->journal, args.undo_mb << 20);
+
+    ret = filebuf_load(&file_ctx, map, args.input_file);
     if ( ret != ERR_NONE ) { 
         printf("Failed to load data to filebuf, reason: %s\n", textErr_tostr(ret));
         return 1;
     }
 
-    windowman_t* window_ctx;
+    termscreen* screen = NULL;
+    ret = termscreen_curses(&screen);
+    if ( ret != ERR_NONE ) {
+        printf("Failed to initialize the terminal, reason: %s\n", textErr_tostr(ret));
+        return 1;
+    }
+
+    windowman_t* window_ctx = NULL;
 
-    ret = windowman_init(&window_ctx);
+    ret = windowman_init(&window_ctx, screen);
     if ( ret != ERR_NONE ) {
+        termscreen_destroy(&screen);
         printf("Failed to initialize window manager, reason: %s\n", textErr_tostr(ret));
+        return 1;
+    }
+
+    framestats* stats = NULL;
+    if ( args.stats && framestats_init(&stats) == ERR_NONE ) { window_ctx->stats = stats; }
+
+    eventloop* loop = NULL;
+    ret = eventloop_init(&loop, STDIN_FILENO);
+    if ( ret != ERR_NONE ) {
         windowman_destroy(&window_ctx);
+        termscreen_destroy(&screen);
+        if ( stats != NULL ) { framestats_destroy(&stats); }
+        printf("Failed to initialize event loop, reason: %s\n", textErr_tostr(ret));
         return 1;
     }
 
-    while (true) {
+    // draw only when something happened: a key, a resize or a timer the
+    // renderer asked for
+    while ( !window_ctx->quit ) {
 
         windowman_render(window_ctx, file_ctx);
 
+        if ( window_ctx->dirty ) { continue; }
+
+        event_kind event = EVENT_TIMER;
+        ret = eventloop_wait(&loop, window_ctx->wake_ms, &event);
+        if ( ret != ERR_NONE || event == EVENT_QUIT ) { break; }
+
     }
 
+    eventloop_destroy(&loop);
+
     ret = windowman_destroy(&window_ctx);
+    termscreen_destroy(&screen);
     if ( ret != ERR_NONE ) {
         printf("Failed to close window manager, reason: %s\n", textErr_tostr(ret));
         return 1;
     }
 
+    filebuf_destroy(&file_ctx);
+
+    // with tracing built in, the session's trace goes to the working
+    // directory once the background threads are gone
+    TRACE_WRITE("textedit-trace.json");
+
+    // the terminal is back to normal, so the summary stays on screen
+    if ( stats != NULL ) {
+        framestats_print(stats, stdout);
+        framestats_destroy(&stats);
+    }
+
     return 0;
 
 }
\ No newline at end of file
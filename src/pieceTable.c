@@ -0,0 +1,751 @@
+#include "pieceTable.h"
+#include "lineScan.h"
+
+#define node_len(n) ((n) ? (n)->sub_len : 0)
+#define node_nl(n) ((n) ? (n)->sub_nl : 0)
+#define node_unknown(n) ((n) ? (n)->sub_unknown : 0)
+
+static uint32_t piecetable_rand(piecetable* pt) {
+
+    // xorshift32, only used to pick treap priorities
+    uint32_t x = pt->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pt->seed = x;
+
+    return x;
+
+}
+
+static void piecenode_update(piecenode* n) {
+
+    n->sub_len = node_len(n->left) + n->p.len + node_len(n->right);
+    n->sub_nl = node_nl(n->left) + node_nl(n->right);
+    n->sub_unknown = node_unknown(n->left) + node_unknown(n->right);
+
+    if ( n->nl == PIECE_NL_UNKNOWN ) {
+        n->sub_unknown += 1;
+    } else {
+        n->sub_nl += n->nl;
+    }
+
+}
+
+static piecenode* piecenode_new(piecetable* pt, piece_src src, size_t start, size_t len, size_t nl) {
+
+    piecenode* n = (piecenode*)calloc(1, sizeof(piecenode));
+    if ( n == NULL ) { return NULL; }
+
+    n->p.src = src;
+    n->p.start = start;
+    n->p.len = len;
+    n->nl = nl;
+    n->priority = piecetable_rand(pt);
+
+    piecenode_update(n);
+
+    pt->count += 1;
+
+    return n;
+
+}
+
+static void piecenode_free(piecetable* pt, piecenode* n) {
+
+    if ( n == NULL ) { return; }
+
+    piecenode_free(pt, n->left);
+    piecenode_free(pt, n->right);
+    free(n);
+
+    pt->count -= 1;
+
+}
+
+static piecenode* piecenode_merge(piecenode* a, piecenode* b) {
+
+    if ( a == NULL ) { return b; }
+    if ( b == NULL ) { return a; }
+
+    if ( a->priority > b->priority ) {
+        a->right = piecenode_merge(a->right, b);
+        piecenode_update(a);
+        return a;
+    }
+
+    b->left = piecenode_merge(a, b->left);
+    piecenode_update(b);
+    return b;
+
+}
+
+// split `n` into the first `pos` bytes and the rest. a position inside a
+// piece cuts it in two; the second half goes into `*spare`, which the caller
+// allocates up front so the split itself can't fail halfway through.
+static void piecenode_split(piecetable* pt, piecenode* n, size_t pos, piecenode** l, piecenode** r, piecenode** spare) {
+
+    if ( n == NULL ) {
+        *l = NULL;
+        *r = NULL;
+        return;
+    }
+
+    size_t leftlen = node_len(n->left);
+
+    if ( pos <= leftlen ) {
+
+        piecenode* rest = NULL;
+        piecenode_split(pt, n->left, pos, l, &rest, spare);
+        n->left = rest;
+        piecenode_update(n);
+        *r = n;
+
+    } else if ( pos >= leftlen + n->p.len ) {
+
+        piecenode* rest = NULL;
+        piecenode_split(pt, n->right, pos - leftlen - n->p.len, &rest, r, spare);
+        n->right = rest;
+        piecenode_update(n);
+        *l = n;
+
+    } else {
+
+        size_t inner = pos - leftlen;
+
+        piecenode* tail = *spare;
+        *spare = NULL;
+
+        tail->left = NULL;
+        tail->right = NULL;
+        tail->p.src = n->p.src;
+        tail->p.start = n->p.start + inner;
+        tail->p.len = n->p.len - inner;
+        tail->nl = PIECE_NL_UNKNOWN;
+
+        // keep counts known across the split by scanning the shorter half.
+        // only then is the text needed, which for a streamed file is a read
+        if ( n->nl != PIECE_NL_UNKNOWN ) {
+            const char* data = piece_data(pt, &n->p);
+            if ( inner <= tail->p.len ) {
+                size_t head_nl = linescan_count(data, inner, '\n');
+                tail->nl = n->nl - head_nl;
+                n->nl = head_nl;
+            } else {
+                tail->nl = linescan_count(data + inner, tail->p.len, '\n');
+                n->nl -= tail->nl;
+            }
+        }
+
+        n->p.len = inner;
+        piecenode_update(tail);
+
+        *r = piecenode_merge(tail, n->right);
+        n->right = NULL;
+        piecenode_update(n);
+        *l = n;
+
+    }
+
+}
+
+// grow the last piece of `n` if it ends exactly where the add buffer did
+// before `len` more bytes were appended to it
+static int piecenode_extend_last(piecenode* n, size_t addstart, size_t len, size_t nl) {
+
+    if ( n == NULL ) { return 0; }
+
+    if ( n->right != NULL ) {
+        if ( !piecenode_extend_last(n->right, addstart, len, nl) ) { return 0; }
+        piecenode_update(n);
+        return 1;
+    }
+
+    if ( n->p.src != PIECE_ADD || n->p.start + n->p.len != addstart ) { return 0; }
+
+    n->p.len += len;
+    if ( n->nl != PIECE_NL_UNKNOWN ) { n->nl += nl; }
+    piecenode_update(n);
+
+    return 1;
+
+}
+
+// fill in unknown newline counts, asking `count` for original pieces when
+// one is given and scanning the bytes otherwise
+static void piecenode_count(piecetable* pt, piecenode* n, piecetable_count_original count, void* ctx) {
+
+    if ( n == NULL || n->sub_unknown == 0 ) { return; }
+
+    piecenode_count(pt, n->left, count, ctx);
+    piecenode_count(pt, n->right, count, ctx);
+
+    if ( n->nl == PIECE_NL_UNKNOWN ) {
+        if ( count != NULL && n->p.src == PIECE_ORIGINAL ) {
+            n->nl = count(ctx, n->p.start, n->p.len);
+        } else {
+            n->nl = linescan_count(piece_data(pt, &n->p), n->p.len, '\n');
+        }
+    }
+
+    piecenode_update(n);
+
+}
+
+static int piecenode_walk(piecetable* pt, piecenode* n, size_t base, size_t offset, piecetable_visit visit, void* ctx) {
+
+    while ( n != NULL ) {
+
+        size_t start = base + node_len(n->left);
+        size_t end = start + n->p.len;
+
+        if ( offset < start ) {
+            if ( piecenode_walk(pt, n->left, base, offset, visit, ctx) ) { return 1; }
+        }
+
+        if ( offset < end ) {
+            size_t inner = (offset > start) ? offset - start : 0;
+            if ( visit(ctx, piece_data(pt, &n->p) + inner, n->p.len - inner, start + inner) ) { return 1; }
+        }
+
+        base = end;
+        n = n->right;
+
+    }
+
+    return 0;
+
+}
+
+static int piecenode_walk_back(piecetable* pt, piecenode* n, size_t base, size_t offset, piecetable_visit visit, void* ctx) {
+
+    while ( n != NULL ) {
+
+        size_t start = base + node_len(n->left);
+        size_t end = start + n->p.len;
+
+        if ( offset > end ) {
+            if ( piecenode_walk_back(pt, n->right, end, offset, visit, ctx) ) { return 1; }
+        }
+
+        if ( offset > start ) {
+            size_t avail = ((offset < end) ? offset : end) - start;
+            if ( visit(ctx, piece_data(pt, &n->p), avail, start) ) { return 1; }
+        }
+
+        n = n->left;
+
+    }
+
+    return 0;
+
+}
+
+textErr piecetable_init(piecetable** inst, const char* original, size_t len) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+    if ( original == NULL && len != 0 ) { return ERR_NULL; }
+
+    ref = (piecetable*)calloc(1, sizeof(piecetable));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    ref->original = original;
+    ref->original_len = len;
+    ref->seed = 2463534242u;
+
+    // chunking the original doesn't touch its bytes; newline counts are
+    // filled in the first time something asks for line positions
+    for ( size_t start = 0; start < len; start += PIECE_CHUNK_SIZE ) {
+        size_t chunk = (len - start < PIECE_CHUNK_SIZE) ? len - start : PIECE_CHUNK_SIZE;
+
+        piecenode* n = piecenode_new(ref, PIECE_ORIGINAL, start, chunk, PIECE_NL_UNKNOWN);
+        if ( n == NULL ) {
+            piecetable_destroy(inst);
+            return ERR_MEM;
+        }
+
+        ref->root = piecenode_merge(ref->root, n);
+    }
+
+    ref->len = len;
+
+    return ERR_NONE;
+
+}
+
+// like piecetable_init, but the original is read through `fetch` a piece at
+// a time instead of being held in memory
+textErr piecetable_init_fetch(piecetable** inst, size_t len, piecetable_fetch fetch, void* ctx) {
+    #define ref (*inst)
+
+    if ( inst == NULL || fetch == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    // chunking never reads the original, so an empty placeholder will do
+    // until the hook is in place
+    textErr ret = piecetable_init(inst, "", len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ref->original = NULL;
+    ref->fetch = fetch;
+    ref->fetch_ctx = ctx;
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_destroy(piecetable** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    piecenode_free(ref, ref->root);
+    free(ref->add);
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
+
+static textErr piecetable_append_add(piecetable** inst, const char* src, size_t len) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    if ( ref->add_len + len > ref->add_cap ) {
+
+        size_t newcap = ref->add_cap ? ref->add_cap*2 : 4096;
+        while ( newcap < ref->add_len + len ) { newcap *= 2; }
+
+        char* grown = (char*)realloc(ref->add, newcap);
+        if ( grown == NULL ) { return ERR_MEM; }
+
+        ref->add = grown;
+        ref->add_cap = newcap;
+
+    }
+
+    memcpy(&ref->add[ref->add_len], src, len);
+    ref->add_len += len;
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_insert(piecetable** inst, size_t offset, const char* src, size_t len) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( src == NULL && len != 0 ) { return ERR_NULL; }
+    if ( offset > ref->len ) { return ERR_EOF; }
+    if ( len == 0 ) { return ERR_NONE; }
+
+    piecenode* spare = piecenode_new(ref, PIECE_ADD, 0, 0, 0);
+    piecenode* node = piecenode_new(ref, PIECE_ADD, 0, 0, 0);
+    if ( spare == NULL || node == NULL ) {
+        piecenode_free(ref, spare);
+        piecenode_free(ref, node);
+        return ERR_MEM;
+    }
+
+    size_t addstart = ref->add_len;
+    textErr ret = piecetable_append_add(inst, src, len);
+    if ( ret != ERR_NONE ) {
+        piecenode_free(ref, spare);
+        piecenode_free(ref, node);
+        return ret;
+    }
+
+    size_t nl = linescan_count(src, len, '\n');
+
+    piecenode* l = NULL;
+    piecenode* r = NULL;
+    piecenode_split(ref, ref->root, offset, &l, &r, &spare);
+
+    // typing extends the piece that was created by the previous insert
+    // instead of adding a new piece per keystroke
+    if ( piecenode_extend_last(l, addstart, len, nl) ) {
+        piecenode_free(ref, node);
+    } else {
+        node->p.start = addstart;
+        node->p.len = len;
+        node->nl = nl;
+        piecenode_update(node);
+        l = piecenode_merge(l, node);
+    }
+
+    ref->root = piecenode_merge(l, r);
+    ref->len += len;
+
+    piecenode_free(ref, spare);
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_delete(piecetable** inst, size_t offset, size_t len) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( offset + len > ref->len ) { return ERR_EOF; }
+    if ( len == 0 ) { return ERR_NONE; }
+
+    piecenode* spare_a = piecenode_new(ref, PIECE_ADD, 0, 0, 0);
+    piecenode* spare_b = piecenode_new(ref, PIECE_ADD, 0, 0, 0);
+    if ( spare_a == NULL || spare_b == NULL ) {
+        piecenode_free(ref, spare_a);
+        piecenode_free(ref, spare_b);
+        return ERR_MEM;
+    }
+
+    piecenode* l = NULL;
+    piecenode* m = NULL;
+    piecenode* r = NULL;
+    piecenode_split(ref, ref->root, offset, &l, &m, &spare_a);
+    piecenode_split(ref, m, len, &m, &r, &spare_b);
+
+    piecenode_free(ref, m);
+    ref->root = piecenode_merge(l, r);
+    ref->len -= len;
+
+    piecenode_free(ref, spare_a);
+    piecenode_free(ref, spare_b);
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_replace(piecetable** inst, size_t offset, size_t dellen, const char* src, size_t len) {
+    #define ref (*inst)
+
+    textErr ret = piecetable_delete(inst, offset, dellen);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    return piecetable_insert(inst, offset, src, len);
+
+}
+
+textErr piecetable_walk(piecetable** inst, size_t offset, piecetable_visit visit, void* ctx) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || visit == NULL ) { return ERR_NULL; }
+    if ( offset > ref->len ) { return ERR_EOF; }
+
+    piecenode_walk(ref, ref->root, 0, offset, visit, ctx);
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_walk_back(piecetable** inst, size_t offset, piecetable_visit visit, void* ctx) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || visit == NULL ) { return ERR_NULL; }
+    if ( offset > ref->len ) { return ERR_EOF; }
+
+    piecenode_walk_back(ref, ref->root, 0, offset, visit, ctx);
+
+    return ERR_NONE;
+
+}
+
+typedef struct {
+
+    char* dst;
+    const char* src;
+    size_t remaining;
+    int equal;
+
+} piecetable_copy_ctx;
+
+static int piecetable_visit_read(void* ctx, const char* data, size_t len, size_t offset) {
+
+    (void)offset;
+    piecetable_copy_ctx* c = (piecetable_copy_ctx*)ctx;
+
+    size_t chunk = (len < c->remaining) ? len : c->remaining;
+    memcpy(c->dst, data, chunk);
+    c->dst += chunk;
+    c->remaining -= chunk;
+
+    return c->remaining == 0;
+
+}
+
+static int piecetable_visit_equal(void* ctx, const char* data, size_t len, size_t offset) {
+
+    (void)offset;
+    piecetable_copy_ctx* c = (piecetable_copy_ctx*)ctx;
+
+    size_t chunk = (len < c->remaining) ? len : c->remaining;
+    if ( memcmp(c->src, data, chunk) != 0 ) {
+        c->equal = 0;
+        return 1;
+    }
+    c->src += chunk;
+    c->remaining -= chunk;
+
+    return c->remaining == 0;
+
+}
+
+static void piecenode_collect(piecenode* n, piece* out, size_t* i) {
+
+    while ( n != NULL ) {
+        piecenode_collect(n->left, out, i);
+        out[(*i)++] = n->p;
+        n = n->right;
+    }
+
+}
+
+// copy the pieces in document order into a new array owned by the caller.
+// together with the add buffer contents up to add_len this is a complete
+// snapshot of the document.
+textErr piecetable_pieces(piecetable** inst, piece** out, size_t* count) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || out == NULL || count == NULL ) { return ERR_NULL; }
+
+    piece* pieces = (piece*)malloc(sizeof(piece) * (ref->count ? ref->count : 1));
+    if ( pieces == NULL ) { return ERR_MEM; }
+
+    size_t i = 0;
+    piecenode_collect(ref->root, pieces, &i);
+
+    *out = pieces;
+    *count = i;
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_read(piecetable** inst, size_t offset, char* dst, size_t len) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || dst == NULL ) { return ERR_NULL; }
+    if ( offset + len > ref->len ) { return ERR_EOF; }
+    if ( len == 0 ) { return ERR_NONE; }
+
+    piecetable_copy_ctx c = { .dst = dst, .remaining = len };
+    return piecetable_walk(inst, offset, piecetable_visit_read, &c);
+
+}
+
+textErr piecetable_equal(piecetable** inst, size_t offset, const char* src, size_t len, int* equal) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || equal == NULL ) { return ERR_NULL; }
+    if ( src == NULL && len != 0 ) { return ERR_NULL; }
+
+    *equal = 0;
+    if ( offset + len > ref->len ) { return ERR_NONE; }
+
+    piecetable_copy_ctx c = { .src = src, .remaining = len, .equal = 1 };
+    if ( len > 0 ) {
+        textErr ret = piecetable_walk(inst, offset, piecetable_visit_equal, &c);
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    *equal = c.equal;
+
+    return ERR_NONE;
+
+}
+
+typedef struct {
+
+    char c;
+    size_t found;
+    int hit;
+
+} piecetable_find_ctx;
+
+static int piecetable_visit_find_next(void* ctx, const char* data, size_t len, size_t offset) {
+
+    piecetable_find_ctx* f = (piecetable_find_ctx*)ctx;
+
+    const char* hit = linescan_find(data, len, f->c);
+    if ( hit == NULL ) { return 0; }
+
+    f->found = offset + (size_t)(hit - data);
+    f->hit = 1;
+
+    return 1;
+
+}
+
+static int piecetable_visit_find_prev(void* ctx, const char* data, size_t len, size_t offset) {
+
+    piecetable_find_ctx* f = (piecetable_find_ctx*)ctx;
+
+    const char* hit = linescan_rfind(data, len, f->c);
+    if ( hit == NULL ) { return 0; }
+
+    f->found = offset + (size_t)(hit - data);
+    f->hit = 1;
+
+    return 1;
+
+}
+
+textErr piecetable_find_next(piecetable** inst, size_t offset, char c, size_t* found) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || found == NULL ) { return ERR_NULL; }
+    if ( offset >= ref->len ) { return ERR_EOF; }
+
+    piecetable_find_ctx f = { .c = c };
+    textErr ret = piecetable_walk(inst, offset, piecetable_visit_find_next, &f);
+    if ( ret != ERR_NONE ) { return ret; }
+    if ( !f.hit ) { return ERR_EOF; }
+
+    *found = f.found;
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_find_prev(piecetable** inst, size_t offset, char c, size_t* found) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || found == NULL ) { return ERR_NULL; }
+    if ( offset == 0 ) { return ERR_EOF; }
+    if ( offset > ref->len ) { offset = ref->len; }
+
+    piecetable_find_ctx f = { .c = c };
+    textErr ret = piecetable_walk_back(inst, offset, piecetable_visit_find_prev, &f);
+    if ( ret != ERR_NONE ) { return ret; }
+    if ( !f.hit ) { return ERR_EOF; }
+
+    *found = f.found;
+
+    return ERR_NONE;
+
+}
+
+// nonzero when every piece's newline count is known, i.e. line queries
+// won't have to scan anything
+int piecetable_lines_known(piecetable** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return 0; }
+
+    return node_unknown(ref->root) == 0;
+
+}
+
+textErr piecetable_fill_counts(piecetable** inst, piecetable_count_original count, void* ctx) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || count == NULL ) { return ERR_NULL; }
+
+    piecenode_count(ref, ref->root, count, ctx);
+
+    return ERR_NONE;
+
+}
+
+textErr piecetable_count_lines(piecetable** inst, size_t* newlines) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || newlines == NULL ) { return ERR_NULL; }
+
+    piecenode_count(ref, ref->root, NULL, NULL);
+    *newlines = node_nl(ref->root);
+
+    return ERR_NONE;
+
+}
+
+// offset of the first byte of `line` (0-based)
+textErr piecetable_line_start(piecetable** inst, size_t line, size_t* offset) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || offset == NULL ) { return ERR_NULL; }
+
+    if ( line == 0 ) {
+        *offset = 0;
+        return ERR_NONE;
+    }
+
+    piecenode_count(ref, ref->root, NULL, NULL);
+    if ( line > node_nl(ref->root) ) { return ERR_EOF; }
+
+    // find the line'th newline; the line starts right after it
+    size_t k = line;
+    size_t base = 0;
+    piecenode* n = ref->root;
+    while ( n != NULL ) {
+
+        if ( k <= node_nl(n->left) ) {
+            n = n->left;
+            continue;
+        }
+
+        k -= node_nl(n->left);
+        base += node_len(n->left);
+
+        if ( k <= n->nl ) {
+            const char* data = piece_data(ref, &n->p);
+            const char* cur = data;
+            while ( true ) {
+                cur = linescan_find(cur, n->p.len - (size_t)(cur - data), '\n');
+                if ( --k == 0 ) { break; }
+                cur += 1;
+            }
+            *offset = base + (size_t)(cur - data) + 1;
+            return ERR_NONE;
+        }
+
+        k -= n->nl;
+        base += n->p.len;
+        n = n->right;
+
+    }
+
+    return ERR_EOF;
+
+}
+
+// number of newlines before `offset`, i.e. the 0-based line holding it
+textErr piecetable_line_of(piecetable** inst, size_t offset, size_t* line) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || line == NULL ) { return ERR_NULL; }
+    if ( offset > ref->len ) { return ERR_EOF; }
+
+    piecenode_count(ref, ref->root, NULL, NULL);
+
+    size_t lines = 0;
+    size_t o = offset;
+    piecenode* n = ref->root;
+    while ( n != NULL ) {
+
+        if ( o < node_len(n->left) ) {
+            n = n->left;
+            continue;
+        }
+
+        lines += node_nl(n->left);
+        o -= node_len(n->left);
+
+        if ( o <= n->p.len ) {
+            lines += linescan_count(piece_data(ref, &n->p), o, '\n');
+            break;
+        }
+
+        lines += n->nl;
+        o -= n->p.len;
+        n = n->right;
+
+    }
+
+    *line = lines;
+
+    return ERR_NONE;
+
+}
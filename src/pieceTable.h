@@ -0,0 +1,123 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "textErr.h"
+
+typedef enum {
+
+    PIECE_ORIGINAL = 0,
+    PIECE_ADD = 1,
+
+} piece_src;
+
+// a piece is a run of bytes taken from one of the two buffers
+typedef struct {
+
+    piece_src src;
+    size_t start;
+    size_t len;
+
+} piece;
+
+// newline count of a piece that hasn't been scanned yet
+#define PIECE_NL_UNKNOWN SIZE_MAX
+
+// the original buffer is cut into pieces of this size at load so newline
+// counts can be filled in (and re-derived after a split) a chunk at a time
+#define PIECE_CHUNK_SIZE ((size_t)64 * 1024)
+
+// supplies `len` bytes of the original starting at `start` when the original
+// isn't held in memory. a request never crosses a PIECE_CHUNK_SIZE boundary
+// (original pieces are cut at load and only ever shrink), and the bytes only
+// have to stay valid until the next call.
+typedef const char* (*piecetable_fetch)(void* ctx, size_t start, size_t len);
+
+// pieces are kept in a treap ordered by document position. every node caches
+// the byte and newline totals of its subtree, so locating a byte offset or a
+// line number is a single O(log n) descent.
+typedef struct piecenode {
+
+    struct piecenode* left;
+    struct piecenode* right;
+
+    piece p;
+    size_t nl;
+
+    size_t sub_len;
+    size_t sub_nl;
+    size_t sub_unknown;
+
+    uint32_t priority;
+
+} piecenode;
+
+// piecetable stores a document as a sequence of pieces over an immutable
+// original buffer (usually the file mapping) and an append-only add buffer.
+// nothing in either buffer is ever overwritten; edits only split and splice
+// pieces, so their cost is independent of the document size.
+typedef struct {
+
+    const char* original;
+    size_t original_len;
+
+    // set instead of `original` for documents that are streamed from disk
+    piecetable_fetch fetch;
+    void* fetch_ctx;
+
+    char* add;
+    size_t add_len;
+    size_t add_cap;
+
+    piecenode* root;
+    size_t count;
+
+    size_t len;
+
+    uint32_t seed;
+
+} piecetable;
+
+// visitor for piecetable_walk/piecetable_walk_back. `offset` is the document
+// position of data[0]. return nonzero to stop the walk.
+typedef int (*piecetable_visit)(void* ctx, const char* data, size_t len, size_t offset);
+
+// supplies the newline count of a range of the original buffer, e.g. from a
+// precomputed index, so piecetable_fill_counts doesn't have to scan it
+typedef size_t (*piecetable_count_original)(void* ctx, size_t start, size_t len);
+
+static inline const char* piece_data(const piecetable* pt, const piece* p) {
+    if ( p->src == PIECE_ADD ) { return pt->add + p->start; }
+    if ( pt->fetch != NULL ) { return pt->fetch(pt->fetch_ctx, p->start, p->len); }
+    return pt->original + p->start;
+}
+
+textErr piecetable_init(piecetable** inst, const char* original, size_t len);
+textErr piecetable_init_fetch(piecetable** inst, size_t len, piecetable_fetch fetch, void* ctx);
+textErr piecetable_destroy(piecetable** inst);
+
+textErr piecetable_insert(piecetable** inst, size_t offset, const char* src, size_t len);
+textErr piecetable_delete(piecetable** inst, size_t offset, size_t len);
+textErr piecetable_replace(piecetable** inst, size_t offset, size_t dellen, const char* src, size_t len);
+
+textErr piecetable_walk(piecetable** inst, size_t offset, piecetable_visit visit, void* ctx);
+textErr piecetable_walk_back(piecetable** inst, size_t offset, piecetable_visit visit, void* ctx);
+
+textErr piecetable_read(piecetable** inst, size_t offset, char* dst, size_t len);
+textErr piecetable_pieces(piecetable** inst, piece** out, size_t* count);
+textErr piecetable_equal(piecetable** inst, size_t offset, const char* src, size_t len, int* equal);
+
+textErr piecetable_find_next(piecetable** inst, size_t offset, char c, size_t* found);
+textErr piecetable_find_prev(piecetable** inst, size_t offset, char c, size_t* found);
+
+int piecetable_lines_known(piecetable** inst);
+textErr piecetable_fill_counts(piecetable** inst, piecetable_count_original count, void* ctx);
+
+textErr piecetable_count_lines(piecetable** inst, size_t* newlines);
+textErr piecetable_line_start(piecetable** inst, size_t line, size_t* offset);
+textErr piecetable_line_of(piecetable** inst, size_t offset, size_t* line);
+
+#endif /* PIECETABLE_H */
@@ -0,0 +1,417 @@
+#include "regexSearch.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "lineScan.h"
+#include "textTrace.h"
+
+// bytes read at a time while looking for line starts
+#define REGEXSEARCH_SCAN ((size_t)4096)
+
+// copy `len` bytes of the snapshot at `offset` into `dst`
+static textErr regexsearch_read(regexsearch* rs, size_t offset, char* dst, size_t len) {
+
+    // last piece starting at or before `offset`
+    size_t lo = 0;
+    size_t hi = rs->count;
+    while ( hi - lo > 1 ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( rs->starts[mid] <= offset ) { lo = mid; } else { hi = mid; }
+    }
+
+    for ( size_t i = lo; i < rs->count && len > 0; i++ ) {
+
+        const piece* p = &rs->pieces[i];
+        if ( offset >= rs->starts[i] + p->len ) { continue; }
+
+        size_t inner = offset - rs->starts[i];
+        size_t take = (p->len - inner < len) ? p->len - inner : len;
+
+        if ( p->src == PIECE_ORIGINAL && rs->original == NULL ) {
+            size_t got = 0;
+            while ( got < take ) {
+                ssize_t n = pread(rs->original_fd, &dst[got], take - got, (off_t)(p->start + inner + got));
+                if ( n < 0 && errno == EINTR ) { continue; }
+                if ( n <= 0 ) { return ERR_IO; }
+                got += (size_t)n;
+            }
+        } else {
+            const char* base = (p->src == PIECE_ORIGINAL) ? rs->original : rs->add;
+            memcpy(dst, base + p->start + inner, take);
+        }
+
+        dst += take;
+        offset += take;
+        len -= take;
+
+    }
+
+    return (len == 0) ? ERR_NONE : ERR_EOF;
+
+}
+
+// first line start in [`at`, `limit`), or `limit` if a line runs through
+// all of it. only bytes before `limit` are read, so finding where a chunk's
+// lines start costs at most a chunk however long its lines are.
+static textErr regexsearch_line_start(regexsearch* rs, size_t at, size_t limit, size_t* out) {
+
+    if ( at == 0 || at >= limit ) {
+        *out = (at == 0) ? 0 : limit;
+        return ERR_NONE;
+    }
+
+    char block[REGEXSEARCH_SCAN];
+
+    // the byte before `at` may be the line break that starts a line there
+    size_t pos = at - 1;
+    while ( pos + 1 < limit ) {
+        size_t take = (limit - 1 - pos < sizeof(block)) ? limit - 1 - pos : sizeof(block);
+        textErr ret = regexsearch_read(rs, pos, block, take);
+        if ( ret != ERR_NONE ) { return ret; }
+        const char* nl = linescan_find(block, take, '\n');
+        if ( nl != NULL ) {
+            *out = pos + (size_t)(nl - block) + 1;
+            return ERR_NONE;
+        }
+        pos += take;
+    }
+
+    *out = limit;
+
+    return ERR_NONE;
+
+}
+
+static textErr regexsearch_push(regexsearch_chunk* c, size_t* cap, size_t offset, size_t len) {
+
+    if ( c->count == *cap ) {
+        size_t newcap = *cap ? *cap*2 : 64;
+        regexsearch_match* grown = (regexsearch_match*)realloc(c->matches, sizeof(regexsearch_match) * newcap);
+        if ( grown == NULL ) { return ERR_MEM; }
+        c->matches = grown;
+        *cap = newcap;
+    }
+
+    c->matches[c->count].offset = offset;
+    c->matches[c->count].len = len;
+    c->count += 1;
+
+    return ERR_NONE;
+
+}
+
+// match every line of chunk `k`, collecting the matches in the chunk
+static textErr regexsearch_scan(regexsearch_worker* w, size_t k, char** buf, size_t* bufcap) {
+
+    regexsearch* rs = w->owner;
+    regexsearch_chunk* c = &rs->chunks[k];
+
+    // a chunk no line starts in is the middle of a long line, which the
+    // chunk holding its first byte scans to the end in one go
+    size_t start = 0;
+    size_t end = 0;
+    size_t limit = ((k + 1) * REGEXSEARCH_CHUNK < rs->len) ? (k + 1) * REGEXSEARCH_CHUNK : rs->len;
+    textErr ret = regexsearch_line_start(rs, k * REGEXSEARCH_CHUNK, limit, &start);
+    if ( ret != ERR_NONE ) { return ret; }
+    if ( start >= limit ) { return ERR_NONE; }
+    ret = regexsearch_line_start(rs, limit, rs->len, &end);
+    if ( ret != ERR_NONE ) { return ret; }
+    c->start = start;
+    c->end = end;
+
+    size_t n = end - start;
+    if ( n + 1 > *bufcap ) {
+        char* grown = (char*)realloc(*buf, n + 1);
+        if ( grown == NULL ) { return ERR_MEM; }
+        *buf = grown;
+        *bufcap = n + 1;
+    }
+
+    ret = regexsearch_read(rs, start, *buf, n);
+    if ( ret != ERR_NONE ) { return ret; }
+    (*buf)[n] = '\0';
+
+    const char* text = *buf;
+    size_t cap = 0;
+    size_t pos = 0;
+
+    // REG_STARTEND bounds each call, so regexec neither measures the whole
+    // chunk again for every match nor stops at a NUL byte
+    while ( pos < n ) {
+
+        regmatch_t m;
+        m.rm_so = (regoff_t)pos;
+        m.rm_eo = (regoff_t)n;
+
+        // the chunk ends on a line break, and what follows it is the next
+        // chunk's first line (or nothing at the end of the document), so
+        // neither `$` nor an empty match may land there
+        int eflags = REG_STARTEND;
+        if ( pos > 0 && text[pos-1] != '\n' ) { eflags |= REG_NOTBOL; }
+        if ( text[n-1] == '\n' ) { eflags |= REG_NOTEOL; }
+
+        if ( regexec(&w->regex, text, 1, &m, eflags) != 0 ) { break; }
+
+        size_t so = (size_t)m.rm_so;
+        size_t eo = (size_t)m.rm_eo;
+        if ( so >= n ) { break; }
+        ret = regexsearch_push(c, &cap, start + so, eo - so);
+        if ( ret != ERR_NONE ) { return ret; }
+
+        // an empty match still has to move on
+        pos = (eo > so) ? eo : so + 1;
+
+        if ( atomic_load_explicit(&rs->cancel, memory_order_relaxed) ) { break; }
+
+    }
+
+    return ERR_NONE;
+
+}
+
+static void* regexsearch_worker_main(void* arg) {
+
+    TRACE_SCOPE(__func__);
+    regexsearch_worker* w = (regexsearch_worker*)arg;
+    regexsearch* rs = w->owner;
+
+    char* buf = NULL;
+    size_t bufcap = 0;
+
+    while ( !atomic_load_explicit(&rs->cancel, memory_order_relaxed) ) {
+
+        size_t n = atomic_fetch_add_explicit(&rs->next_chunk, 1, memory_order_relaxed);
+        if ( n >= rs->chunk_count ) { break; }
+
+        size_t k = (rs->first_chunk + n) % rs->chunk_count;
+        regexsearch_chunk* c = &rs->chunks[k];
+
+        if ( regexsearch_scan(w, k, &buf, &bufcap) != ERR_NONE ) {
+            atomic_store_explicit(&rs->failed, 1, memory_order_relaxed);
+        }
+
+        atomic_fetch_add_explicit(&rs->total, c->count, memory_order_relaxed);
+        atomic_store_explicit(&c->done, 1, memory_order_release);
+        atomic_fetch_add_explicit(&rs->chunks_done, 1, memory_order_release);
+
+    }
+
+    free(buf);
+
+    return NULL;
+
+}
+
+static void regexsearch_free(regexsearch* rs) {
+
+    for ( size_t i = 0; i < rs->threads; i++ ) { regfree(&rs->workers[i].regex); }
+
+    if ( rs->chunks != NULL ) {
+        for ( size_t i = 0; i < rs->chunk_count; i++ ) { free(rs->chunks[i].matches); }
+    }
+
+    free(rs->chunks);
+    free(rs->pieces);
+    free(rs->starts);
+    free(rs->add);
+    free(rs);
+
+}
+
+// snapshot `text` and start matching the extended regular expression
+// `pattern` against it. chunks are scanned starting at document `from`.
+// `map` backs the original pieces and must outlive the search.
+textErr regexsearch_start(regexsearch** inst, piecetable** text, filemap* map, const char* pattern, size_t from) {
+    #define ref (*inst)
+
+    if ( inst == NULL || text == NULL || *text == NULL || map == NULL || pattern == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    regexsearch* rs = (regexsearch*)calloc(1, sizeof(regexsearch));
+    if ( rs == NULL ) { return ERR_MEM; }
+
+    piecetable* pt = *text;
+
+    rs->len = pt->len;
+    rs->original = map->streamed ? NULL : map->data;
+    rs->original_fd = map->streamed ? map->fd : -1;
+    atomic_init(&rs->next_chunk, 0);
+    atomic_init(&rs->chunks_done, 0);
+    atomic_init(&rs->total, 0);
+    atomic_init(&rs->cancel, 0);
+    atomic_init(&rs->failed, 0);
+
+    textErr ret = piecetable_pieces(text, &rs->pieces, &rs->count);
+
+    if ( ret == ERR_NONE && pt->add_len > 0 ) {
+        rs->add = (char*)malloc(pt->add_len);
+        if ( rs->add == NULL ) {
+            ret = ERR_MEM;
+        } else {
+            memcpy(rs->add, pt->add, pt->add_len);
+        }
+    }
+
+    // document offset of every piece, for finding the one holding a byte
+    if ( ret == ERR_NONE ) {
+        rs->starts = (size_t*)malloc(sizeof(size_t) * (rs->count + 1));
+        if ( rs->starts == NULL ) {
+            ret = ERR_MEM;
+        } else {
+            size_t at = 0;
+            for ( size_t i = 0; i < rs->count; i++ ) {
+                rs->starts[i] = at;
+                at += rs->pieces[i].len;
+            }
+            rs->starts[rs->count] = at;
+        }
+    }
+
+    if ( ret == ERR_NONE ) {
+        rs->chunk_count = (rs->len + REGEXSEARCH_CHUNK - 1) / REGEXSEARCH_CHUNK;
+        rs->chunks = (regexsearch_chunk*)calloc(rs->chunk_count ? rs->chunk_count : 1, sizeof(regexsearch_chunk));
+        if ( rs->chunks == NULL ) { ret = ERR_MEM; }
+    }
+
+    if ( ret == ERR_NONE && rs->chunk_count > 0 ) {
+        rs->first_chunk = ((from < rs->len) ? from : rs->len - 1) / REGEXSEARCH_CHUNK;
+    }
+
+    if ( ret != ERR_NONE ) {
+        regexsearch_free(rs);
+        return ret;
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = (cores > 0) ? (size_t)cores : 1;
+    if ( threads > REGEXSEARCH_THREADS_MAX ) { threads = REGEXSEARCH_THREADS_MAX; }
+    if ( threads > rs->chunk_count ) { threads = rs->chunk_count; }
+
+    // compile once up front so a bad pattern is reported even for an
+    // empty document
+    regex_t probe;
+    if ( regcomp(&probe, pattern, REG_EXTENDED | REG_NEWLINE) != 0 ) {
+        regexsearch_free(rs);
+        return ERR_PATTERN;
+    }
+    regfree(&probe);
+
+    for ( size_t i = 0; i < threads; i++ ) {
+        if ( regcomp(&rs->workers[i].regex, pattern, REG_EXTENDED | REG_NEWLINE) != 0 ) { break; }
+        rs->workers[i].owner = rs;
+        rs->threads = i + 1;
+    }
+
+    size_t started = 0;
+    for ( size_t i = 0; i < rs->threads; i++ ) {
+        if ( pthread_create(&rs->workers[i].thread, NULL, regexsearch_worker_main, &rs->workers[i]) != 0 ) { break; }
+        started += 1;
+    }
+
+    // fewer workers than wanted just means a slower search, but without
+    // any the chunks would never be scanned
+    if ( started == 0 && rs->chunk_count > 0 ) {
+        regexsearch_free(rs);
+        return ERR_MEM;
+    }
+    for ( size_t i = started; i < rs->threads; i++ ) { regfree(&rs->workers[i].regex); }
+    rs->threads = started;
+
+    ref = rs;
+
+    return ERR_NONE;
+
+}
+
+// first match in chunk `c` starting at or after `offset`
+static size_t regexsearch_bound(const regexsearch_chunk* c, size_t offset) {
+
+    size_t lo = 0;
+    size_t hi = c->count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( c->matches[mid].offset < offset ) { lo = mid + 1; } else { hi = mid; }
+    }
+
+    return lo;
+
+}
+
+// first match starting at or after `offset`, or with `backward` the last
+// one starting before it, wrapping around the document ends. ERR_BUSY if
+// the answer depends on a chunk that isn't scanned yet, ERR_EOF if there
+// are no matches at all.
+textErr regexsearch_next(regexsearch** inst, size_t offset, bool backward, regexsearch_match* out) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || out == NULL ) { return ERR_NULL; }
+
+    regexsearch* rs = ref;
+    if ( rs->chunk_count == 0 ) { return ERR_EOF; }
+
+    // matches never span lines, so the chunk the line at `offset` starts
+    // in is the first one that can hold a match past it. chunks a long
+    // line runs through hold nothing, so step back over them.
+    size_t k = ((offset < rs->len) ? offset : rs->len - 1) / REGEXSEARCH_CHUNK;
+    for ( ;; ) {
+        const regexsearch_chunk* c = &rs->chunks[k];
+        if ( !atomic_load_explicit(&c->done, memory_order_acquire) ) { return ERR_BUSY; }
+        if ( k == 0 || (c->start < c->end && c->start <= offset) ) { break; }
+        k -= 1;
+    }
+
+    for ( size_t step = 0; step <= rs->chunk_count; step++ ) {
+
+        size_t i = backward ? (k + rs->chunk_count - step) % rs->chunk_count : (k + step) % rs->chunk_count;
+        regexsearch_chunk* c = &rs->chunks[i];
+        if ( !atomic_load_explicit(&c->done, memory_order_acquire) ) { return ERR_BUSY; }
+
+        // only the first chunk visited is cut at `offset`; once the search
+        // has wrapped any match will do
+        size_t j = (step == 0) ? regexsearch_bound(c, offset) : (backward ? c->count : 0);
+
+        if ( !backward && j < c->count ) {
+            *out = c->matches[j];
+            return ERR_NONE;
+        }
+        if ( backward && j > 0 ) {
+            *out = c->matches[j-1];
+            return ERR_NONE;
+        }
+
+    }
+
+    return ERR_EOF;
+
+}
+
+// chunks scanned out of `chunks`, and the matches found in them
+textErr regexsearch_progress(regexsearch** inst, size_t* done, size_t* chunks, size_t* matches) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || done == NULL || chunks == NULL || matches == NULL ) { return ERR_NULL; }
+
+    *done = atomic_load_explicit(&ref->chunks_done, memory_order_acquire);
+    *chunks = ref->chunk_count;
+    *matches = atomic_load_explicit(&ref->total, memory_order_relaxed);
+
+    return atomic_load_explicit(&ref->failed, memory_order_relaxed) ? ERR_IO : ERR_NONE;
+
+}
+
+// stop the workers and free the search
+textErr regexsearch_finish(regexsearch** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    atomic_store_explicit(&ref->cancel, 1, memory_order_relaxed);
+    for ( size_t i = 0; i < ref->threads; i++ ) { pthread_join(ref->workers[i].thread, NULL); }
+
+    regexsearch_free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
@@ -0,0 +1,87 @@
+#ifndef REGEXSEARCH_H
+#define REGEXSEARCH_H
+
+#include <pthread.h>
+#include <regex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "textErr.h"
+#include "fileMap.h"
+#include "pieceTable.h"
+
+// bytes of document each worker takes at a time, before line alignment
+#define REGEXSEARCH_CHUNK ((size_t)1 << 20)
+#define REGEXSEARCH_THREADS_MAX 16
+
+typedef struct {
+
+    size_t offset;
+    size_t len;
+
+} regexsearch_match;
+
+// matches of one chunk and the lines it scanned, [start, end), published
+// once `done` is set. a chunk a long line runs through without a line
+// starting in it scans nothing and leaves start and end at 0.
+typedef struct {
+
+    regexsearch_match* matches;
+    size_t count;
+    size_t start;
+    size_t end;
+    atomic_int done;
+
+} regexsearch_chunk;
+
+struct regexsearch;
+
+// glibc serializes regexec calls on one compiled pattern, so every worker
+// compiles its own
+typedef struct {
+
+    struct regexsearch* owner;
+    regex_t regex;
+    pthread_t thread;
+
+} regexsearch_worker;
+
+// regexsearch greps a snapshot of a piece table on a pool of worker threads.
+// the document is cut into REGEXSEARCH_CHUNK sized chunks, each widened to
+// whole lines: a line belongs to the chunk its first byte is in. chunks are
+// handed out starting from the one at `from` and wrapping around, so the
+// matches near the cursor come in first.
+// the snapshot is taken like filesave's, so the editor may keep changing
+// the piece table; match offsets refer to the document as it was.
+typedef struct regexsearch {
+
+    piece* pieces;
+    size_t* starts;
+    size_t count;
+
+    const char* original;
+    int original_fd;
+    char* add;
+    size_t len;
+
+    regexsearch_worker workers[REGEXSEARCH_THREADS_MAX];
+    size_t threads;
+
+    regexsearch_chunk* chunks;
+    size_t chunk_count;
+    size_t first_chunk;
+
+    atomic_size_t next_chunk;
+    atomic_size_t chunks_done;
+    atomic_size_t total;
+    atomic_int cancel;
+    atomic_int failed;
+
+} regexsearch;
+
+textErr regexsearch_start(regexsearch** inst, piecetable** text, filemap* map, const char* pattern, size_t from);
+textErr regexsearch_next(regexsearch** inst, size_t offset, bool backward, regexsearch_match* out);
+textErr regexsearch_progress(regexsearch** inst, size_t* done, size_t* chunks, size_t* matches);
+textErr regexsearch_finish(regexsearch** inst);
+
+#endif /* REGEXSEARCH_H */
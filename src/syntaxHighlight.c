@@ -0,0 +1,442 @@
+#include "syntaxHighlight.h"
+
+#include <ctype.h>
+#include <string.h>
+#include "lineScan.h"
+
+static void syntax_mark(const syntax_span* out, size_t from, size_t to, syntax_class cls) {
+    if ( out == NULL ) { return; }
+    if ( from < out->from ) { from = out->from; }
+    if ( to > out->to ) { to = out->to; }
+    if ( to > from ) { memset(&out->classes[from - out->from], (int)cls, to - from); }
+}
+
+// where a lexer can stop skipping and start coloring tokens in time for
+// `out`: just past the last blank before it. a blank is a token on its own,
+// so no word or number runs across that point; comments and strings do, but
+// skipping keeps track of those anyway.
+static size_t syntax_quiet_until(const char* s, const syntax_span* out) {
+    if ( out == NULL ) { return SIZE_MAX; }
+    size_t i = out->from;
+    while ( i > 0 && s[i-1] != ' ' && s[i-1] != '\t' ) { i -= 1; }
+    return i;
+}
+
+// whether the byte at `i` only matters for the state the line ends in
+static bool syntax_quiet(const syntax_span* out, size_t quiet, size_t i) {
+    return out == NULL || i < quiet || i >= out->to;
+}
+
+// length of the line without its line break
+static size_t syntax_text_len(const char* s, size_t len) {
+    if ( len > 0 && s[len-1] == '\n' ) { len -= 1; }
+    if ( len > 0 && s[len-1] == '\r' ) { len -= 1; }
+    return len;
+}
+
+static bool syntax_ident(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// `words` is sorted the way strcmp sorts
+static bool syntax_lookup(const char* const* words, size_t count, const char* s, size_t len) {
+
+    size_t lo = 0;
+    size_t hi = count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strncmp(words[mid], s, len);
+        if ( cmp == 0 ) { cmp = words[mid][len] == '\0' ? 0 : 1; }
+        if ( cmp == 0 ) { return true; }
+        if ( cmp < 0 ) { lo = mid + 1; } else { hi = mid; }
+    }
+
+    return false;
+
+}
+
+// index just past the quote closing a string that starts at `i`, or `end`
+// if the line runs out first
+static size_t syntax_quoted(const char* s, size_t i, size_t end, char quote, bool* closed) {
+
+    *closed = false;
+    while ( i < end ) {
+        if ( s[i] == '\\' ) { i += 2; continue; }
+        if ( s[i] == quote ) {
+            *closed = true;
+            return i + 1;
+        }
+        i += 1;
+    }
+
+    return end;
+
+}
+
+// end of a number starting at `i`; loose on purpose, 0x1fULL and 1.5e-3f
+// are all one token
+static size_t syntax_number(const char* s, size_t i, size_t end) {
+
+    while ( i < end ) {
+        char c = s[i];
+        if ( (c == '+' || c == '-') && strchr("eEpP", s[i-1]) != NULL ) { i += 1; continue; }
+        if ( !syntax_ident(c) && c != '.' ) { break; }
+        i += 1;
+    }
+
+    return i;
+
+}
+
+/* C and C++ */
+
+enum {
+    SYNTAX_C_NORMAL = 0,
+    SYNTAX_C_COMMENT,
+    SYNTAX_C_STRING,
+    SYNTAX_C_PREPROC,
+    SYNTAX_C_LINE_COMMENT
+};
+
+static const char* const syntax_c_keywords[] = {
+    "alignas", "alignof", "auto", "break", "case", "catch", "class", "const",
+    "constexpr", "continue", "default", "delete", "do", "else", "enum",
+    "explicit", "extern", "false", "for", "friend", "goto", "if", "inline",
+    "namespace", "new", "noexcept", "nullptr", "operator", "private",
+    "protected", "public", "register", "restrict", "return", "sizeof",
+    "static", "static_assert", "struct", "switch", "template", "this",
+    "throw", "true", "try", "typedef", "typename", "union", "using",
+    "virtual", "volatile", "while"
+};
+
+static const char* const syntax_c_types[] = {
+    "FILE", "_Atomic", "_Bool", "_Static_assert", "atomic_int", "atomic_size_t",
+    "bool", "char", "double", "float", "int", "int16_t", "int32_t", "int64_t",
+    "int8_t", "intptr_t", "long", "off_t", "ptrdiff_t", "short", "signed",
+    "size_t", "ssize_t", "uint16_t", "uint32_t", "uint64_t", "uint8_t",
+    "uintptr_t", "unsigned", "void", "wchar_t"
+};
+
+#define SYNTAX_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static uint32_t syntax_lex_c(uint32_t state, const char* s, size_t len, const syntax_span* out) {
+
+    size_t end = syntax_text_len(s, len);
+    bool continued = end > 0 && s[end-1] == '\\';
+    syntax_mark(out, end, len, SYNTAX_PLAIN);
+
+    size_t i = 0;
+    size_t quiet = syntax_quiet_until(s, out);
+    bool preproc = state == SYNTAX_C_PREPROC;
+    bool closed = false;
+
+    if ( state == SYNTAX_C_LINE_COMMENT ) {
+        syntax_mark(out, 0, end, SYNTAX_COMMENT);
+        return continued ? SYNTAX_C_LINE_COMMENT : SYNTAX_C_NORMAL;
+    }
+
+    if ( state == SYNTAX_C_COMMENT ) {
+        const char* close = linescan_find_str(s, end, "*/", 2);
+        if ( close == NULL ) {
+            syntax_mark(out, 0, end, SYNTAX_COMMENT);
+            return SYNTAX_C_COMMENT;
+        }
+        i = (size_t)(close - s) + 2;
+        syntax_mark(out, 0, i, SYNTAX_COMMENT);
+    }
+
+    if ( state == SYNTAX_C_STRING ) {
+        i = syntax_quoted(s, 0, end, '"', &closed);
+        syntax_mark(out, 0, i, SYNTAX_STRING);
+        if ( !closed ) { return continued ? SYNTAX_C_STRING : SYNTAX_C_NORMAL; }
+    }
+
+    if ( state == SYNTAX_C_NORMAL ) {
+        size_t k = 0;
+        while ( k < end && (s[k] == ' ' || s[k] == '\t') ) { k += 1; }
+        preproc = k < end && s[k] == '#';
+    }
+
+    while ( i < end ) {
+
+        char c = s[i];
+        char next = i + 1 < end ? s[i+1] : '\0';
+        size_t j = i + 1;
+
+        // only comments and strings carry over to the next line, so lexing
+        // just for the state can skip everything else
+        if ( syntax_quiet(out, quiet, i) && c != '/' && c != '"' && c != '\'' ) {
+            i = j;
+            continue;
+        }
+
+        if ( c == '/' && next == '/' ) {
+            syntax_mark(out, i, end, SYNTAX_COMMENT);
+            return continued ? SYNTAX_C_LINE_COMMENT : SYNTAX_C_NORMAL;
+        }
+
+        if ( c == '/' && next == '*' ) {
+            const char* close = linescan_find_str(&s[i+2], end - i - 2, "*/", 2);
+            if ( close == NULL ) {
+                syntax_mark(out, i, end, SYNTAX_COMMENT);
+                return SYNTAX_C_COMMENT;
+            }
+            j = (size_t)(close - s) + 2;
+            syntax_mark(out, i, j, SYNTAX_COMMENT);
+        } else if ( c == '"' || c == '\'' ) {
+            j = syntax_quoted(s, i + 1, end, c, &closed);
+            syntax_mark(out, i, j, SYNTAX_STRING);
+            if ( !closed && c == '"' && continued ) { return SYNTAX_C_STRING; }
+        } else if ( preproc ) {
+            syntax_mark(out, i, j, SYNTAX_PREPROC);
+        } else if ( isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)next)) ) {
+            j = syntax_number(s, j, end);
+            syntax_mark(out, i, j, SYNTAX_NUMBER);
+        } else if ( syntax_ident(c) ) {
+            while ( j < end && syntax_ident(s[j]) ) { j += 1; }
+            syntax_class cls = SYNTAX_PLAIN;
+            if ( syntax_lookup(syntax_c_keywords, SYNTAX_COUNT(syntax_c_keywords), &s[i], j - i) ) {
+                cls = SYNTAX_KEYWORD;
+            } else if ( syntax_lookup(syntax_c_types, SYNTAX_COUNT(syntax_c_types), &s[i], j - i) ) {
+                cls = SYNTAX_TYPE;
+            }
+            syntax_mark(out, i, j, cls);
+        } else {
+            syntax_mark(out, i, j, SYNTAX_PLAIN);
+        }
+
+        i = j;
+
+    }
+
+    return preproc && continued ? SYNTAX_C_PREPROC : SYNTAX_C_NORMAL;
+
+}
+
+/* shell, python, make and other languages with # comments */
+
+enum {
+    SYNTAX_SCRIPT_NORMAL = 0,
+    SYNTAX_SCRIPT_DOUBLE,
+    SYNTAX_SCRIPT_SINGLE
+};
+
+static const char* const syntax_script_keywords[] = {
+    "False", "None", "True", "and", "as", "break", "case", "class",
+    "continue", "def", "do", "done", "elif", "else", "esac", "except", "export",
+    "fi", "finally", "for", "from", "function", "if", "import", "in",
+    "lambda", "local", "not", "or", "pass", "raise", "return", "then", "try",
+    "while", "with", "yield"
+};
+
+static uint32_t syntax_lex_script(uint32_t state, const char* s, size_t len, const syntax_span* out) {
+
+    size_t end = syntax_text_len(s, len);
+    syntax_mark(out, end, len, SYNTAX_PLAIN);
+
+    size_t i = 0;
+    size_t quiet = syntax_quiet_until(s, out);
+    bool closed = false;
+
+    // strings may run over several lines
+    if ( state != SYNTAX_SCRIPT_NORMAL ) {
+        char quote = state == SYNTAX_SCRIPT_DOUBLE ? '"' : '\'';
+        i = syntax_quoted(s, 0, end, quote, &closed);
+        syntax_mark(out, 0, i, SYNTAX_STRING);
+        if ( !closed ) { return state; }
+    }
+
+    while ( i < end ) {
+
+        char c = s[i];
+        size_t j = i + 1;
+
+        // as in C, only strings and comments matter for the state
+        if ( syntax_quiet(out, quiet, i) && c != '#' && c != '"' && c != '\'' ) {
+            i = j;
+            continue;
+        }
+
+        // a # inside a word, like $#, isn't a comment
+        if ( c == '#' && (i == 0 || isspace((unsigned char)s[i-1])) ) {
+            syntax_mark(out, i, end, SYNTAX_COMMENT);
+            return SYNTAX_SCRIPT_NORMAL;
+        }
+
+        if ( c == '"' || c == '\'' ) {
+            j = syntax_quoted(s, i + 1, end, c, &closed);
+            syntax_mark(out, i, j, SYNTAX_STRING);
+            if ( !closed ) { return c == '"' ? SYNTAX_SCRIPT_DOUBLE : SYNTAX_SCRIPT_SINGLE; }
+        } else if ( isdigit((unsigned char)c) && (i == 0 || !syntax_ident(s[i-1])) ) {
+            j = syntax_number(s, j, end);
+            syntax_mark(out, i, j, SYNTAX_NUMBER);
+        } else if ( c == '$' && j < end && (syntax_ident(s[j]) || s[j] == '{') ) {
+            while ( j < end && (syntax_ident(s[j]) || s[j] == '{' || s[j] == '}') ) { j += 1; }
+            syntax_mark(out, i, j, SYNTAX_TYPE);
+        } else if ( syntax_ident(c) ) {
+            while ( j < end && syntax_ident(s[j]) ) { j += 1; }
+            bool kw = syntax_lookup(syntax_script_keywords, SYNTAX_COUNT(syntax_script_keywords), &s[i], j - i);
+            syntax_mark(out, i, j, kw ? SYNTAX_KEYWORD : SYNTAX_PLAIN);
+        } else {
+            syntax_mark(out, i, j, SYNTAX_PLAIN);
+        }
+
+        i = j;
+
+    }
+
+    return SYNTAX_SCRIPT_NORMAL;
+
+}
+
+static const char* const syntax_c_suffixes[] = {
+    ".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp", ".hxx", ".inl", NULL
+};
+
+static const char* const syntax_script_suffixes[] = {
+    ".sh", ".bash", ".py", ".mk", ".cmake", ".conf", "Makefile", "makefile", "CMakeLists.txt", NULL
+};
+
+// a new language is a lexer and a row here
+static const syntax_lang syntax_langs[] = {
+    { "c", syntax_c_suffixes, syntax_lex_c },
+    { "script", syntax_script_suffixes, syntax_lex_script },
+};
+
+// language for a file, by the end of its name; NULL for plain text
+const syntax_lang* syntax_for_path(const char* path) {
+
+    if ( path == NULL ) { return NULL; }
+    size_t plen = strlen(path);
+
+    for ( size_t i = 0; i < SYNTAX_COUNT(syntax_langs); i++ ) {
+        for ( const char* const* suffix = syntax_langs[i].suffixes; *suffix != NULL; suffix++ ) {
+            size_t slen = strlen(*suffix);
+            if ( slen <= plen && strcmp(&path[plen - slen], *suffix) == 0 ) { return &syntax_langs[i]; }
+        }
+    }
+
+    return NULL;
+
+}
+
+textErr syntaxcache_init(syntaxcache** inst, const syntax_lang* lang) {
+    #define ref (*inst)
+
+    if ( inst == NULL || lang == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    ref = (syntaxcache*)calloc(1, sizeof(syntaxcache));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    ref->lang = lang;
+
+    return ERR_NONE;
+
+}
+
+textErr syntaxcache_destroy(syntaxcache** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    free(ref->states);
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
+
+static textErr syntaxcache_reserve(syntaxcache* c, size_t count) {
+
+    if ( count <= c->cap ) { return ERR_NONE; }
+
+    size_t newcap = c->cap ? c->cap : 1024;
+    while ( newcap < count ) { newcap *= 2; }
+
+    uint32_t* grown = (uint32_t*)realloc(c->states, sizeof(uint32_t) * newcap);
+    if ( grown == NULL ) { return ERR_MEM; }
+
+    c->states = grown;
+    c->cap = newcap;
+
+    return ERR_NONE;
+
+}
+
+// forget everything and start lexing over at line `base`
+void syntaxcache_reset(syntaxcache** inst, size_t base) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return; }
+
+    ref->base = base;
+    ref->valid = 0;
+    ref->known = 0;
+    ref->settled = 0;
+
+}
+
+// line `line` and the `removed` lines after it were replaced by it and
+// `added` new ones
+void syntaxcache_edit(syntaxcache** inst, size_t line, size_t removed, size_t added) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return; }
+
+    // every line the cache holds moved
+    if ( line < ref->base ) {
+        syntaxcache_reset(inst, ref->base);
+        return;
+    }
+
+    size_t rel = line - ref->base;
+    if ( rel >= ref->known ) { return; }
+
+    // keep the hints past the edited lines, moved to where those lines are now
+    size_t tail = rel + 1 + removed;
+    if ( tail < ref->known && syntaxcache_reserve(ref, ref->known - removed + added) == ERR_NONE ) {
+        memmove(&ref->states[rel + 1 + added], &ref->states[tail], sizeof(uint32_t) * (ref->known - tail));
+        ref->known = ref->known - removed + added;
+    } else {
+        ref->known = rel;
+    }
+
+    if ( ref->settled > rel + removed ) { ref->settled = ref->settled - removed + added; }
+    if ( ref->settled < rel + added + 1 ) { ref->settled = rel + added + 1; }
+
+    if ( ref->valid > rel ) { ref->valid = rel; }
+
+}
+
+// record the state line base+valid ends in, the next one to be lexed
+textErr syntaxcache_store(syntaxcache** inst, uint32_t state) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    if ( ref->valid < ref->known ) {
+        // back in step with the lexing done before the edit
+        if ( ref->valid >= ref->settled && ref->states[ref->valid] == state ) {
+            ref->valid = ref->known;
+            ref->settled = 0;
+            return ERR_NONE;
+        }
+        // hints are only worth comparing against while they come from one
+        // pass; the ones just overwritten don't, so convergence has to wait
+        // for the hints past them
+        ref->states[ref->valid++] = state;
+        if ( ref->settled < ref->valid ) { ref->settled = ref->valid; }
+        return ERR_NONE;
+    }
+
+    textErr ret = syntaxcache_reserve(ref, ref->valid + 1);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ref->states[ref->valid++] = state;
+    ref->known = ref->valid;
+
+    return ERR_NONE;
+
+}
@@ -0,0 +1,94 @@
+#ifndef SYNTAXHIGHLIGHT_H
+#define SYNTAXHIGHLIGHT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+// what a byte of text is, for picking its color
+typedef enum {
+
+    SYNTAX_PLAIN = 0,
+    SYNTAX_KEYWORD,
+    SYNTAX_TYPE,
+    SYNTAX_STRING,
+    SYNTAX_NUMBER,
+    SYNTAX_COMMENT,
+    SYNTAX_PREPROC,
+
+    SYNTAX_CLASSES
+
+} syntax_class;
+
+// the part of a line a lexer writes classes for: bytes [from, to) of the
+// line go to classes[0, to - from)
+typedef struct {
+
+    uint8_t* classes;
+    size_t from;
+    size_t to;
+
+} syntax_span;
+
+// a lexer colors one line at a time. it starts in `state`, the state the
+// previous line ended in (0 at the top of the document), writes a class for
+// each byte `out` covers unless `out` is NULL, and returns the state the
+// line ends in. states are the lexer's own business; the only thing they
+// promise is that two lines starting in the same state with the same text
+// color the same.
+typedef uint32_t (*syntax_lex)(uint32_t state, const char* line, size_t len, const syntax_span* out);
+
+typedef struct {
+
+    const char* name;
+
+    // file name suffixes it is picked for, NULL terminated
+    const char* const* suffixes;
+
+    syntax_lex lex;
+
+} syntax_lang;
+
+// lines lexed in one go to reach the viewport before giving up on exact
+// states; past that the lexer starts over SYNTAX_LOOKBACK lines up
+#define SYNTAX_CATCHUP ((size_t)1 << 18)
+#define SYNTAX_LOOKBACK ((size_t)256)
+
+// syntaxcache keeps the state each line ends in, for lines `base` onwards.
+// states[0, valid) are current. an edit only moves `valid` back to the
+// edited line; the states after it are kept as `known` hints, shifted to
+// follow inserted and removed lines. lexing forward again from the edit,
+// the first line at or past `settled` that ends in its old state means
+// every hint after it is right too, so `valid` jumps straight to `known`.
+// `base` is 0 unless the viewport jumped too far ahead to lex up to it;
+// line `base` is then assumed to start in state 0.
+typedef struct {
+
+    const syntax_lang* lang;
+
+    uint32_t* states;
+    size_t cap;
+
+    size_t base;
+    size_t valid;
+    size_t known;
+    size_t settled;
+
+} syntaxcache;
+
+const syntax_lang* syntax_for_path(const char* path);
+
+textErr syntaxcache_init(syntaxcache** inst, const syntax_lang* lang);
+textErr syntaxcache_destroy(syntaxcache** inst);
+
+void syntaxcache_edit(syntaxcache** inst, size_t line, size_t removed, size_t added);
+void syntaxcache_reset(syntaxcache** inst, size_t base);
+textErr syntaxcache_store(syntaxcache** inst, uint32_t state);
+
+// state line `line` starts in; only meaningful for base <= line <= base+valid
+static inline uint32_t syntaxcache_entry(const syntaxcache* c, size_t line) {
+    return line > c->base ? c->states[line - c->base - 1] : 0;
+}
+
+#endif /* SYNTAXHIGHLIGHT_H */
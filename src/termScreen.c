@@ -0,0 +1,293 @@
+
+#include <string.h>
+
+#include "termScreen.h"
+
+// the in-memory backend: a rows x cols grid of bytes and attributes, and a
+// queue of keys waiting to be read
+typedef struct {
+
+    int rows;
+    int cols;
+    char* text;
+    uint16_t* attrs;
+
+    int* keys;
+    size_t keys_head;
+    size_t keys_len;
+    size_t keys_cap;
+
+} gridscreen;
+
+static void gridscreen_blank(gridscreen* g, int y, int x, int len) {
+    memset(&g->text[(size_t)y * g->cols + x], ' ', (size_t)len);
+    memset(&g->attrs[(size_t)y * g->cols + x], 0, sizeof(uint16_t) * (size_t)len);
+}
+
+// cut a span of `len` cells at y, x to the grid; false if nothing is left
+static bool gridscreen_clip(const gridscreen* g, int y, int x, int* len) {
+    if ( y < 0 || y >= g->rows || x < 0 || x >= g->cols || *len <= 0 ) { return false; }
+    if ( *len > g->cols - x ) { *len = g->cols - x; }
+    return true;
+}
+
+static void gridscreen_size(termscreen* s, int* rows, int* cols) {
+    gridscreen* g = (gridscreen*)s->impl;
+    *rows = g->rows;
+    *cols = g->cols;
+}
+
+static void gridscreen_clear_all(termscreen* s) {
+    gridscreen* g = (gridscreen*)s->impl;
+    for ( int y = 0; y < g->rows; y++ ) { gridscreen_blank(g, y, 0, g->cols); }
+}
+
+static void gridscreen_clear_row(termscreen* s, int y, int x) {
+    gridscreen* g = (gridscreen*)s->impl;
+    int len = g->cols - x;
+    if ( gridscreen_clip(g, y, x, &len) ) { gridscreen_blank(g, y, x, len); }
+}
+
+static void gridscreen_put(termscreen* s, int y, int x, const char* str, int len, int attr) {
+
+    gridscreen* g = (gridscreen*)s->impl;
+    if ( !gridscreen_clip(g, y, x, &len) ) { return; }
+
+    memcpy(&g->text[(size_t)y * g->cols + x], str, (size_t)len);
+    for ( int i = 0; i < len; i++ ) { g->attrs[(size_t)y * g->cols + x + i] = (uint16_t)attr; }
+
+}
+
+static void gridscreen_hrule(termscreen* s, int y, int x, int len) {
+    gridscreen* g = (gridscreen*)s->impl;
+    if ( !gridscreen_clip(g, y, x, &len) ) { return; }
+    memset(&g->text[(size_t)y * g->cols + x], '-', (size_t)len);
+    memset(&g->attrs[(size_t)y * g->cols + x], 0, sizeof(uint16_t) * (size_t)len);
+}
+
+static void gridscreen_vrule(termscreen* s, int y, int x) {
+    gridscreen_put(s, y, x, "|", 1, 0);
+}
+
+static void gridscreen_invert(termscreen* s, int y, int x) {
+    gridscreen* g = (gridscreen*)s->impl;
+    int len = 1;
+    if ( gridscreen_clip(g, y, x, &len) ) { g->attrs[(size_t)y * g->cols + x] |= TERMSCREEN_REVERSE; }
+}
+
+static void gridscreen_scroll_rows(termscreen* s, int top, int bottom, int n) {
+
+    gridscreen* g = (gridscreen*)s->impl;
+    if ( top < 0 ) { top = 0; }
+    if ( bottom >= g->rows ) { bottom = g->rows - 1; }
+
+    int height = bottom - top + 1;
+    int shift = n > 0 ? n : -n;
+    if ( height <= 0 || shift == 0 ) { return; }
+    if ( shift > height ) { shift = height; }
+
+    size_t w = (size_t)g->cols;
+    size_t moved = (size_t)(height - shift) * w;
+    int from = n > 0 ? top + shift : top;
+    int to = n > 0 ? top : top + shift;
+    memmove(&g->text[to * w], &g->text[from * w], moved);
+    memmove(&g->attrs[to * w], &g->attrs[from * w], moved * sizeof(uint16_t));
+
+    int uncovered = n > 0 ? bottom - shift + 1 : top;
+    for ( int i = 0; i < shift; i++ ) { gridscreen_blank(g, uncovered + i, 0, g->cols); }
+
+}
+
+static void gridscreen_flush(termscreen* s) {
+}
+
+static int gridscreen_key(termscreen* s) {
+
+    gridscreen* g = (gridscreen*)s->impl;
+    if ( g->keys_head == g->keys_len ) { return -1; }
+
+    int key = g->keys[g->keys_head++];
+    if ( g->keys_head == g->keys_len ) {
+        g->keys_head = 0;
+        g->keys_len = 0;
+    }
+
+    return key;
+
+}
+
+// takes queued keys up to enter; an empty queue ends the input too, since
+// nothing else is going to type
+static void gridscreen_prompt(termscreen* s, const char* label, char* buf, int buflen) {
+
+    gridscreen_clear_row(s, 0, 0);
+    gridscreen_put(s, 0, 0, label, (int)strlen(label), 0);
+
+    int len = 0;
+    int key;
+    while ( (key = gridscreen_key(s)) != -1 && key != 10 ) {
+        if ( key == TERMSCREEN_KEY_BACKSPACE || key == 127 ) {
+            if ( len > 0 ) { len -= 1; }
+        } else if ( key >= 32 && key <= 126 && len < buflen - 1 ) {
+            buf[len++] = (char)key;
+        }
+    }
+    buf[len] = '\0';
+
+    gridscreen_put(s, 0, (int)strlen(label), buf, len, 0);
+
+}
+
+static void gridscreen_close(termscreen* s) {
+
+    gridscreen* g = (gridscreen*)s->impl;
+    free(g->text);
+    free(g->attrs);
+    free(g->keys);
+    free(g);
+
+}
+
+static const termscreen_ops gridscreen_ops = {
+    gridscreen_size,
+    gridscreen_clear_all,
+    gridscreen_clear_row,
+    gridscreen_put,
+    gridscreen_hrule,
+    gridscreen_vrule,
+    gridscreen_invert,
+    gridscreen_scroll_rows,
+    gridscreen_flush,
+    gridscreen_key,
+    gridscreen_prompt,
+    gridscreen_close,
+};
+
+textErr termscreen_grid(termscreen** inst, int rows, int cols) {
+
+    if ( inst == NULL ) { return ERR_NULL; }
+
+    termscreen* s = (termscreen*)calloc(1, sizeof(termscreen));
+    if ( s == NULL ) { return ERR_MEM; }
+
+    gridscreen* g = (gridscreen*)calloc(1, sizeof(gridscreen));
+    if ( g == NULL ) {
+        free(s);
+        return ERR_MEM;
+    }
+
+    s->ops = &gridscreen_ops;
+    s->impl = g;
+    s->colors = true;
+
+    textErr ret = termscreen_grid_resize(&s, rows, cols);
+    if ( ret != ERR_NONE ) {
+        termscreen_destroy(&s);
+        return ret;
+    }
+
+    *inst = s;
+
+    return ERR_NONE;
+
+}
+
+textErr termscreen_grid_push(termscreen** inst, int key) {
+
+    if ( inst == NULL || *inst == NULL ) { return ERR_NULL; }
+    gridscreen* g = (gridscreen*)(*inst)->impl;
+
+    if ( g->keys_len == g->keys_cap ) {
+        size_t newcap = g->keys_cap ? g->keys_cap * 2 : 64;
+        int* grown = (int*)realloc(g->keys, sizeof(int) * newcap);
+        if ( grown == NULL ) { return ERR_MEM; }
+        g->keys = grown;
+        g->keys_cap = newcap;
+    }
+    g->keys[g->keys_len++] = key;
+
+    return ERR_NONE;
+
+}
+
+textErr termscreen_grid_paste(termscreen** inst, const char* text, size_t len) {
+
+    if ( inst == NULL || *inst == NULL || text == NULL ) { return ERR_NULL; }
+
+    (*inst)->paste_len = 0;
+    textErr ret = termscreen_paste_add(*inst, text, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    return termscreen_grid_push(inst, TERMSCREEN_KEY_PASTE);
+
+}
+
+// the contents are lost, like a terminal's after a resize before redrawing
+textErr termscreen_grid_resize(termscreen** inst, int rows, int cols) {
+
+    if ( inst == NULL || *inst == NULL ) { return ERR_NULL; }
+    if ( rows < 0 ) { rows = 0; }
+    if ( cols < 0 ) { cols = 0; }
+    gridscreen* g = (gridscreen*)(*inst)->impl;
+
+    size_t cells = (size_t)rows * (size_t)cols;
+    char* text = (char*)malloc(cells + 1);
+    uint16_t* attrs = (uint16_t*)malloc(sizeof(uint16_t) * (cells + 1));
+    if ( text == NULL || attrs == NULL ) {
+        free(text);
+        free(attrs);
+        return ERR_MEM;
+    }
+
+    free(g->text);
+    free(g->attrs);
+    g->text = text;
+    g->attrs = attrs;
+    g->rows = rows;
+    g->cols = cols;
+    gridscreen_clear_all(*inst);
+
+    return ERR_NONE;
+
+}
+
+const char* termscreen_grid_row(const termscreen* s, int y, const uint16_t** attrs) {
+
+    const gridscreen* g = (const gridscreen*)s->impl;
+    if ( y < 0 || y >= g->rows ) { return NULL; }
+
+    if ( attrs != NULL ) { *attrs = &g->attrs[(size_t)y * g->cols]; }
+    return &g->text[(size_t)y * g->cols];
+
+}
+
+textErr termscreen_paste_add(termscreen* s, const char* text, size_t len) {
+
+    if ( s->paste_len + len > s->paste_cap ) {
+        size_t newcap = s->paste_cap ? s->paste_cap : 4096;
+        while ( newcap < s->paste_len + len ) { newcap *= 2; }
+        char* grown = (char*)realloc(s->paste, newcap);
+        if ( grown == NULL ) { return ERR_MEM; }
+        s->paste = grown;
+        s->paste_cap = newcap;
+    }
+
+    memcpy(&s->paste[s->paste_len], text, len);
+    s->paste_len += len;
+
+    return ERR_NONE;
+
+}
+
+textErr termscreen_destroy(termscreen** inst) {
+
+    if ( inst == NULL || *inst == NULL ) { return ERR_NULL; }
+
+    (*inst)->ops->close(*inst);
+    free((*inst)->paste);
+    free(*inst);
+    *inst = NULL;
+
+    return ERR_NONE;
+
+}
@@ -0,0 +1,135 @@
+#ifndef TERMSCREEN_H
+#define TERMSCREEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+// keys that aren't a single byte. backends translate their own codes to
+// these; printable keys, enter (10), escape (27) and ctrl+letter come
+// through as the byte.
+#define TERMSCREEN_KEY_UP 0x1000
+#define TERMSCREEN_KEY_DOWN 0x1001
+#define TERMSCREEN_KEY_LEFT 0x1002
+#define TERMSCREEN_KEY_RIGHT 0x1003
+#define TERMSCREEN_KEY_BACKSPACE 0x1004
+#define TERMSCREEN_KEY_DELETE 0x1005
+#define TERMSCREEN_KEY_PAGE_UP 0x1007
+#define TERMSCREEN_KEY_PAGE_DOWN 0x1008
+#define TERMSCREEN_KEY_HOME 0x1009
+#define TERMSCREEN_KEY_END 0x100a
+
+// a paste: the terminal sent a block of text in bracketed paste markers.
+// the text is in the screen's `paste` until the next key is read.
+#define TERMSCREEN_KEY_PASTE 0x1006
+
+// a cell's attribute: the low byte is the syntax class it is colored as,
+// plus flags
+#define TERMSCREEN_CLASS_MASK 0xff
+#define TERMSCREEN_REVERSE 0x100
+
+typedef struct termscreen termscreen;
+
+// what a backend implements. coordinates are row, column from the top left;
+// writes past the right edge are cut off.
+typedef struct {
+
+    void (*size)(termscreen* s, int* rows, int* cols);
+    void (*clear_all)(termscreen* s);
+
+    // blank row `y` from column `x` to the end
+    void (*clear_row)(termscreen* s, int y, int x);
+    void (*put)(termscreen* s, int y, int x, const char* str, int len, int attr);
+    void (*hrule)(termscreen* s, int y, int x, int len);
+    void (*vrule)(termscreen* s, int y, int x);
+
+    // show the cell at y, x in reverse video
+    void (*invert)(termscreen* s, int y, int x);
+
+    // move rows top..bottom up by `n` rows (down if negative), blanking the
+    // rows uncovered
+    void (*scroll_rows)(termscreen* s, int top, int bottom, int n);
+
+    // make what was written visible
+    void (*flush)(termscreen* s);
+
+    // next key without waiting, -1 if there is none
+    int (*key)(termscreen* s);
+
+    // read a line of input on the top row after `label`, until enter
+    void (*prompt)(termscreen* s, const char* label, char* buf, int buflen);
+
+    void (*close)(termscreen* s);
+
+} termscreen_ops;
+
+// the renderer draws through a termscreen: the terminal through ncurses, or
+// an in-memory grid of cells fed from a key queue, for running the real
+// render path without a terminal
+struct termscreen {
+
+    const termscreen_ops* ops;
+    void* impl;
+
+    // whether syntax classes get their own colors
+    bool colors;
+
+    // cells written since the screen was opened
+    size_t cells;
+
+    // text of the last TERMSCREEN_KEY_PASTE, line breaks as '\n'
+    char* paste;
+    size_t paste_len;
+    size_t paste_cap;
+
+};
+
+textErr termscreen_curses(termscreen** inst);
+textErr termscreen_grid(termscreen** inst, int rows, int cols);
+textErr termscreen_destroy(termscreen** inst);
+
+// for backends: add to the paste being read
+textErr termscreen_paste_add(termscreen* s, const char* text, size_t len);
+
+// grid screens only: queue a key for `key` to return, or a paste (one at a
+// time), change the size the next frame sees, and read back a row's text and
+// attributes
+textErr termscreen_grid_push(termscreen** inst, int key);
+textErr termscreen_grid_paste(termscreen** inst, const char* text, size_t len);
+textErr termscreen_grid_resize(termscreen** inst, int rows, int cols);
+const char* termscreen_grid_row(const termscreen* s, int y, const uint16_t** attrs);
+
+static inline void termscreen_size(termscreen* s, int* rows, int* cols) { s->ops->size(s, rows, cols); }
+static inline void termscreen_clear(termscreen* s) { s->ops->clear_all(s); }
+static inline void termscreen_clear_row(termscreen* s, int y, int x) { s->ops->clear_row(s, y, x); }
+static inline void termscreen_scroll(termscreen* s, int top, int bottom, int n) { s->ops->scroll_rows(s, top, bottom, n); }
+static inline void termscreen_refresh(termscreen* s) { s->ops->flush(s); }
+static inline int termscreen_key(termscreen* s) { return s->ops->key(s); }
+
+static inline void termscreen_prompt(termscreen* s, const char* label, char* buf, int buflen) {
+    s->ops->prompt(s, label, buf, buflen);
+}
+
+// writes count the cells they cover
+static inline void termscreen_put(termscreen* s, int y, int x, const char* str, int len, int attr) {
+    s->cells += len > 0 ? (size_t)len : 0;
+    s->ops->put(s, y, x, str, len, attr);
+}
+
+static inline void termscreen_hrule(termscreen* s, int y, int x, int len) {
+    s->cells += len > 0 ? (size_t)len : 0;
+    s->ops->hrule(s, y, x, len);
+}
+
+static inline void termscreen_vrule(termscreen* s, int y, int x) {
+    s->cells += 1;
+    s->ops->vrule(s, y, x);
+}
+
+static inline void termscreen_invert(termscreen* s, int y, int x) {
+    s->cells += 1;
+    s->ops->invert(s, y, x);
+}
+
+#endif /* TERMSCREEN_H */
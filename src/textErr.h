@@ -5,6 +5,9 @@
 
 typedef enum {
 
+    ERR_PATTERN = -6,
+    ERR_BUSY = -5,
+    ERR_IO = -4,
     ERR_EOF = -3,
     ERR_NULL = -2,
     ERR_MEM = -1,
@@ -14,6 +17,9 @@ typedef enum {
 
 static inline const char* textErr_tostr(textErr err) {
     switch (err) {
+        case ERR_PATTERN: return "Invalid pattern";
+        case ERR_BUSY: return "Not ready yet";
+        case ERR_IO:   return "I/O error";
         case ERR_EOF:  return "End of file";
         case ERR_NULL: return "Null pointer";
         case ERR_MEM:  return "Memory allocation error";
@@ -1,58 +1,169 @@
 #include "textMan.h"
+#include "lineScan.h"
+#include "textTrace.h"
 
 static textErr linesize(const char* textbuff, size_t* len) {
 
     if ( textbuff == NULL || len == NULL ) { return ERR_NULL; }
 
-    const char* ptr = textbuff;
+    const char* end = linescan_terminator(textbuff);
     
-    *len = 0;
-    while ( *ptr != '\n' ) {
-        if (*ptr == '\0') { return ERR_EOF; }
+    *len = (size_t)(end - textbuff);
+    if ( *end == '\0' ) { return ERR_EOF; }
 
-        (*len) += 1;
-        ptr++;
+    return ERR_NONE;
 
-    }
+}
 
-    return ERR_NONE;
+// source of linebuf stamps. lines are only created and edited on the ui
+// thread, so a plain counter is enough.
+static uint64_t linebuf_stamp_next = 0;
 
+static void linebuf_touch(linebuf* lb) {
+    lb->stamp = ++linebuf_stamp_next;
 }
 
 textErr linebuf_init(linebuf** inst, const char* src, size_t strsize) {
+    return linebuf_alloc(inst, NULL, src, strsize);
+}
+
+// like linebuf_init, but the node and its text come from `pool` when it is
+// not NULL
+textErr linebuf_alloc(linebuf** inst, linepool* pool, const char* src, size_t strsize) {
     #define ref (*inst)
     if ( inst == NULL ) { return ERR_NULL; }
 
     if ( ref != NULL ) { return ERR_NULL; }
 
-    ref = (linebuf*)calloc(1, sizeof(linebuf));
-    if ( ref == NULL ) { return ERR_MEM; }
+    if ( pool != NULL ) {
+        textErr ret = linepool_alloc_node(&pool, inst);
+        if ( ret != ERR_NONE ) { return ret; }
+    } else {
+        ref = (linebuf*)calloc(1, sizeof(linebuf));
+        if ( ref == NULL ) { return ERR_MEM; }
+    }
+
+    ref->pool = pool;
+    linebuf_touch(ref);
 
     if ( src != NULL ) {
-        ref->line = (char*)malloc(strsize+1);
-        if ( ref->line == NULL ) { return ERR_MEM; }
+        textErr ret = linebuf_reserve(inst, strsize);
+        if ( ret != ERR_NONE ) { return ret; }
         memcpy(ref->line, src, strsize);
         ref->line[strsize] = '\0';
         // length is the number of meaningful bytes (excluding the added NUL terminator)
         ref->len = strsize;
-        ref->cap = strsize;
     }
 
     return ERR_NONE;
 
 }
 
-textErr linebuf_parse(linebuf** inst, const char* src, size_t maxlines, size_t *charcount) {
+// make room for at least `cap` bytes plus a NUL terminator, keeping the
+// current contents
+textErr linebuf_reserve(linebuf** inst, size_t cap) {
     #define ref (*inst)
-    if ( inst == NULL ) { return ERR_NULL; }
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    if ( ref->line != NULL && ref->cap >= cap ) { return ERR_NONE; }
+
+    size_t newcap = cap;
+    if ( ref->line != NULL && newcap < ref->cap*2 ) { newcap = ref->cap*2; }
+
+    char* newline = NULL;
+    if ( ref->pool != NULL ) {
+        size_t block = 0;
+        textErr ret = linepool_alloc_text(&ref->pool, newcap+1, &newline, &block);
+        if ( ret != ERR_NONE ) { return ret; }
+        newcap = block - 1;
+    } else {
+        newline = (char*)malloc(newcap+1);
+        if ( newline == NULL ) { return ERR_MEM; }
+    }
+
+    if ( ref->line != NULL ) {
+        memcpy(newline, ref->line, ref->len);
+        if ( ref->pool != NULL ) {
+            linepool_free_text(&ref->pool, ref->line, ref->cap+1);
+        } else {
+            free(ref->line);
+        }
+    }
+    newline[ref->len] = '\0';
+
+    ref->line = newline;
+    ref->cap = newcap;
+
+    return ERR_NONE;
+
+}
+
+// insert `len` bytes of `src` before byte `pos`
+textErr linebuf_insert(linebuf** inst, size_t pos, const char* src, size_t len) {
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || src == NULL ) { return ERR_NULL; }
+
+    if ( pos > ref->len ) { return ERR_EOF; }
+
+    textErr ret = linebuf_reserve(inst, ref->len + len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    memmove(&ref->line[pos+len], &ref->line[pos], ref->len - pos);
+    memcpy(&ref->line[pos], src, len);
+    ref->len += len;
+    ref->line[ref->len] = '\0';
+
+    linebuf_touch(ref);
+
+    return ERR_NONE;
+
+}
+
+// remove up to `len` bytes starting at `pos`
+textErr linebuf_erase(linebuf** inst, size_t pos, size_t len) {
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    if ( pos >= ref->len ) { return ERR_EOF; }
+    if ( len > ref->len - pos ) { len = ref->len - pos; }
+
+    memmove(&ref->line[pos], &ref->line[pos+len], ref->len - pos - len);
+    ref->len -= len;
+    ref->line[ref->len] = '\0';
+
+    linebuf_touch(ref);
+
+    return ERR_NONE;
+
+}
+
+textErr linebuf_destroy(linebuf** inst) {
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    if ( ref->pool != NULL ) {
+        linepool* pool = ref->pool;
+        if ( ref->line != NULL ) { linepool_free_text(&pool, ref->line, ref->cap+1); }
+        linepool_free_node(&pool, ref);
+    } else {
+        free(ref->line);
+        free(ref);
+    }
+
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
+
+// parse up to `maxlines` lines of `src` and append them to the view
+textErr linebuf_parse(viewbuf** inst, const char* src, size_t maxlines, size_t *charcount) {
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
 
     if ( src == NULL ) { return ERR_NULL; }
 
     size_t copyposition = 0;
-    size_t lines_parsed = 0;
-
-    linebuf* head = NULL;
-    linebuf* tail = NULL;
 
     for ( size_t line = 0; line < maxlines; line++ ) {
 
@@ -69,18 +180,13 @@ textErr linebuf_parse(linebuf** inst, const char* src, size_t maxlines, size_t *
         textErr ret = linebuf_init(&node, &src[copyposition], to_copy);
         if ( ret != ERR_NONE ) { return ret; }
 
-        // append to list
-        node->prev = (struct linebuf*)tail;
-        node->next = NULL;
-        if ( tail != NULL ) {
-            tail->next = (struct linebuf*)node;
-        } else {
-            head = node;
+        ret = viewbuf_push_back(inst, node);
+        if ( ret != ERR_NONE ) {
+            linebuf_destroy(&node);
+            return ret;
         }
-        tail = node;
 
         copyposition += to_copy;
-        lines_parsed += 1;
 
         if ( lret == ERR_EOF ) { break; }
     }
@@ -89,13 +195,11 @@ textErr linebuf_parse(linebuf** inst, const char* src, size_t maxlines, size_t *
         *charcount = copyposition;
     }
 
-    ref = head;
-
     return ERR_NONE;
 
 }
 
-textErr viewbuf_init(viewbuf** inst, linebuf* head, size_t maxlines) {
+textErr viewbuf_init(viewbuf** inst, size_t cap) {
     #define ref (*inst)
 
     if ( inst == NULL ) { return ERR_NULL; }
@@ -104,358 +208,813 @@ textErr viewbuf_init(viewbuf** inst, linebuf* head, size_t maxlines) {
     ref = (viewbuf*)calloc(1, sizeof(viewbuf));
     if ( ref == NULL ) { return ERR_MEM; }
 
-    ref->head = head;
+    size_t ringcap = 16;
+    while ( ringcap < cap ) { ringcap *= 2; }
+
+    ref->ring = (linebuf**)calloc(ringcap, sizeof(linebuf*));
+    if ( ref->ring == NULL ) {
+        free(ref);
+        ref = NULL;
+        return ERR_MEM;
+    }
+
+    ref->cap = ringcap;
+    ref->first = 0;
     ref->headline = 1;
     ref->lines = 0;
 
-    if ( head != NULL ) {
-        linebuf* cur = head;
-        size_t linelim = (maxlines == 0) ? SIZE_MAX : maxlines;
-        for ( size_t line = 0; line < linelim && cur != NULL; line++ ) {
-            ref->lines += 1;
-            cur = linebuf_next(cur);
-        }
+    return ERR_NONE;
+
+}
+
+textErr viewbuf_destroy(viewbuf** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    for ( size_t i = 0; i < ref->lines; i++ ) {
+        linebuf_destroy(&viewbuf_line(ref, i));
     }
 
+    free(ref->ring);
+    free(ref);
+    ref = NULL;
+
     return ERR_NONE;
 
 }
 
-textErr viewbuf_remove_empty_lines(viewbuf** inst) {
+// double the ring once it is full, unwrapping it so the top line is slot 0
+static textErr viewbuf_grow(viewbuf** inst) {
 
     #define ref (*inst)
-    if ( inst == NULL ) { return ERR_NULL; }
-    if ( ref == NULL ) { return ERR_NULL; }
-    
-    linebuf* node = ref->head;
-    if ( node == NULL ) { return ERR_NONE; }
 
-    while ( node ) {
+    if ( ref->lines < ref->cap ) { return ERR_NONE; }
 
-        linebuf* next = node->next;
+    size_t newcap = ref->cap * 2;
+    linebuf** ring = (linebuf**)calloc(newcap, sizeof(linebuf*));
+    if ( ring == NULL ) { return ERR_MEM; }
 
-        if ( node->len == 0 ) {
+    for ( size_t i = 0; i < ref->lines; i++ ) {
+        ring[i] = viewbuf_line(ref, i);
+    }
 
-            if ( node->prev != NULL ) {
-                node->prev->next = node->next;
-            }
+    free(ref->ring);
+    ref->ring = ring;
+    ref->cap = newcap;
+    ref->first = 0;
 
-            if ( node->next != NULL ) {
-                node->next->prev = node->prev;
-            }
+    return ERR_NONE;
 
-            free(node->line);
-            free(node);
+}
 
-        }
+textErr viewbuf_push_front(viewbuf** inst, linebuf* lb) {
+    #define ref (*inst)
 
-        node = next;
+    if ( inst == NULL || ref == NULL || lb == NULL ) { return ERR_NULL; }
 
-    }
+    textErr ret = viewbuf_grow(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ref->first = (ref->first - 1) & (ref->cap - 1);
+    ref->ring[ref->first] = lb;
+    ref->lines += 1;
 
     return ERR_NONE;
 
 }
 
-textErr filebuf_init(filebuf** inst, size_t viewlines) {
+textErr viewbuf_push_back(viewbuf** inst, linebuf* lb) {
     #define ref (*inst)
-    
-    if ( inst == NULL ) { return ERR_NULL; }
-    if ( ref != NULL ) { return ERR_NULL; }
 
-    ref = (filebuf*)calloc(1, sizeof(filebuf));
-    if ( ref == NULL ) { return ERR_MEM; }
+    if ( inst == NULL || ref == NULL || lb == NULL ) { return ERR_NULL; }
 
-    textErr ret = viewbuf_init(&(ref->view), NULL, 0);
+    textErr ret = viewbuf_grow(inst);
     if ( ret != ERR_NONE ) { return ret; }
 
-    ref->viewlines = viewlines;
+    ref->lines += 1;
+    viewbuf_line(ref, ref->lines - 1) = lb;
 
     return ERR_NONE;
 
 }
 
-textErr filebuf_load(filebuf** inst, const char* filedata, const char* fname) {
+textErr viewbuf_pop_front(viewbuf** inst, linebuf** lb) {
     #define ref (*inst)
 
-    if ( inst == NULL ) { return ERR_NULL; }
+    if ( inst == NULL || ref == NULL || lb == NULL ) { return ERR_NULL; }
+    if ( ref->lines == 0 ) { return ERR_EOF; }
 
-    ref->fname = fname;
+    *lb = viewbuf_line(ref, 0);
+    ref->first = (ref->first + 1) & (ref->cap - 1);
+    ref->lines -= 1;
 
-    size_t data_len = strlen(filedata);
-    size_t filesize = data_len + 1; // includes terminating NUL
+    return ERR_NONE;
 
-    if ( ref == NULL || filedata == NULL || filesize == 1 ) { return ERR_NULL; }
+}
 
-    if ( ref->prewindow != NULL || ref->postwindow != NULL || ref->view == NULL ) { return ERR_NULL; }
-    if ( ref->view->head != NULL ) { return ERR_NULL; }
+textErr viewbuf_pop_back(viewbuf** inst, linebuf** lb) {
+    #define ref (*inst)
 
-    ref->prewindow = (char*)calloc(sizeof(char), filesize);
-    if ( ref->prewindow == NULL ) { return ERR_MEM; }
-    
-    ref->postwindow = (char*)calloc(sizeof(char), filesize);
-    if ( ref->postwindow == NULL ) { return ERR_MEM; }
+    if ( inst == NULL || ref == NULL || lb == NULL ) { return ERR_NULL; }
+    if ( ref->lines == 0 ) { return ERR_EOF; }
 
-    ref->prewindow_cap = filesize * sizeof(char);
-    ref->postwindow_cap = filesize * sizeof(char);
+    *lb = viewbuf_line(ref, ref->lines - 1);
+    ref->lines -= 1;
 
-    const char* fileptr = filedata;
+    return ERR_NONE;
 
-    textErr ret;
+}
 
-    // // add lines to window
-    // size_t charcount = 0;
-    // ret = linebuf_parse(&(ref->lines), fileptr, ref->viewlines, &charcount);
-    // if ( ret != ERR_NONE ) { return ret; }
+// insert `lb` so it becomes line `index`, shifting the lines below it down
+textErr viewbuf_insert(viewbuf** inst, size_t index, linebuf* lb) {
+    #define ref (*inst)
 
-    // fileptr += charcount;
-    // size_t usedchars = (uintptr_t)fileptr - (uintptr_t)filedata;
+    if ( inst == NULL || ref == NULL || lb == NULL ) { return ERR_NULL; }
+    if ( index > ref->lines ) { return ERR_EOF; }
 
-    // // Initialize view to parsed lines
-    // ref->view->head = ref->lines;
-    // ref->view->headline = 1;
+    textErr ret = viewbuf_grow(inst);
+    if ( ret != ERR_NONE ) { return ret; }
 
-    // // Count how many lines parsed to set view->lines
-    // size_t parsed_lines = 0;
-    // {
-    //     linebuf* cur = ref->lines;
-    //     while ( cur != NULL ) {
-    //         parsed_lines += 1;
-    //         cur = linebuf_next(cur);
-    //     }
-    // }
-    // ref->view->lines = parsed_lines;
+    ref->lines += 1;
+    for ( size_t i = ref->lines - 1; i > index; i-- ) {
+        viewbuf_line(ref, i) = viewbuf_line(ref, i - 1);
+    }
+    viewbuf_line(ref, index) = lb;
 
-    // // add remaining bytes to postwindow in reverse order
-    // size_t remaining = (usedchars <= data_len) ? (data_len - usedchars) : 0;
-    // if ( remaining > 0 ) {
+    return ERR_NONE;
 
-    //     for (size_t i = 0; i < remaining; i++) {
-    //         ref->postwindow[i] = fileptr[filesize - 1 - i];
-    //     }
+}
 
-    // }
-    // ref->postwindow_len = remaining;
-    
-    for ( size_t i = 0; i < filesize; i++ ) {
-        ref->postwindow[filesize-1-i] = filedata[i];
-    }
-    ref->postwindow_len = filesize;
+textErr viewbuf_remove(viewbuf** inst, size_t index, linebuf** lb) {
+    #define ref (*inst)
 
-    ret = filebuf_resize(inst);
-    if ( ret != ERR_NONE ) {
-        return ret;
+    if ( inst == NULL || ref == NULL || lb == NULL ) { return ERR_NULL; }
+    if ( index >= ref->lines ) { return ERR_EOF; }
+
+    *lb = viewbuf_line(ref, index);
+    for ( size_t i = index; i + 1 < ref->lines; i++ ) {
+        viewbuf_line(ref, i) = viewbuf_line(ref, i + 1);
     }
+    ref->lines -= 1;
 
     return ERR_NONE;
 
 }
 
-textErr filebuf_consume_prewindow_line(filebuf** inst) {
+textErr viewbuf_find(viewbuf** inst, linebuf* lb, size_t* index) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || index == NULL ) { return ERR_NULL; }
+
+    for ( size_t i = 0; i < ref->lines; i++ ) {
+        if ( viewbuf_line(ref, i) == lb ) {
+            *index = i;
+            return ERR_NONE;
+        }
+    }
+
+    return ERR_EOF;
+
+}
+
+textErr viewbuf_remove_empty_lines(viewbuf** inst) {
 
     #define ref (*inst)
     if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref == NULL ) { return ERR_NULL; }
 
-    if ( ref->prewindow_len == 0 ) { return ERR_EOF; }
+    // the last line standing keeps its slot so the view has somewhere to
+    // put text
+    size_t i = 0;
+    while ( i < ref->lines && ref->lines > 1 ) {
 
-    // Find the start of the last complete line in prewindow
-    size_t end = ref->prewindow_len; // exclusive
-    size_t start = 0;
-    for ( size_t i = end; i > 0; i-- ) {
-        if ( ref->prewindow[i-1] == '\n' && (i-1) != (end-1) ) {
-            start = i;
-            break;
+        linebuf* node = viewbuf_line(ref, i);
+        if ( node->len != 0 ) {
+            i += 1;
+            continue;
         }
-    }
 
-    size_t copycount = end - start;
+        // hand the bytes this line stood for in the piece table to a
+        // neighbour; its contents will no longer match them, so they get
+        // replaced when that neighbour leaves the viewport
+        if ( i > 0 ) {
+            viewbuf_line(ref, i - 1)->srclen += node->srclen;
+        } else {
+            viewbuf_line(ref, i + 1)->srclen += node->srclen;
+        }
 
-    linebuf* newhead = NULL;
-    textErr ret = linebuf_init(&newhead, &ref->prewindow[start], copycount);
-    if ( ret != ERR_NONE ) { return ret; }
+        textErr ret = viewbuf_remove(inst, i, &node);
+        if ( ret != ERR_NONE ) { return ret; }
 
-    newhead->prev = NULL;
-    newhead->next = (struct linebuf*)ref->view->head;
-    if ( ref->view->head != NULL ) {
-        ref->view->head->prev = newhead;
-    }
-    ref->view->head = newhead;
+        linebuf_destroy(&node);
 
-    // Shrink prewindow
-    ref->prewindow_len -= copycount;
-    if ( ref->prewindow_len < ref->prewindow_cap ) {
-        ref->prewindow[ref->prewindow_len] = '\0';
     }
 
-    ref->view->lines += 1;
-
     return ERR_NONE;
 
 }
 
-textErr filebuf_consume_postwindow_line(filebuf** inst) {
-
+textErr filebuf_init(filebuf** inst, size_t viewlines) {
     #define ref (*inst)
+    
     if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
 
-    if ( ref->postwindow_len == 0 ) { return ERR_EOF; }
+    ref = (filebuf*)calloc(1, sizeof(filebuf));
+    if ( ref == NULL ) { return ERR_MEM; }
 
-    size_t copycount = 0;
-    for ( size_t i = ref->postwindow_len - 1; i > 0; i-- ) {
-        copycount += 1;
-        if ( ref->postwindow[i] == '\n' ) { break; }
-    }
+    textErr ret = viewbuf_init(&(ref->view), viewlines);
+    if ( ret != ERR_NONE ) { return ret; }
 
-    linebuf* newtail = NULL;
-    textErr ret = linebuf_init(&newtail, NULL, 0);
+    ret = linepool_init(&ref->pool);
     if ( ret != ERR_NONE ) { return ret; }
 
-    if ( ref->view->head == NULL ) {
-        ref->view->head = newtail;
-        newtail->prev = NULL;
-        newtail->next = NULL;
-    } else {
+    ret = undojournal_init(&ref->journal, FILEBUF_UNDO_CAP);
+    if ( ret != ERR_NONE ) { return ret; }
 
-        linebuf* tail = ref->view->head;
-        while (tail && tail->next) {
-            tail = (linebuf*)tail->next;
-        }
+    ref->viewlines = viewlines;
+
+    return ERR_NONE;
 
-        newtail->prev = tail;
-        newtail->next = NULL;
-        tail->next = newtail;
+}
+
+// streamed pieces never cross a chunk, so every fetch fits in one window
+_Static_assert(FILEMAP_WINDOW % PIECE_CHUNK_SIZE == 0, "filemap windows must hold whole piece chunks");
+
+static const char* filebuf_fetch_original(void* ctx, size_t start, size_t len) {
+
+    filebuf* fb = (filebuf*)ctx;
+
+    // on a read error this still points at zeros; the map remembers the
+    // failure for the status line
+    const char* data = NULL;
+    filemap_fetch(&fb->map, start, len, &data);
+
+    return data;
+
+}
 
-        newtail->line = (char*)malloc(copycount+1);
-        newtail->len = copycount;
-        newtail->cap = copycount;
+textErr filebuf_load(filebuf** inst, filemap* map, const char* fname) {
+    #define ref (*inst)
+    TRACE_SCOPE(__func__);
+
+    if ( inst == NULL || map == NULL ) { return ERR_NULL; }
+    if ( ref == NULL ) { return ERR_NULL; }
+
+    if ( ref->text != NULL || ref->map != NULL || ref->view == NULL ) { return ERR_NULL; }
+    if ( ref->view->lines != 0 ) { return ERR_NULL; }
 
+    ref->fname = fname;
+
+    // the filebuf takes ownership of the mapping and uses it as the piece
+    // table's original buffer, so loading copies nothing. streamed files
+    // are read a chunk at a time through the map's window cache instead.
+    ref->map = map;
+
+    textErr ret = ERR_NONE;
+    if ( map->streamed ) {
+        ret = piecetable_init_fetch(&ref->text, map->len, filebuf_fetch_original, ref);
+    } else {
+        ret = piecetable_init(&ref->text, map->data, map->len);
     }
+    if ( ret != ERR_NONE ) { return ret; }
 
-    newtail->line = calloc(copycount, 1);
-    if ( newtail->line == NULL ) {
-        return ERR_MEM;
+    ref->prewindow_len = 0;
+    ref->postwindow_len = map->len;
+
+    // pick a lexer by the file name; plain text gets none
+    const syntax_lang* lang = syntax_for_path(fname);
+    if ( lang != NULL ) {
+        ret = syntaxcache_init(&ref->syntax, lang);
+        if ( ret != ERR_NONE ) { return ret; }
     }
 
-    newtail->len = copycount;
-    newtail->cap = copycount;
-    
-    for ( int i = 0; i < copycount; i++ ) {
-        newtail->line[i] = ref->postwindow[ref->postwindow_len-1-i];
+    // index the original on one worker per core while the first screen is
+    // drawn. a streamed file only gets per-chunk counts so the index stays
+    // small.
+    if ( map->len > 0 && map->streamed ) {
+        ret = lineindex_start_fd(&ref->index, map->fd, map->len, PIECE_CHUNK_SIZE);
+        if ( ret != ERR_NONE ) { return ret; }
+    } else if ( map->len > 0 ) {
+        ret = lineindex_start(&ref->index, map->data, map->len);
+        if ( ret != ERR_NONE ) { return ret; }
     }
-    ref->postwindow_len -= copycount;
 
-    ref->view->lines += 1;
+    ret = filebuf_resize(inst);
+    if ( ret != ERR_NONE ) {
+        return ret;
+    }
 
     return ERR_NONE;
 
 }
 
-textErr filebuf_return_prewindow_line(filebuf** inst) {
-
+textErr filebuf_destroy(filebuf** inst) {
     #define ref (*inst)
-    if ( inst == NULL ) { return ERR_NULL; }
 
-    if ( ref->view->head == NULL ) { return ERR_NONE; }
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
 
-    linebuf* oldhead = ref->view->head;
-    ref->view->head = (linebuf*)oldhead->next;
-    if ( ref->view->head != NULL ) {
-        ((linebuf*)(ref->view->head))->prev = NULL;
-    }
+    // stop the indexer and any grep and let a running save finish before
+    // the mapping they read goes away
+    if ( ref->index != NULL ) { lineindex_destroy(&ref->index); }
+    if ( ref->grep != NULL ) { regexsearch_finish(&ref->grep); }
+    if ( ref->save != NULL ) { filesave_finish(&ref->save); }
 
-    size_t linelen = oldhead->len;
-    memmove(&ref->prewindow[ref->prewindow_len], oldhead->line, linelen);
-    ref->prewindow_len += linelen;
+    // view lines go back to the pool before it is torn down
+    if ( ref->view != NULL ) { viewbuf_destroy(&ref->view); }
 
-    free(oldhead->line);
-    free(oldhead);
+    if ( ref->pool != NULL ) { linepool_destroy(&ref->pool); }
+    if ( ref->journal != NULL ) { undojournal_destroy(&ref->journal); }
+    if ( ref->syntax != NULL ) { syntaxcache_destroy(&ref->syntax); }
+    free(ref->scratch);
+    if ( ref->text != NULL ) { piecetable_destroy(&ref->text); }
+    if ( ref->map != NULL ) { filemap_close(&ref->map); }
 
-    ref->view->lines -= 1;
+    free(ref);
+    ref = NULL;
 
     return ERR_NONE;
 
 }
 
-textErr filebuf_return_postwindow_line(filebuf** inst) {
-    
+// copy `count` bytes at `offset` of the piece table into a fresh linebuf
+static textErr filebuf_read_line(filebuf** inst, size_t offset, size_t count, linebuf** out) {
+
     #define ref (*inst)
-    if ( inst == NULL ) { return ERR_NULL; }
 
-    if ( ref->view->head == NULL ) { return ERR_NONE; }
+    textErr ret = linebuf_alloc(out, ref->pool, NULL, 0);
+    if ( ret != ERR_NONE ) { return ret; }
 
-    linebuf* oldhead = ref->view->head;
-    ref->view->head = (linebuf*)oldhead->next;
-    if ( ref->view->head != NULL ) {
-        ((linebuf*)(ref->view->head))->prev = NULL;
-    }
+    ret = linebuf_reserve(out, count);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = piecetable_read(&ref->text, offset, (*out)->line, count);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    (*out)->line[count] = '\0';
+    (*out)->len = count;
+    (*out)->srclen = count;
+
+    return ERR_NONE;
+
+}
+
+// write a line leaving the viewport back into the piece table at `offset`.
+// unedited lines still match the bytes they were read from and cost nothing.
+static textErr filebuf_writeback_line(filebuf** inst, size_t offset, linebuf* lb) {
+
+    #define ref (*inst)
 
-    size_t linelen = oldhead->len;
-    for (size_t i = 0; i < linelen; i++) {
-        ref->postwindow[i] = oldhead->line[linelen - 1 - i];
+    if ( lb->len == lb->srclen ) {
+        int equal = 0;
+        textErr ret = piecetable_equal(&ref->text, offset, lb->line, lb->len, &equal);
+        if ( ret != ERR_NONE ) { return ret; }
+        if ( equal ) { return ERR_NONE; }
     }
-    // memmove(&ref->postwindow[linelen], &ref->postwindow[0], ref->postwindow_len);
-    // memcpy(&ref->postwindow[0], oldhead->line, linelen);
-    ref->postwindow_len += linelen;
 
-    free(oldhead->line);
-    free(oldhead);
+    textErr ret = piecetable_replace(&ref->text, offset, lb->srclen, lb->line, lb->len);
+    if ( ret != ERR_NONE ) { return ret; }
 
-    ref->view->lines -= 1;
+    lb->srclen = lb->len;
 
     return ERR_NONE;
 
 }
 
-textErr filebuf_resize(filebuf** inst) {
+textErr filebuf_consume_prewindow_line(filebuf** inst) {
 
     #define ref (*inst)
-
+    TRACE_SCOPE(__func__);
     if ( inst == NULL ) { return ERR_NULL; }
-    if ( ref->view == NULL ) { return ERR_NULL; }
-    if ( ref->viewlines == 0 ) { return ERR_NULL; }
 
-    // do nothing if we are already at the correct size
-    if ( ref->viewlines == ref->view->lines ) { return ERR_NONE; }
+    if ( ref->prewindow_len == 0 ) { return ERR_EOF; }
 
-    while ( ref->viewlines > ref->view->lines ) {
-        textErr ret = filebuf_consume_postwindow_line(inst);
-        if ( ret != ERR_NONE ) { return ret; }
+    // Find the start of the last complete line in prewindow, skipping the
+    // newline that terminates it
+    size_t end = ref->prewindow_len; // exclusive
+    size_t start = 0;
+    size_t found = 0;
+    textErr ret = piecetable_find_prev(&ref->text, end - 1, '\n', &found);
+    if ( ret == ERR_NONE ) {
+        start = found + 1;
+    } else if ( ret != ERR_EOF ) {
+        return ret;
     }
 
-    while ( ref->viewlines < ref->view->lines ) {
-        textErr ret = filebuf_return_postwindow_line(inst);
-        if ( ret != ERR_NONE ) { return ret; }
+    size_t copycount = end - start;
+
+    linebuf* newhead = NULL;
+    ret = filebuf_read_line(inst, start, copycount, &newhead);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = viewbuf_push_front(&ref->view, newhead);
+    if ( ret != ERR_NONE ) {
+        linebuf_destroy(&newhead);
+        return ret;
     }
 
+    // Shrink prewindow
+    ref->prewindow_len -= copycount;
+
     return ERR_NONE;
 
 }
 
-textErr filebuf_scroll_down(filebuf** inst) {
+textErr filebuf_consume_postwindow_line(filebuf** inst) {
 
     #define ref (*inst)
+    TRACE_SCOPE(__func__);
     if ( inst == NULL ) { return ERR_NULL; }
-    if ( ref->view->head == NULL ) { return ERR_NULL; }
 
-    textErr ret = filebuf_consume_postwindow_line(inst);
-    if ( ret != ERR_NONE ) { return ret; }
+    if ( ref->postwindow_len == 0 ) { return ERR_EOF; }
 
-    ret = filebuf_return_prewindow_line(inst);
+    size_t start = ref->text->len - ref->postwindow_len;
+    size_t copycount = ref->postwindow_len;
+
+    size_t found = 0;
+    textErr ret = piecetable_find_next(&ref->text, start, '\n', &found);
+    if ( ret == ERR_NONE ) {
+        copycount = found - start + 1;
+    } else if ( ret != ERR_EOF ) {
+        return ret;
+    }
+
+    linebuf* newtail = NULL;
+    ret = filebuf_read_line(inst, start, copycount, &newtail);
     if ( ret != ERR_NONE ) { return ret; }
 
-    ref->view->headline += 1;
+    ret = viewbuf_push_back(&ref->view, newtail);
+    if ( ret != ERR_NONE ) {
+        linebuf_destroy(&newtail);
+        return ret;
+    }
+
+    ref->postwindow_len -= copycount;
 
     return ERR_NONE;
 
 }
 
-textErr filebuf_scroll_up(filebuf** inst) {
+textErr filebuf_return_prewindow_line(filebuf** inst) {
 
     #define ref (*inst)
+    TRACE_SCOPE(__func__);
     if ( inst == NULL ) { return ERR_NULL; }
-    if ( ref->view->head == NULL ) { return ERR_NULL; }
 
-    textErr ret = filebuf_consume_prewindow_line(inst);
+    if ( ref->view->lines == 0 ) { return ERR_NONE; }
+
+    linebuf* oldhead = viewbuf_head(ref->view);
+
+    textErr ret = filebuf_writeback_line(inst, ref->prewindow_len, oldhead);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ref->prewindow_len += oldhead->len;
+
+    viewbuf_pop_front(&ref->view, &oldhead);
+    linebuf_destroy(&oldhead);
+
+    return ERR_NONE;
+
+}
+
+textErr filebuf_return_postwindow_line(filebuf** inst) {
+    
+    #define ref (*inst)
+    TRACE_SCOPE(__func__);
+    if ( inst == NULL ) { return ERR_NULL; }
+
+    if ( ref->view->lines == 0 ) { return ERR_NONE; }
+
+    linebuf* oldtail = viewbuf_tail(ref->view);
+
+    // the tail's bytes end where the postwindow begins
+    size_t offset = ref->text->len - ref->postwindow_len - oldtail->srclen;
+
+    textErr ret = filebuf_writeback_line(inst, offset, oldtail);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ref->postwindow_len += oldtail->len;
+
+    viewbuf_pop_back(&ref->view, &oldtail);
+    linebuf_destroy(&oldtail);
+
+    return ERR_NONE;
+
+}
+
+// make the scratch buffer hold at least `len` bytes
+static textErr filebuf_scratch(filebuf** inst, size_t len) {
+
+    #define ref (*inst)
+
+    if ( len <= ref->scratch_cap ) { return ERR_NONE; }
+
+    size_t newcap = ref->scratch_cap ? ref->scratch_cap : 256;
+    while ( newcap < len ) { newcap *= 2; }
+    char* grown = (char*)realloc(ref->scratch, newcap);
+    if ( grown == NULL ) { return ERR_MEM; }
+    ref->scratch = grown;
+    ref->scratch_cap = newcap;
+
+    return ERR_NONE;
+
+}
+
+// state of a walk for the `want`th newline in one direction. whole pieces
+// are counted in one go; only the one it is in gets searched.
+typedef struct {
+
+    size_t want;
+    size_t seen;
+    size_t found;
+
+} filebuf_newline_ctx;
+
+static int filebuf_visit_newline(void* ctx, const char* data, size_t len, size_t offset) {
+
+    filebuf_newline_ctx* c = (filebuf_newline_ctx*)ctx;
+
+    size_t count = linescan_count(data, len, '\n');
+    if ( c->seen + count < c->want ) {
+        c->seen += count;
+        return 0;
+    }
+
+    const char* p = data;
+    while ( true ) {
+        const char* hit = linescan_find(p, len - (size_t)(p - data), '\n');
+        c->seen += 1;
+        if ( c->seen == c->want ) {
+            c->found = offset + (size_t)(hit - data);
+            return 1;
+        }
+        p = hit + 1;
+    }
+
+}
+
+static int filebuf_visit_newline_back(void* ctx, const char* data, size_t len, size_t offset) {
+
+    filebuf_newline_ctx* c = (filebuf_newline_ctx*)ctx;
+
+    size_t count = linescan_count(data, len, '\n');
+    if ( c->seen + count < c->want ) {
+        c->seen += count;
+        return 0;
+    }
+
+    size_t rest = len;
+    while ( true ) {
+        const char* hit = linescan_rfind(data, rest, '\n');
+        c->seen += 1;
+        if ( c->seen == c->want ) {
+            c->found = offset + (size_t)(hit - data);
+            return 1;
+        }
+        rest = (size_t)(hit - data);
+    }
+
+}
+
+// from the line starting at `offset`, pass up to `n` lines down the piece
+// table without reading them out. `end` is where the line after the last
+// one passed starts, `passed` how many there were.
+static textErr filebuf_skip_down(filebuf** inst, size_t offset, size_t n, size_t* end, size_t* passed) {
+
+    #define ref (*inst)
+
+    *end = offset;
+    *passed = 0;
+    if ( n == 0 || offset >= ref->text->len ) { return ERR_NONE; }
+
+    filebuf_newline_ctx c = { .want = n };
+    textErr ret = piecetable_walk(&ref->text, offset, filebuf_visit_newline, &c);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    if ( c.seen == n ) {
+        *end = c.found + 1;
+        *passed = n;
+        return ERR_NONE;
+    }
+
+    // ran out of text; the last line counts unless the text ends with a newline
+    char last = '\n';
+    ret = piecetable_read(&ref->text, ref->text->len - 1, &last, 1);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    *end = ref->text->len;
+    *passed = c.seen + (last != '\n' ? 1 : 0);
+
+    return ERR_NONE;
+
+}
+
+// from the line starting at `offset`, go up to `n` lines up; `start` is
+// where the last one passed starts
+static textErr filebuf_skip_up(filebuf** inst, size_t offset, size_t n, size_t* start, size_t* passed) {
+
+    #define ref (*inst)
+
+    *start = offset;
+    *passed = 0;
+    if ( n == 0 || offset == 0 ) { return ERR_NONE; }
+
+    // the newline just before `offset` ends the line above, so the search
+    // starts behind it
+    filebuf_newline_ctx c = { .want = n };
+    textErr ret = piecetable_walk_back(&ref->text, offset - 1, filebuf_visit_newline_back, &c);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    if ( c.seen == n ) {
+        *start = c.found + 1;
+        *passed = n;
+    } else {
+        *start = 0;
+        *passed = c.seen + 1;
+    }
+
+    return ERR_NONE;
+
+}
+
+// bring up to `n` lines after the viewport onto its end, read out of the
+// piece table in one block and split at the newlines. `got` is how many
+// there were.
+static textErr filebuf_consume_postwindow_lines(filebuf** inst, size_t n, size_t* got) {
+
+    #define ref (*inst)
+    TRACE_SCOPE(__func__);
+
+    *got = 0;
+    if ( ref->postwindow_len == 0 ) { return ERR_NONE; }
+
+    size_t start = ref->text->len - ref->postwindow_len;
+    size_t end = 0;
+    size_t lines = 0;
+    textErr ret = filebuf_skip_down(inst, start, n, &end, &lines);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    size_t len = end - start;
+    ret = filebuf_scratch(inst, len);
+    if ( ret != ERR_NONE ) { return ret; }
+    ret = piecetable_read(&ref->text, start, ref->scratch, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    const char* p = ref->scratch;
+    size_t rest = len;
+    while ( rest > 0 ) {
+
+        const char* hit = linescan_find(p, rest, '\n');
+        size_t count = hit != NULL ? (size_t)(hit - p) + 1 : rest;
+
+        linebuf* lb = NULL;
+        ret = linebuf_alloc(&lb, ref->pool, p, count);
+        if ( ret == ERR_NONE ) { ret = viewbuf_push_back(&ref->view, lb); }
+        if ( ret != ERR_NONE ) {
+            if ( lb != NULL ) { linebuf_destroy(&lb); }
+            return ret;
+        }
+        lb->srclen = count;
+
+        ref->postwindow_len -= count;
+        *got += 1;
+        p += count;
+        rest -= count;
+
+    }
+
+    return ERR_NONE;
+
+}
+
+// bring up to `n` lines before the viewport onto its front, the same way
+static textErr filebuf_consume_prewindow_lines(filebuf** inst, size_t n, size_t* got) {
+
+    #define ref (*inst)
+    TRACE_SCOPE(__func__);
+
+    *got = 0;
+    if ( ref->prewindow_len == 0 ) { return ERR_NONE; }
+
+    size_t start = 0;
+    size_t lines = 0;
+    textErr ret = filebuf_skip_up(inst, ref->prewindow_len, n, &start, &lines);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    size_t len = ref->prewindow_len - start;
+    ret = filebuf_scratch(inst, len);
+    if ( ret != ERR_NONE ) { return ret; }
+    ret = piecetable_read(&ref->text, start, ref->scratch, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    // split from the end, so each line goes in front of the one after it
+    size_t rest = len;
+    while ( rest > 0 ) {
+
+        const char* hit = rest > 1 ? linescan_rfind(ref->scratch, rest - 1, '\n') : NULL;
+        size_t from = hit != NULL ? (size_t)(hit - ref->scratch) + 1 : 0;
+        size_t count = rest - from;
+
+        linebuf* lb = NULL;
+        ret = linebuf_alloc(&lb, ref->pool, ref->scratch + from, count);
+        if ( ret == ERR_NONE ) { ret = viewbuf_push_front(&ref->view, lb); }
+        if ( ret != ERR_NONE ) {
+            if ( lb != NULL ) { linebuf_destroy(&lb); }
+            return ret;
+        }
+        lb->srclen = count;
+
+        ref->prewindow_len -= count;
+        *got += 1;
+        rest = from;
+
+    }
+
+    return ERR_NONE;
+
+}
+
+textErr filebuf_resize(filebuf** inst) {
+
+    #define ref (*inst)
+    TRACE_SCOPE(__func__);
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref->view == NULL ) { return ERR_NULL; }
+    if ( ref->viewlines == 0 ) { return ERR_NULL; }
+
+    // do nothing if we are already at the correct size
+    if ( ref->viewlines == ref->view->lines ) { return ERR_NONE; }
+
+    // a file shorter than the viewport just leaves the rest empty
+    if ( ref->viewlines > ref->view->lines ) {
+        size_t got = 0;
+        textErr ret = filebuf_consume_postwindow_lines(inst, ref->viewlines - ref->view->lines, &got);
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    while ( ref->viewlines < ref->view->lines ) {
+        textErr ret = filebuf_return_postwindow_line(inst);
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    return ERR_NONE;
+
+}
+
+// edits at the end of the document can leave the viewport with no lines
+// while there is text above it; show the last line again so there is
+// something to scroll from. it is read back in from above the viewport,
+// so the line number follows without counting. ERR_EOF if the document
+// is empty.
+static textErr filebuf_refill_view(filebuf** inst) {
+
+    #define ref (*inst)
+
+    if ( ref->view->lines > 0 ) { return ERR_NONE; }
+    if ( ref->text->len == 0 ) { return ERR_EOF; }
+
+    textErr ret = filebuf_resize(inst);
+    if ( ret != ERR_NONE || ref->view->lines > 0 ) { return ret; }
+
+    size_t got = 0;
+    ret = filebuf_consume_prewindow_lines(inst, 1, &got);
+    ref->view->headline -= got;
+
+    return ret;
+
+}
+
+textErr filebuf_scroll_down(filebuf** inst) {
+
+    #define ref (*inst)
+    if ( inst == NULL ) { return ERR_NULL; }
+
+    textErr ret = filebuf_refill_view(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = filebuf_consume_postwindow_line(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = filebuf_return_prewindow_line(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ref->view->headline += 1;
+
+    return ERR_NONE;
+
+}
+
+textErr filebuf_scroll_up(filebuf** inst) {
+
+    #define ref (*inst)
+    if ( inst == NULL ) { return ERR_NULL; }
+
+    textErr ret = filebuf_refill_view(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = filebuf_consume_prewindow_line(inst);
     if ( ret != ERR_NONE ) { return ret; }
 
     ret = filebuf_return_postwindow_line(inst);
@@ -466,3 +1025,932 @@ textErr filebuf_scroll_up(filebuf** inst) {
     return ERR_NONE;
 
 }
+
+static size_t filebuf_index_count(void* ctx, size_t start, size_t len) {
+
+    filebuf* fb = (filebuf*)ctx;
+
+    size_t count = 0;
+    if ( lineindex_count_range(&fb->index, start, len, &count) == ERR_NONE ) { return count; }
+
+    // a counts-only index can't answer for part of a chunk; the piece is at
+    // most one chunk long, so scanning it is cheap
+    const char* data = NULL;
+    filemap_fetch(&fb->map, start, len, &data);
+
+    return data != NULL ? linescan_count(data, len, '\n') : 0;
+
+}
+
+// once the background index is done, hand its counts to the piece table so
+// line queries never have to scan the original on this thread
+static void filebuf_poll_index(filebuf** inst) {
+
+    #define ref (*inst)
+
+    if ( ref->index == NULL || piecetable_lines_known(&ref->text) ) { return; }
+    if ( !lineindex_ready(&ref->index) ) { return; }
+
+    piecetable_fill_counts(&ref->text, filebuf_index_count, ref);
+
+}
+
+// write every visible line back so the piece table holds the whole document
+static textErr filebuf_flush_view(filebuf** inst) {
+
+    #define ref (*inst)
+
+    while ( ref->view->lines > 0 ) {
+        textErr ret = filebuf_return_postwindow_line(inst);
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    return ERR_NONE;
+
+}
+
+// rebuild an empty viewport starting at `start`, which must be the first
+// byte of line number `headline`
+static textErr filebuf_place_view(filebuf** inst, size_t start, size_t headline) {
+
+    #define ref (*inst)
+
+    ref->prewindow_len = start;
+    ref->postwindow_len = ref->text->len - start;
+    ref->view->headline = headline;
+
+    return filebuf_resize(inst);
+
+}
+
+// scroll by `n` lines, down if positive and up if negative, stopping at
+// either end the way filebuf_scroll_down/filebuf_scroll_up do; `moved` is
+// how far it got. a move within the viewport reads the new lines in at one
+// end in one block; a longer one writes the whole view back, finds the new
+// top line by counting newlines and reads the viewport in once there.
+textErr filebuf_scroll_by(filebuf** inst, long n, size_t* moved) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    size_t want = n < 0 ? (size_t)0 - (size_t)n : (size_t)n;
+    size_t done = 0;
+    if ( moved != NULL ) { *moved = 0; }
+    if ( want == 0 ) { return ERR_NONE; }
+
+    textErr ret = filebuf_refill_view(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    size_t lines = ref->view->lines;
+
+    if ( want < lines && n > 0 ) {
+
+        ret = filebuf_consume_postwindow_lines(inst, want, &done);
+        for ( size_t i = 0; i < done && ret == ERR_NONE; i++ ) {
+            ret = filebuf_return_prewindow_line(inst);
+        }
+        ref->view->headline += done;
+
+    } else if ( want < lines ) {
+
+        ret = filebuf_consume_prewindow_lines(inst, want, &done);
+        for ( size_t i = 0; i < done && ret == ERR_NONE; i++ ) {
+            ret = filebuf_return_postwindow_line(inst);
+        }
+        ref->view->headline -= done;
+
+    } else {
+
+        // a line edited down to nothing is gone once written back
+        size_t kept = 0;
+        for ( size_t i = 0; i < lines; i++ ) {
+            if ( viewbuf_line(ref->view, i)->len > 0 ) { kept += 1; }
+        }
+
+        ret = filebuf_flush_view(inst);
+        if ( ret != ERR_NONE ) { return ret; }
+
+        size_t start = ref->prewindow_len;
+        if ( n > 0 ) {
+            // only as far as keeps the viewport full
+            size_t end = 0;
+            size_t passed = 0;
+            ret = filebuf_skip_down(inst, start, want + kept, &end, &passed);
+            if ( ret != ERR_NONE ) { return ret; }
+            done = passed > kept ? passed - kept : 0;
+            ret = filebuf_skip_down(inst, start, done, &start, &passed);
+            ref->view->headline += done;
+        } else {
+            ret = filebuf_skip_up(inst, start, want, &start, &done);
+            ref->view->headline -= done;
+        }
+        if ( ret != ERR_NONE ) { return ret; }
+
+        ret = filebuf_place_view(inst, start, ref->view->headline);
+        if ( ret == ERR_NONE ) { ret = filebuf_refill_view(inst); }
+
+    }
+
+    if ( moved != NULL ) { *moved = done; }
+    if ( ret != ERR_NONE ) { return ret; }
+
+    return done < want ? ERR_EOF : ERR_NONE;
+
+}
+
+// the view's top line needs a line number, which means counting every
+// newline before it until the background index is in. rather than do that
+// on the caller's thread, the goto functions return ERR_BUSY until then,
+// except for the first line.
+textErr filebuf_goto_offset(filebuf** inst, size_t offset) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->text == NULL || ref->view == NULL ) { return ERR_NULL; }
+
+    filebuf_poll_index(inst);
+    if ( offset > 0 && !piecetable_lines_known(&ref->text) ) { return ERR_BUSY; }
+
+    // write the viewport back first so offsets refer to the current text
+    textErr ret = filebuf_flush_view(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    size_t len = ref->text->len;
+    if ( len > 0 && offset >= len ) { offset = len - 1; }
+
+    size_t start = 0;
+    size_t found = 0;
+    ret = piecetable_find_prev(&ref->text, offset, '\n', &found);
+    if ( ret == ERR_NONE ) {
+        start = found + 1;
+    } else if ( ret != ERR_EOF ) {
+        return ret;
+    }
+
+    size_t line = 0;
+    if ( start > 0 ) {
+        ret = piecetable_line_of(&ref->text, start, &line);
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    return filebuf_place_view(inst, start, line + 1);
+
+}
+
+textErr filebuf_goto_line(filebuf** inst, size_t line) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->text == NULL || ref->view == NULL ) { return ERR_NULL; }
+
+    // lines are numbered from 1 like the gutter
+    if ( line == 0 ) { line = 1; }
+
+    filebuf_poll_index(inst);
+    if ( line > 1 && !piecetable_lines_known(&ref->text) ) { return ERR_BUSY; }
+
+    textErr ret = filebuf_flush_view(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    size_t start = 0;
+    ret = piecetable_line_start(&ref->text, line - 1, &start);
+    if ( ret == ERR_EOF ) {
+        // past the end: show the last line instead
+        return filebuf_goto_offset(inst, ref->text->len);
+    }
+    if ( ret != ERR_NONE ) { return ret; }
+
+    if ( start == ref->text->len && start > 0 ) {
+        return filebuf_goto_offset(inst, start);
+    }
+
+    return filebuf_place_view(inst, start, line);
+
+}
+
+textErr filebuf_goto_percent(filebuf** inst, size_t percent) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->text == NULL ) { return ERR_NULL; }
+
+    if ( percent > 100 ) { percent = 100; }
+
+    size_t len = ref->text->len;
+    size_t offset = (len / 100) * percent + ((len % 100) * percent) / 100;
+
+    return filebuf_goto_offset(inst, offset);
+
+}
+
+// total number of lines, counting edits still held in the viewport. returns
+// ERR_BUSY while the background index is still being built.
+textErr filebuf_line_count(filebuf** inst, size_t* lines) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || lines == NULL ) { return ERR_NULL; }
+    if ( ref->text == NULL || ref->view == NULL ) { return ERR_NULL; }
+
+    filebuf_poll_index(inst);
+    if ( !piecetable_lines_known(&ref->text) ) { return ERR_BUSY; }
+
+    // the piece table still holds the viewport's original text; swap its
+    // newlines for the ones in the (possibly edited) linebufs
+    size_t view_start = ref->prewindow_len;
+    size_t view_end = ref->text->len - ref->postwindow_len;
+
+    size_t total = 0;
+    size_t before_view = 0;
+    size_t before_post = 0;
+    textErr ret = piecetable_count_lines(&ref->text, &total);
+    if ( ret != ERR_NONE ) { return ret; }
+    ret = piecetable_line_of(&ref->text, view_start, &before_view);
+    if ( ret != ERR_NONE ) { return ret; }
+    ret = piecetable_line_of(&ref->text, view_end, &before_post);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    size_t newlines = total - (before_post - before_view);
+    char last = '\n';
+    for ( size_t i = 0; i < ref->view->lines; i++ ) {
+        linebuf* cur = viewbuf_line(ref->view, i);
+        newlines += linescan_count(cur->line, cur->len, '\n');
+        if ( cur->len > 0 ) { last = cur->line[cur->len - 1]; }
+    }
+
+    if ( ref->postwindow_len > 0 ) {
+        ret = piecetable_read(&ref->text, ref->text->len - 1, &last, 1);
+        if ( ret != ERR_NONE ) { return ret; }
+    } else if ( ref->view->lines == 0 && ref->text->len > 0 ) {
+        ret = piecetable_read(&ref->text, ref->text->len - 1, &last, 1);
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    // a trailing newline ends the last line rather than starting a new one
+    *lines = newlines + (last != '\n' ? 1 : 0);
+
+    return ERR_NONE;
+
+}
+
+// document offset of the first byte of view line `line`
+static size_t filebuf_view_offset(filebuf** inst, size_t line) {
+
+    #define ref (*inst)
+
+    size_t offset = ref->prewindow_len;
+    for ( size_t i = 0; i < line && i < ref->view->lines; i++ ) {
+        offset += viewbuf_line(ref->view, i)->len;
+    }
+
+    return offset;
+
+}
+
+// tell the syntax cache that view line `line` changed, taking the `removed`
+// lines after it along and gaining `added` new ones
+static void filebuf_syntax_edit(filebuf** inst, size_t line, size_t removed, size_t added) {
+
+    #define ref (*inst)
+
+    if ( ref->syntax == NULL ) { return; }
+    syntaxcache_edit(&ref->syntax, ref->view->headline - 1 + line, removed, added);
+
+}
+
+// insert `len` bytes at byte `pos` of view line `line`. line breaks in `src`
+// split the line, and the new lines join the view after it.
+textErr filebuf_insert(filebuf** inst, size_t line, size_t pos, const char* src, size_t len) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || src == NULL ) { return ERR_NULL; }
+    if ( line >= ref->view->lines ) { return ERR_EOF; }
+
+    linebuf* lb = viewbuf_line(ref->view, line);
+    if ( pos > lb->len ) { return ERR_EOF; }
+    if ( len == 0 ) { return ERR_NONE; }
+
+    size_t offset = filebuf_view_offset(inst, line) + pos;
+
+    const char* nl = linescan_find(src, len, '\n');
+    textErr ret = ERR_NONE;
+
+    if ( nl == NULL ) {
+
+        ret = linebuf_insert(&lb, pos, src, len);
+
+    } else {
+
+        // the rest of the line ends up after the last inserted line break
+        size_t taillen = lb->len - pos;
+        linebuf* last = NULL;
+        ret = linebuf_alloc(&last, ref->pool, &lb->line[pos], taillen);
+        if ( ret != ERR_NONE ) { return ret; }
+
+        if ( taillen > 0 ) { ret = linebuf_erase(&lb, pos, taillen); }
+        if ( ret == ERR_NONE ) { ret = linebuf_insert(&lb, pos, src, (size_t)(nl - src) + 1); }
+
+        const char* cur = nl + 1;
+        const char* end = src + len;
+        size_t index = line + 1;
+
+        while ( ret == ERR_NONE ) {
+            nl = linescan_find(cur, (size_t)(end - cur), '\n');
+            if ( nl == NULL ) { break; }
+
+            linebuf* mid = NULL;
+            ret = linebuf_alloc(&mid, ref->pool, cur, (size_t)(nl - cur) + 1);
+            if ( ret != ERR_NONE ) { break; }
+
+            ret = viewbuf_insert(&ref->view, index++, mid);
+            if ( ret != ERR_NONE ) { linebuf_destroy(&mid); }
+
+            cur = nl + 1;
+        }
+
+        if ( ret == ERR_NONE ) { ret = linebuf_insert(&last, 0, cur, (size_t)(end - cur)); }
+        if ( ret == ERR_NONE ) { ret = viewbuf_insert(&ref->view, index, last); }
+        if ( ret != ERR_NONE ) {
+            linebuf_destroy(&last);
+            return ret;
+        }
+
+    }
+
+    if ( ret != ERR_NONE ) { return ret; }
+
+    filebuf_syntax_edit(inst, line, 0, linescan_count(src, len, '\n'));
+
+    return undojournal_record(&ref->journal, offset, NULL, 0, src, len);
+
+}
+
+// remove `len` bytes at byte `pos` of view line `line`, stopping at the end
+// of the line. removing its line break joins the next line onto it.
+textErr filebuf_erase(filebuf** inst, size_t line, size_t pos, size_t len) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( line >= ref->view->lines ) { return ERR_EOF; }
+
+    linebuf* lb = viewbuf_line(ref->view, line);
+    if ( pos >= lb->len ) { return ERR_EOF; }
+    if ( len > lb->len - pos ) { len = lb->len - pos; }
+
+    size_t offset = filebuf_view_offset(inst, line) + pos;
+    bool joins = lb->line[lb->len - 1] == '\n' && pos + len == lb->len;
+
+    // the journal needs the bytes before they are gone
+    textErr ret = undojournal_record(&ref->journal, offset, &lb->line[pos], len, NULL, 0);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = linebuf_erase(&lb, pos, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    filebuf_syntax_edit(inst, line, 0, 0);
+
+    if ( !joins ) { return ERR_NONE; }
+
+    // bring the next line into the view if it isn't yet
+    if ( line + 1 >= ref->view->lines ) {
+        ret = filebuf_consume_postwindow_line(inst);
+        if ( ret == ERR_EOF ) { return ERR_NONE; }
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    linebuf* next = NULL;
+    ret = viewbuf_remove(&ref->view, line + 1, &next);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = linebuf_insert(&lb, lb->len, next->line, next->len);
+    if ( ret != ERR_NONE ) {
+        viewbuf_insert(&ref->view, line + 1, next);
+        return ret;
+    }
+
+    // the joined line now stands for the bytes of both
+    lb->srclen += next->srclen;
+    linebuf_destroy(&next);
+
+    filebuf_syntax_edit(inst, line, 1, 0);
+
+    return ERR_NONE;
+
+}
+
+// drop the viewport without writing it back; only safe right after
+// filebuf_sync, when the piece table already matches it
+static void filebuf_drop_view(filebuf** inst) {
+
+    #define ref (*inst)
+
+    linebuf* lb = NULL;
+    while ( viewbuf_pop_back(&ref->view, &lb) == ERR_NONE ) {
+        linebuf_destroy(&lb);
+    }
+
+    ref->postwindow_len = ref->text->len - ref->prewindow_len;
+
+}
+
+// replace the `dellen` bytes `del` at `offset` with `src` directly in the
+// piece table and reload the viewport, moving it if the change isn't in it
+static textErr filebuf_apply(filebuf** inst, size_t offset, const char* del, size_t dellen, const char* src, size_t len) {
+
+    #define ref (*inst)
+
+    textErr ret = filebuf_sync(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    if ( ref->syntax != NULL ) {
+        size_t line = 0;
+        size_t pos = 0;
+        size_t removed = linescan_count(del, dellen, '\n');
+        size_t added = linescan_count(src, len, '\n');
+        if ( filebuf_locate(inst, offset, &line, &pos) == ERR_NONE ) {
+            filebuf_syntax_edit(inst, line, removed, added);
+        } else {
+            // outside the view the line is only known once the index is in
+            filebuf_poll_index(inst);
+            if ( piecetable_lines_known(&ref->text) && piecetable_line_of(&ref->text, offset, &line) == ERR_NONE ) {
+                syntaxcache_edit(&ref->syntax, line, removed, added);
+            } else {
+                syntaxcache_reset(&ref->syntax, 0);
+            }
+        }
+    }
+
+    size_t start = ref->prewindow_len;
+    size_t end = ref->text->len - ref->postwindow_len;
+    size_t headline = ref->view->headline;
+
+    filebuf_drop_view(inst);
+
+    ret = piecetable_replace(&ref->text, offset, dellen, src, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    if ( offset >= start && offset <= end ) {
+        return filebuf_place_view(inst, start, headline);
+    }
+
+    ret = filebuf_goto_offset(inst, offset);
+    if ( ret != ERR_BUSY ) { return ret; }
+
+    // until lines are counted, leave the view on the lines it showed. if the
+    // change took its top line, show the line the change starts on, counting
+    // back through the deleted text for its number.
+    if ( offset > end ) { return filebuf_place_view(inst, start, headline); }
+    if ( offset + dellen <= start ) {
+        return filebuf_place_view(inst, start + len - dellen,
+                                  headline + linescan_count(src, len, '\n') - linescan_count(del, dellen, '\n'));
+    }
+
+    size_t top = 0;
+    if ( offset > 0 ) {
+        ret = piecetable_find_prev(&ref->text, offset - 1, '\n', &top);
+        if ( ret == ERR_NONE ) {
+            top += 1;
+        } else if ( ret == ERR_EOF ) {
+            top = 0;
+        } else {
+            return ret;
+        }
+    }
+
+    return filebuf_place_view(inst, top, headline - linescan_count(del, start - offset, '\n'));
+
+}
+
+// insert `len` bytes at byte `pos` of view line `line` in one go, for
+// blocks too big to go through the view a line at a time: the view is
+// written back, the text goes into the piece table as a single piece and
+// only the lines the viewport shows are read back out of it. `end` is the
+// document offset just past the inserted text.
+textErr filebuf_insert_bulk(filebuf** inst, size_t line, size_t pos, const char* src, size_t len, size_t* end) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || src == NULL || end == NULL ) { return ERR_NULL; }
+    if ( line >= ref->view->lines ) { return ERR_EOF; }
+    if ( pos > viewbuf_line(ref->view, line)->len ) { return ERR_EOF; }
+
+    size_t offset = filebuf_view_offset(inst, line) + pos;
+    *end = offset;
+    if ( len == 0 ) { return ERR_NONE; }
+
+    textErr ret = filebuf_apply(inst, offset, NULL, 0, src, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    *end = offset + len;
+
+    return undojournal_record(&ref->journal, offset, NULL, 0, src, len);
+
+}
+
+// revert the last edit. `offset` is where it happened, for the cursor.
+textErr filebuf_undo(filebuf** inst, size_t* offset) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || offset == NULL ) { return ERR_NULL; }
+
+    const undojournal_rec* rec = NULL;
+    textErr ret = undojournal_undo(&ref->journal, &rec);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = filebuf_apply(inst, rec->offset, undojournal_inserted(rec), rec->inslen, undojournal_deleted(rec), rec->dellen);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    *offset = rec->offset + rec->dellen;
+
+    return ERR_NONE;
+
+}
+
+// apply the last undone edit again
+textErr filebuf_redo(filebuf** inst, size_t* offset) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || offset == NULL ) { return ERR_NULL; }
+
+    const undojournal_rec* rec = NULL;
+    textErr ret = undojournal_redo(&ref->journal, &rec);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = filebuf_apply(inst, rec->offset, undojournal_deleted(rec), rec->dellen, undojournal_inserted(rec), rec->inslen);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    *offset = rec->offset + rec->inslen;
+
+    return ERR_NONE;
+
+}
+
+// find the view line holding document `offset` and the byte within it
+textErr filebuf_locate(filebuf** inst, size_t offset, size_t* line, size_t* pos) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || line == NULL || pos == NULL ) { return ERR_NULL; }
+    if ( offset < ref->prewindow_len ) { return ERR_EOF; }
+
+    size_t start = ref->prewindow_len;
+    for ( size_t i = 0; i < ref->view->lines; i++ ) {
+        linebuf* cur = viewbuf_line(ref->view, i);
+        // the end of the document counts as the end of the last line
+        bool end = i + 1 == ref->view->lines && ref->postwindow_len == 0 && offset == start + cur->len;
+        if ( offset < start + cur->len || end ) {
+            *line = i;
+            *pos = offset - start;
+            return ERR_NONE;
+        }
+        start += cur->len;
+    }
+
+    return ERR_EOF;
+
+}
+
+// document offset of byte `pos` of view line `line`
+textErr filebuf_offset(filebuf** inst, size_t line, size_t pos, size_t* offset) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || offset == NULL ) { return ERR_NULL; }
+    if ( line >= ref->view->lines ) { return ERR_EOF; }
+
+    *offset = filebuf_view_offset(inst, line) + pos;
+
+    return ERR_NONE;
+
+}
+
+// a stretch of the piece table being searched: bytes at piece table offset
+// `ptbase` are at document offset `docbase`, and the scan stays in [lo, hi)
+typedef struct {
+
+    textsearch* search;
+    size_t ptbase;
+    size_t docbase;
+    size_t lo;
+    size_t hi;
+
+} filebuf_search_ctx;
+
+static int filebuf_visit_search(void* ctx, const char* data, size_t len, size_t offset) {
+
+    filebuf_search_ctx* c = (filebuf_search_ctx*)ctx;
+
+    if ( offset < c->lo ) {
+        if ( offset + len <= c->lo ) { return 1; }
+        data += c->lo - offset;
+        len -= c->lo - offset;
+        offset = c->lo;
+    }
+    if ( offset >= c->hi ) { return 1; }
+    if ( offset + len > c->hi ) { len = c->hi - offset; }
+
+    if ( textsearch_feed(c->search, data, len, c->docbase + (offset - c->ptbase)) ) { return 1; }
+
+    // stop at whichever end of the stretch the walk is heading for
+    return c->search->backward ? offset == c->lo : offset + len == c->hi;
+
+}
+
+// run `search` if its pattern or position changed. the document is scanned
+// where it lives: the piece table before the viewport, the viewport lines,
+// then the piece table after it, in reverse order for a backward search.
+textErr filebuf_search(filebuf** inst, textsearch** search) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || search == NULL || *search == NULL ) { return ERR_NULL; }
+
+    textsearch* s = *search;
+    if ( !s->stale || s->len == 0 ) { return ERR_NONE; }
+
+    size_t pre = ref->prewindow_len;
+    size_t viewend = filebuf_view_offset(inst, ref->view->lines);
+    size_t postpt = ref->text->len - ref->postwindow_len;
+    size_t doclen = viewend + ref->postwindow_len;
+
+    filebuf_search_ctx before = { s, 0, 0, 0, pre };
+    filebuf_search_ctx after = { s, postpt, viewend, postpt, ref->text->len };
+
+    textsearch_scan_start(s);
+
+    if ( !s->backward ) {
+
+        size_t from = s->from;
+
+        if ( from < pre ) {
+            piecetable_walk(&ref->text, from, filebuf_visit_search, &before);
+        }
+
+        size_t offset = pre;
+        for ( size_t i = 0; i < ref->view->lines && !s->found; i++ ) {
+            linebuf* cur = viewbuf_line(ref->view, i);
+            if ( offset + cur->len > from ) {
+                size_t skip = (from > offset) ? from - offset : 0;
+                textsearch_feed(s, &cur->line[skip], cur->len - skip, offset + skip);
+            }
+            offset += cur->len;
+        }
+
+        if ( !s->found && from < doclen && ref->postwindow_len > 0 ) {
+            size_t skip = (from > viewend) ? from - viewend : 0;
+            piecetable_walk(&ref->text, postpt + skip, filebuf_visit_search, &after);
+        }
+
+    } else {
+
+        // matches start before `from` but may run past it
+        size_t end = doclen;
+        if ( s->from < doclen && doclen - s->from > s->len - 1 ) { end = s->from + s->len - 1; }
+
+        if ( end > viewend ) {
+            piecetable_walk_back(&ref->text, postpt + (end - viewend), filebuf_visit_search, &after);
+        }
+
+        size_t offset = viewend;
+        for ( size_t i = ref->view->lines; i > 0 && !s->found; i-- ) {
+            linebuf* cur = viewbuf_line(ref->view, i - 1);
+            offset -= cur->len;
+            if ( offset >= end ) { continue; }
+            size_t take = (end - offset < cur->len) ? end - offset : cur->len;
+            textsearch_feed(s, cur->line, take, offset);
+        }
+
+        if ( !s->found && pre > 0 ) {
+            piecetable_walk_back(&ref->text, (end < pre) ? end : pre, filebuf_visit_search, &before);
+        }
+
+    }
+
+    textsearch_scan_end(s);
+
+    return ERR_NONE;
+
+}
+
+// lex line `line` of the piece table, `len` bytes at `offset`, into the
+// syntax cache
+static textErr filebuf_syntax_lex_stored(filebuf** inst, size_t line, size_t offset, size_t len) {
+
+    #define ref (*inst)
+
+    textErr ret = filebuf_scratch(inst, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = piecetable_read(&ref->text, offset, ref->scratch, len);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    syntaxcache* c = ref->syntax;
+    return syntaxcache_store(&ref->syntax, c->lang->lex(syntaxcache_entry(c, line), ref->scratch, len, NULL));
+
+}
+
+// lex whatever lines before document line `line` the syntax cache doesn't
+// have current states for. lines above the viewport come out of the piece
+// table, the rest from the view. a jump further than SYNTAX_CATCHUP lines
+// past what is cached starts over a little above `line` instead.
+static textErr filebuf_syntax_reach(filebuf** inst, size_t line) {
+
+    #define ref (*inst)
+
+    syntaxcache* c = ref->syntax;
+    size_t top = ref->view->headline - 1;
+
+    if ( line < c->base || line > c->base + c->valid + SYNTAX_CATCHUP ) {
+        size_t back = line < SYNTAX_LOOKBACK ? line : SYNTAX_LOOKBACK;
+        syntaxcache_reset(&ref->syntax, line - back);
+    }
+
+    while ( c->base + c->valid < line && c->base + c->valid < top ) {
+
+        // find where the next line starts: straight from the line counts if
+        // they are in, otherwise by stepping back from the top of the view
+        size_t next = c->base + c->valid;
+        size_t offset = ref->prewindow_len;
+        filebuf_poll_index(inst);
+        bool counted = piecetable_lines_known(&ref->text) && piecetable_line_start(&ref->text, next, &offset) == ERR_NONE;
+        if ( !counted ) { offset = ref->prewindow_len; }
+        for ( size_t k = top; !counted && k > next; k-- ) {
+            size_t found = 0;
+            textErr ret = piecetable_find_prev(&ref->text, offset - 1, '\n', &found);
+            if ( ret == ERR_EOF ) {
+                offset = 0;
+                break;
+            }
+            if ( ret != ERR_NONE ) { return ret; }
+            offset = found + 1;
+        }
+
+        // lex forward until the view, or until the states fall back in step
+        // with the ones from before an edit and jump ahead
+        while ( next < line && next < top && c->base + c->valid == next ) {
+            size_t found = 0;
+            textErr ret = piecetable_find_next(&ref->text, offset, '\n', &found);
+            if ( ret != ERR_NONE ) { return ret; }
+            ret = filebuf_syntax_lex_stored(inst, next, offset, found + 1 - offset);
+            if ( ret != ERR_NONE ) { return ret; }
+            offset = found + 1;
+            next += 1;
+        }
+
+    }
+
+    while ( c->base + c->valid < line ) {
+        size_t next = c->base + c->valid;
+        if ( next - top >= ref->view->lines ) { return ERR_EOF; }
+        linebuf* lb = viewbuf_line(ref->view, next - top);
+        textErr ret = syntaxcache_store(&ref->syntax, c->lang->lex(syntaxcache_entry(c, next), lb->line, lb->len, NULL));
+        if ( ret != ERR_NONE ) { return ret; }
+    }
+
+    return ERR_NONE;
+
+}
+
+// lexer state view line `line` starts in. two lines with the same text and
+// the same state color the same, which is what a renderer needs to know.
+textErr filebuf_syntax_state(filebuf** inst, size_t line, uint32_t* state) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || state == NULL ) { return ERR_NULL; }
+    if ( ref->syntax == NULL ) { return ERR_NULL; }
+    if ( line >= ref->view->lines ) { return ERR_EOF; }
+
+    size_t docline = ref->view->headline - 1 + line;
+    textErr ret = filebuf_syntax_reach(inst, docline);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    *state = syntaxcache_entry(ref->syntax, docline);
+
+    return ERR_NONE;
+
+}
+
+// color bytes [from, to) of view line `line`: one syntax_class per byte
+// into `classes`, which must hold to - from bytes. the rest of the line is
+// only lexed for its state, which is much cheaper on long lines.
+textErr filebuf_highlight(filebuf** inst, size_t line, size_t from, size_t to, uint8_t* classes) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || classes == NULL ) { return ERR_NULL; }
+    if ( ref->syntax == NULL ) { return ERR_NULL; }
+    if ( line >= ref->view->lines ) { return ERR_EOF; }
+    if ( from > to || to > viewbuf_line(ref->view, line)->len ) { return ERR_EOF; }
+
+    size_t docline = ref->view->headline - 1 + line;
+    textErr ret = filebuf_syntax_reach(inst, docline);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    syntaxcache* c = ref->syntax;
+    linebuf* lb = viewbuf_line(ref->view, line);
+    syntax_span out = { classes, from, to };
+    uint32_t end = c->lang->lex(syntaxcache_entry(c, docline), lb->line, lb->len, &out);
+
+    // the line after may be the next one without a state yet
+    if ( c->base + c->valid == docline ) { return syntaxcache_store(&ref->syntax, end); }
+
+    return ERR_NONE;
+
+}
+
+// write edited viewport lines back into the piece table without leaving the
+// viewport, so the piece table holds the whole document
+textErr filebuf_sync(filebuf** inst) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->text == NULL || ref->view == NULL ) { return ERR_NULL; }
+
+    size_t offset = ref->prewindow_len;
+    for ( size_t i = 0; i < ref->view->lines; i++ ) {
+        linebuf* cur = viewbuf_line(ref->view, i);
+        textErr ret = filebuf_writeback_line(inst, offset, cur);
+        if ( ret != ERR_NONE ) { return ret; }
+        offset += cur->len;
+    }
+
+    return ERR_NONE;
+
+}
+
+// save the document to `path` on a background thread. returns ERR_BUSY if
+// a save is still running; filebuf_save_poll reports how it went.
+textErr filebuf_save(filebuf** inst, const char* path) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || path == NULL ) { return ERR_NULL; }
+    if ( ref->text == NULL || ref->map == NULL ) { return ERR_NULL; }
+    if ( ref->save != NULL ) { return ERR_BUSY; }
+
+    textErr ret = filebuf_sync(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    return filesave_start(&ref->save, &ref->text, ref->map, path);
+
+}
+
+// ERR_BUSY while a save runs, with `written` of `total` bytes done so far.
+// once it has finished its result is returned, a single time; after that,
+// or if nothing was saved, ERR_EOF.
+textErr filebuf_save_poll(filebuf** inst, size_t* written, size_t* total) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->save == NULL ) { return ERR_EOF; }
+
+    if ( written != NULL ) { *written = atomic_load_explicit(&ref->save->written, memory_order_relaxed); }
+    if ( total != NULL ) { *total = ref->save->len; }
+
+    if ( !filesave_done(&ref->save) ) { return ERR_BUSY; }
+
+    return filesave_finish(&ref->save);
+
+}
+
+// grep the document for `pattern` on background threads, replacing any
+// earlier grep. ERR_PATTERN if the pattern doesn't compile.
+textErr filebuf_grep(filebuf** inst, const char* pattern, size_t from) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL || pattern == NULL ) { return ERR_NULL; }
+    if ( ref->text == NULL || ref->map == NULL ) { return ERR_NULL; }
+
+    if ( ref->grep != NULL ) { regexsearch_finish(&ref->grep); }
+
+    textErr ret = filebuf_sync(inst);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    return regexsearch_start(&ref->grep, &ref->text, ref->map, pattern, from);
+
+}
+
+// the grep match after `offset`, or before it when `backward`. ERR_BUSY
+// until the chunks that decide it are scanned.
+textErr filebuf_grep_next(filebuf** inst, size_t offset, bool backward, regexsearch_match* match) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->grep == NULL ) { return ERR_EOF; }
+
+    return regexsearch_next(&ref->grep, offset, backward, match);
+
+}
+
+textErr filebuf_grep_progress(filebuf** inst, size_t* done, size_t* chunks, size_t* matches) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->grep == NULL ) { return ERR_EOF; }
+
+    return regexsearch_progress(&ref->grep, done, chunks, matches);
+
+}
+
+textErr filebuf_grep_stop(filebuf** inst) {
+
+    #define ref (*inst)
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->grep == NULL ) { return ERR_EOF; }
+
+    return regexsearch_finish(&ref->grep);
+
+}
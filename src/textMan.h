@@ -4,65 +4,152 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include "textErr.h"
+#include "fileMap.h"
+#include "pieceTable.h"
+#include "lineIndex.h"
+#include "linePool.h"
+#include "fileSave.h"
+#include "undoJournal.h"
+#include "textSearch.h"
+#include "regexSearch.h"
+#include "syntaxHighlight.h"
 
 typedef struct linebuf {
 
-    struct linebuf* prev;
-    struct linebuf* next;
-
     char* line;
     size_t len;
     size_t cap;
 
+    // number of bytes this line replaces in the filebuf's piece table
+    size_t srclen;
+
+    // pool the node and its text came from, NULL for plain heap lines
+    linepool* pool;
+
+    // changes whenever the text does; no two lines ever share a stamp, so a
+    // renderer can tell from it alone whether a row it drew is still current
+    uint64_t stamp;
+
 } linebuf;
 
-// viewbuf stores some number of lines.
-// the head is not guaranteed to be the root of the linked list, 
-// and the tail is not guaranteed to be the end. this struct is 
-// an abstraction for processing chunks of text (ie. the text in the viewport) 
+// viewbuf stores some number of lines (ie. the text in the viewport) as a
+// ring of line descriptors. lines can be pushed and popped at either end and
+// indexed in O(1); `first` is the ring slot of the top line and `cap` is
+// always a power of two.
 typedef struct {
 
-    struct linebuf *head;
+    linebuf** ring;
+    size_t cap;
+    size_t first;
+
     size_t headline;
     size_t lines;
 
 } viewbuf;
 
+// filebuf stores the document in a piece table. the lines in the viewport
+// are materialized as linebufs that can be edited in place; they are written
+// back into the piece table only when they leave the viewport with changes.
+// prewindow and postwindow are the parts of the document before and after
+// the viewport. `index` is built in the background at load and supplies
+// newline counts for the original text once it is ready.
 typedef struct {
 
-    char* prewindow;
-    char* postwindow; 
+    piecetable* text;
+    filemap* map;
+    lineindex* index;
+    linepool* pool;
 
     size_t prewindow_len;
     size_t postwindow_len;
 
-    size_t prewindow_cap;
-    size_t postwindow_cap;
-
     size_t viewlines;
 
-    linebuf* lines;
     viewbuf* view;
 
     const char* fname;
 
+    // save running in the background, if any
+    filesave* save;
+
+    // regex search running or finished in the background, if any
+    regexsearch* grep;
+
+    // every edit made through filebuf_insert/filebuf_erase, for undo
+    undojournal* journal;
+
+    // lexer states per line, NULL unless the file name picked a language.
+    // `scratch` holds lines lexed straight out of the piece table, and
+    // blocks of lines on their way into the view.
+    syntaxcache* syntax;
+    char* scratch;
+    size_t scratch_cap;
+
 } filebuf;
 
-#define linebuf_next(lb) ((linebuf*)lb->next)
-#define linebuf_prev(lb) ((linebuf*)lb->prev)
+// history kept for undo unless changed with undojournal_limit
+#define FILEBUF_UNDO_CAP ((size_t)16 << 20)
 
-textErr linebuf_init(linebuf** inst, const char* src, size_t strsize);
-textErr linebuf_parse(linebuf** inst, const char* src, size_t maxlines, size_t *charcount);
+// i'th visible line, counting from the top of the view
+#define viewbuf_line(vb, i) ((vb)->ring[((vb)->first + (i)) & ((vb)->cap - 1)])
+#define viewbuf_head(vb) ((vb)->lines ? viewbuf_line(vb, 0) : NULL)
+#define viewbuf_tail(vb) ((vb)->lines ? viewbuf_line(vb, (vb)->lines - 1) : NULL)
 
-textErr viewbuf_init(viewbuf** inst, linebuf* head, size_t maxlines);
+textErr linebuf_init(linebuf** inst, const char* src, size_t strsize);
+textErr linebuf_alloc(linebuf** inst, linepool* pool, const char* src, size_t strsize);
+textErr linebuf_reserve(linebuf** inst, size_t cap);
+textErr linebuf_insert(linebuf** inst, size_t pos, const char* src, size_t len);
+textErr linebuf_erase(linebuf** inst, size_t pos, size_t len);
+textErr linebuf_destroy(linebuf** inst);
+textErr linebuf_parse(viewbuf** inst, const char* src, size_t maxlines, size_t *charcount);
+
+textErr viewbuf_init(viewbuf** inst, size_t cap);
+textErr viewbuf_destroy(viewbuf** inst);
+textErr viewbuf_push_front(viewbuf** inst, linebuf* lb);
+textErr viewbuf_push_back(viewbuf** inst, linebuf* lb);
+textErr viewbuf_pop_front(viewbuf** inst, linebuf** lb);
+textErr viewbuf_pop_back(viewbuf** inst, linebuf** lb);
+textErr viewbuf_insert(viewbuf** inst, size_t index, linebuf* lb);
+textErr viewbuf_remove(viewbuf** inst, size_t index, linebuf** lb);
+textErr viewbuf_find(viewbuf** inst, linebuf* lb, size_t* index);
 textErr viewbuf_remove_empty_lines(viewbuf** inst);
 
 textErr filebuf_init(filebuf** inst, size_t viewlines);
-textErr filebuf_load(filebuf** inst, const char* filedata, const char* fname);
+textErr filebuf_load(filebuf** inst, filemap* map, const char* fname);
+textErr filebuf_destroy(filebuf** inst);
 textErr filebuf_resize(filebuf** inst);
 
 textErr filebuf_scroll_down(filebuf** inst);
 textErr filebuf_scroll_up(filebuf** inst);
+textErr filebuf_scroll_by(filebuf** inst, long n, size_t* moved);
+
+textErr filebuf_goto_line(filebuf** inst, size_t line);
+textErr filebuf_goto_offset(filebuf** inst, size_t offset);
+textErr filebuf_goto_percent(filebuf** inst, size_t percent);
+
+textErr filebuf_line_count(filebuf** inst, size_t* lines);
+
+textErr filebuf_insert(filebuf** inst, size_t line, size_t pos, const char* src, size_t len);
+textErr filebuf_insert_bulk(filebuf** inst, size_t line, size_t pos, const char* src, size_t len, size_t* end);
+textErr filebuf_erase(filebuf** inst, size_t line, size_t pos, size_t len);
+textErr filebuf_undo(filebuf** inst, size_t* offset);
+textErr filebuf_redo(filebuf** inst, size_t* offset);
+textErr filebuf_locate(filebuf** inst, size_t offset, size_t* line, size_t* pos);
+textErr filebuf_offset(filebuf** inst, size_t line, size_t pos, size_t* offset);
+textErr filebuf_search(filebuf** inst, textsearch** search);
+
+textErr filebuf_syntax_state(filebuf** inst, size_t line, uint32_t* state);
+textErr filebuf_highlight(filebuf** inst, size_t line, size_t from, size_t to, uint8_t* classes);
+
+textErr filebuf_sync(filebuf** inst);
+textErr filebuf_save(filebuf** inst, const char* path);
+textErr filebuf_save_poll(filebuf** inst, size_t* written, size_t* total);
+
+textErr filebuf_grep(filebuf** inst, const char* pattern, size_t from);
+textErr filebuf_grep_next(filebuf** inst, size_t offset, bool backward, regexsearch_match* match);
+textErr filebuf_grep_progress(filebuf** inst, size_t* done, size_t* chunks, size_t* matches);
+textErr filebuf_grep_stop(filebuf** inst);
 
 #endif /* TEXTMAN_H */
@@ -0,0 +1,225 @@
+#include "textSearch.h"
+
+#include <stdint.h>
+#include <string.h>
+#include "lineScan.h"
+
+textErr textsearch_init(textsearch** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    ref = (textsearch*)calloc(1, sizeof(textsearch));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    return ERR_NONE;
+
+}
+
+textErr textsearch_destroy(textsearch** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
+
+// start a new, empty pattern at document offset `origin`
+textErr textsearch_begin(textsearch** inst, size_t origin, bool backward) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    ref->len = 0;
+    ref->backward = backward;
+    ref->origin = origin;
+    ref->from = origin;
+    ref->found = false;
+    ref->stale = false;
+    ref->failed = false;
+
+    return ERR_NONE;
+
+}
+
+// extend the pattern by one byte. every match of the longer pattern is a
+// match of the shorter one, so the search picks up at the last match.
+textErr textsearch_push(textsearch** inst, char c) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->len == TEXTSEARCH_MAX ) { return ERR_EOF; }
+
+    ref->pattern[ref->len++] = c;
+
+    // nothing matched the shorter pattern either
+    if ( ref->failed ) { return ERR_NONE; }
+
+    if ( ref->found ) { ref->from = ref->backward ? ref->match + 1 : ref->match; }
+    ref->stale = true;
+
+    return ERR_NONE;
+
+}
+
+// drop the last byte of the pattern; shorter patterns match more, so this
+// searches again from the origin
+textErr textsearch_pop(textsearch** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->len == 0 ) { return ERR_EOF; }
+
+    ref->len -= 1;
+    ref->from = ref->origin;
+    ref->found = false;
+    ref->failed = false;
+    ref->stale = ref->len > 0;
+
+    return ERR_NONE;
+
+}
+
+// move on to the next match in either direction, wrapping around the ends
+// of the document when the last search came up empty
+textErr textsearch_next(textsearch** inst, bool backward) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( ref->len == 0 ) { return ERR_EOF; }
+
+    ref->backward = backward;
+    if ( ref->found ) {
+        ref->from = backward ? ref->match : ref->match + 1;
+    } else {
+        ref->from = backward ? SIZE_MAX : 0;
+    }
+    ref->found = false;
+    ref->failed = false;
+    ref->stale = true;
+
+    return ERR_NONE;
+
+}
+
+void textsearch_scan_start(textsearch* s) {
+
+    s->carry_len = 0;
+    s->found = false;
+
+}
+
+void textsearch_scan_end(textsearch* s) {
+
+    s->stale = false;
+    s->failed = !s->found;
+
+}
+
+static int textsearch_feed_forward(textsearch* s, const char* data, size_t len, size_t offset) {
+
+    size_t keep = s->len - 1;
+    const char* hit = NULL;
+
+    // a match may start in the carried bytes and end in this segment
+    if ( s->carry_len > 0 ) {
+        size_t k = (len < keep) ? len : keep;
+        memcpy(&s->carry[s->carry_len], data, k);
+        hit = linescan_find_str(s->carry, s->carry_len + k, s->pattern, s->len);
+        if ( hit != NULL ) {
+            s->match = s->carry_off + (size_t)(hit - s->carry);
+            s->found = true;
+            return 1;
+        }
+    }
+
+    hit = linescan_find_str(data, len, s->pattern, s->len);
+    if ( hit != NULL ) {
+        s->match = offset + (size_t)(hit - data);
+        s->found = true;
+        return 1;
+    }
+
+    // carry the last `keep` bytes seen so far into the next segment
+    if ( len >= keep ) {
+        memcpy(s->carry, &data[len - keep], keep);
+        s->carry_len = keep;
+        s->carry_off = offset + len - keep;
+        return 0;
+    }
+
+    if ( s->carry_len == 0 ) {
+        memcpy(s->carry, data, len);
+        s->carry_off = offset;
+    }
+
+    size_t total = s->carry_len + len;
+    size_t drop = (total > keep) ? total - keep : 0;
+    memmove(s->carry, &s->carry[drop], total - drop);
+    s->carry_len = total - drop;
+    s->carry_off += drop;
+
+    return 0;
+
+}
+
+static int textsearch_feed_backward(textsearch* s, const char* data, size_t len, size_t offset) {
+
+    size_t keep = s->len - 1;
+    size_t had = s->carry_len;
+    const char* hit = NULL;
+
+    // a match may start in this segment and end in the carried bytes
+    if ( had > 0 ) {
+        size_t k = (len < keep) ? len : keep;
+        memmove(&s->carry[k], s->carry, had);
+        memcpy(s->carry, &data[len - k], k);
+        s->carry_len = had + k;
+        s->carry_off = offset + len - k;
+        hit = linescan_rfind_str(s->carry, s->carry_len, s->pattern, s->len);
+        if ( hit != NULL ) {
+            s->match = s->carry_off + (size_t)(hit - s->carry);
+            s->found = true;
+            return 1;
+        }
+    }
+
+    hit = linescan_rfind_str(data, len, s->pattern, s->len);
+    if ( hit != NULL ) {
+        s->match = offset + (size_t)(hit - data);
+        s->found = true;
+        return 1;
+    }
+
+    // carry the first `keep` bytes seen so far into the previous segment.
+    // a short segment is already at the front of the carry from above.
+    if ( len >= keep ) {
+        memcpy(s->carry, data, keep);
+        s->carry_len = keep;
+    } else {
+        if ( had == 0 ) {
+            memcpy(s->carry, data, len);
+            s->carry_len = len;
+        }
+        if ( s->carry_len > keep ) { s->carry_len = keep; }
+    }
+    s->carry_off = offset;
+
+    return 0;
+
+}
+
+// search one segment of the document, `len` bytes at `offset`. returns
+// nonzero once a match is found; `match` then holds its offset.
+int textsearch_feed(textsearch* s, const char* data, size_t len, size_t offset) {
+
+    if ( s->len == 0 || len == 0 ) { return 0; }
+
+    return s->backward ? textsearch_feed_backward(s, data, len, offset) : textsearch_feed_forward(s, data, len, offset);
+
+}
@@ -0,0 +1,58 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+// longest pattern the search takes
+#define TEXTSEARCH_MAX 256
+
+// textsearch is an incremental substring search. the caller feeds it the
+// document a segment at a time, in order for a forward search and back to
+// front for a backward one, and the segments are searched where they are.
+// the last patlen-1 bytes of each segment are carried over so matches that
+// straddle two segments are found too.
+// a forward search finds the first match starting at or after `from`, a
+// backward one the last match starting before it. growing the pattern only
+// ever narrows the matches, so each typed byte continues from the previous
+// match instead of starting over, and a pattern with no match skips the scan
+// entirely until it shrinks again.
+typedef struct {
+
+    char pattern[TEXTSEARCH_MAX];
+    size_t len;
+
+    bool backward;
+    size_t origin;
+    size_t from;
+
+    bool found;
+    size_t match;
+
+    // `stale` means the pattern or position changed since the last scan;
+    // `failed` that the last scan found nothing
+    bool stale;
+    bool failed;
+
+    // bytes from the previous segment and the document offset of the first
+    char carry[2*TEXTSEARCH_MAX];
+    size_t carry_len;
+    size_t carry_off;
+
+} textsearch;
+
+textErr textsearch_init(textsearch** inst);
+textErr textsearch_destroy(textsearch** inst);
+
+textErr textsearch_begin(textsearch** inst, size_t origin, bool backward);
+textErr textsearch_push(textsearch** inst, char c);
+textErr textsearch_pop(textsearch** inst);
+textErr textsearch_next(textsearch** inst, bool backward);
+
+// used by whoever owns the document to run a scan
+void textsearch_scan_start(textsearch* s);
+int textsearch_feed(textsearch* s, const char* data, size_t len, size_t offset);
+void textsearch_scan_end(textsearch* s);
+
+#endif /* TEXTSEARCH_H */
@@ -0,0 +1,164 @@
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "textTrace.h"
+
+typedef struct {
+
+    const char* name;
+    uint64_t ns;
+    char phase;
+
+} texttrace_event;
+
+// a thread's events; `total` counts every event recorded, so the ring holds
+// the last min(total, TEXTTRACE_RING_EVENTS) of them
+typedef struct texttrace_ring {
+
+    texttrace_event* events;
+    size_t total;
+    int tid;
+    bool main;
+
+    struct texttrace_ring* next;
+
+} texttrace_ring;
+
+// every ring ever made, kept after its thread exits so the trace has it
+static pthread_mutex_t texttrace_lock = PTHREAD_MUTEX_INITIALIZER;
+static texttrace_ring* texttrace_rings = NULL;
+static int texttrace_threads = 0;
+static uint64_t texttrace_epoch = 0;
+
+// set by texttrace_main, so the trace can tell the main thread from workers
+// that happened to trace first
+static pthread_t texttrace_main_thread;
+static bool texttrace_main_known = false;
+
+static _Thread_local texttrace_ring* texttrace_mine = NULL;
+
+static uint64_t texttrace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static texttrace_ring* texttrace_register(void) {
+
+    texttrace_ring* ring = (texttrace_ring*)calloc(1, sizeof(texttrace_ring));
+    if ( ring == NULL ) { return NULL; }
+
+    ring->events = (texttrace_event*)malloc(sizeof(texttrace_event) * TEXTTRACE_RING_EVENTS);
+    if ( ring->events == NULL ) {
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&texttrace_lock);
+    if ( texttrace_threads == 0 ) { texttrace_epoch = texttrace_now(); }
+    ring->tid = texttrace_threads++;
+    ring->main = texttrace_main_known && pthread_equal(pthread_self(), texttrace_main_thread);
+    ring->next = texttrace_rings;
+    texttrace_rings = ring;
+    pthread_mutex_unlock(&texttrace_lock);
+
+    return ring;
+
+}
+
+static void texttrace_record(const char* name, char phase) {
+
+    texttrace_ring* ring = texttrace_mine;
+    if ( ring == NULL ) {
+        ring = texttrace_register();
+        if ( ring == NULL ) { return; }
+        texttrace_mine = ring;
+    }
+
+    texttrace_event* ev = &ring->events[ring->total & (TEXTTRACE_RING_EVENTS - 1)];
+    ev->name = name;
+    ev->ns = texttrace_now();
+    ev->phase = phase;
+    ring->total += 1;
+
+}
+
+// call from the main thread before any other starts tracing
+void texttrace_main(void) {
+    pthread_mutex_lock(&texttrace_lock);
+    texttrace_main_thread = pthread_self();
+    texttrace_main_known = true;
+    pthread_mutex_unlock(&texttrace_lock);
+}
+
+void texttrace_begin(const char* name) {
+    texttrace_record(name, 'B');
+}
+
+void texttrace_end(const char* name) {
+    texttrace_record(name, 'E');
+}
+
+void texttrace_scope_end(const char** name) {
+    texttrace_record(*name, 'E');
+}
+
+// frees the rings as they're written; tracing again starts a new trace
+textErr texttrace_write(const char* path) {
+
+    FILE* fp = fopen(path, "w");
+    if ( fp == NULL ) { return ERR_IO; }
+
+    pthread_mutex_lock(&texttrace_lock);
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    bool first = true;
+    texttrace_ring* ring = texttrace_rings;
+    while ( ring != NULL ) {
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                first ? "" : ",\n", ring->tid, ring->main ? "main" : "worker", ring->tid);
+        first = false;
+
+        // a full ring may have dropped the begin of some of the first ends
+        // it kept; those are left out rather than closing events that were
+        // never opened
+        size_t kept = ring->total < TEXTTRACE_RING_EVENTS ? ring->total : TEXTTRACE_RING_EVENTS;
+        size_t open = 0;
+        for ( size_t i = ring->total - kept; i < ring->total; i++ ) {
+            const texttrace_event* ev = &ring->events[i & (TEXTTRACE_RING_EVENTS - 1)];
+            if ( ev->phase == 'B' ) {
+                open += 1;
+            } else if ( open == 0 ) {
+                continue;
+            } else {
+                open -= 1;
+            }
+            uint64_t ns = ev->ns - texttrace_epoch;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%d}",
+                    ev->name, ev->phase, (unsigned long long)(ns / 1000), (unsigned)(ns % 1000), ring->tid);
+        }
+
+        texttrace_ring* next = ring->next;
+        free(ring->events);
+        free(ring);
+        ring = next;
+
+    }
+
+    fprintf(fp, "\n]}\n");
+
+    texttrace_rings = NULL;
+    texttrace_threads = 0;
+    texttrace_mine = NULL;
+    pthread_mutex_unlock(&texttrace_lock);
+
+    return fclose(fp) == 0 ? ERR_NONE : ERR_IO;
+
+}
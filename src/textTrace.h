@@ -0,0 +1,48 @@
+#ifndef TEXTTRACE_H
+#define TEXTTRACE_H
+
+#include "textErr.h"
+
+// begin/end events for the Chrome trace viewer (chrome://tracing, Perfetto).
+// the macros are compiled in only with -DTEXT_TRACE (make TRACE=1), and
+// cost nothing otherwise. each thread records into a ring of its own
+// without locking; once a ring is full the oldest events are dropped.
+// TRACE_MAIN at the top of main() names the main thread's events.
+// texttrace_write dumps every ring as trace_event JSON and must only run
+// once the threads that traced are done.
+//
+// names are not copied, so they have to be string literals or __func__.
+
+#define TEXTTRACE_RING_EVENTS ((size_t)1 << 16)
+
+void texttrace_main(void);
+void texttrace_begin(const char* name);
+void texttrace_end(const char* name);
+void texttrace_scope_end(const char** name);
+textErr texttrace_write(const char* path);
+
+#ifdef TEXT_TRACE
+
+#define TRACE_MAIN() texttrace_main()
+#define TRACE_BEGIN(name) texttrace_begin(name)
+#define TRACE_END(name) texttrace_end(name)
+
+// traces from here to the end of the enclosing block, whichever way it is
+// left
+#define TRACE_SCOPE(name) \
+    const char* texttrace_scope_ __attribute__((cleanup(texttrace_scope_end), unused)) = name; \
+    texttrace_begin(texttrace_scope_)
+
+#define TRACE_WRITE(path) texttrace_write(path)
+
+#else
+
+#define TRACE_MAIN() ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_WRITE(path) ((void)0)
+
+#endif
+
+#endif /* TEXTTRACE_H */
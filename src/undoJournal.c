@@ -0,0 +1,281 @@
+#include "undoJournal.h"
+
+#include <string.h>
+#include <time.h>
+
+#define undojournal_data(chunk) ((char*)((chunk) + 1))
+
+// bytes a record takes in a chunk, padded so the next header stays aligned
+static size_t undojournal_size(size_t dellen, size_t inslen) {
+    size_t size = sizeof(undojournal_rec) + dellen + inslen;
+    return (size + 7) & ~(size_t)7;
+}
+
+static uint64_t undojournal_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void undojournal_free_chunk(undojournal* j, undojournal_chunk* c) {
+
+    if ( c->prev != NULL ) { c->prev->next = c->next; } else { j->head = c->next; }
+    if ( c->next != NULL ) { c->next->prev = c->prev; } else { j->tail = c->prev; }
+
+    j->bytes -= sizeof(undojournal_chunk) + c->cap;
+    free(c);
+
+}
+
+// forget every record past `pos`; they are always the last ones in the
+// arena, so this just rewinds the tail
+static void undojournal_truncate(undojournal* j) {
+
+    while ( j->count > j->pos ) {
+
+        undojournal_rec* rec = j->recs[--j->count];
+        undojournal_chunk* c = j->tail;
+
+        c->used = (size_t)((char*)rec - undojournal_data(c));
+        c->records -= 1;
+        if ( c->records == 0 ) { undojournal_free_chunk(j, c); }
+
+    }
+
+}
+
+static void undojournal_clear(undojournal* j) {
+
+    while ( j->head != NULL ) { undojournal_free_chunk(j, j->head); }
+
+    j->count = 0;
+    j->pos = 0;
+    j->open = false;
+
+}
+
+// drop the oldest chunks until the arena fits in `cap`, keeping the newest
+static void undojournal_trim(undojournal* j) {
+
+    while ( j->bytes > j->cap && j->head != NULL && j->head != j->tail ) {
+
+        size_t drop = j->head->records;
+
+        // the records left would depend on ones that are gone
+        if ( j->pos < drop ) {
+            undojournal_clear(j);
+            return;
+        }
+
+        memmove(j->recs, j->recs + drop, sizeof(undojournal_rec*) * (j->count - drop));
+        j->count -= drop;
+        j->pos -= drop;
+
+        undojournal_free_chunk(j, j->head);
+
+    }
+
+}
+
+static textErr undojournal_push(undojournal* j, size_t size, undojournal_rec** out) {
+
+    if ( j->count == j->recs_cap ) {
+        size_t newcap = j->recs_cap ? j->recs_cap*2 : 256;
+        undojournal_rec** grown = (undojournal_rec**)realloc(j->recs, sizeof(undojournal_rec*) * newcap);
+        if ( grown == NULL ) { return ERR_MEM; }
+        j->recs = grown;
+        j->recs_cap = newcap;
+    }
+
+    undojournal_chunk* c = j->tail;
+    if ( c == NULL || c->cap - c->used < size ) {
+
+        size_t cap = size > UNDOJOURNAL_CHUNK ? size : UNDOJOURNAL_CHUNK;
+        c = (undojournal_chunk*)malloc(sizeof(undojournal_chunk) + cap);
+        if ( c == NULL ) { return ERR_MEM; }
+
+        c->next = NULL;
+        c->prev = j->tail;
+        c->cap = cap;
+        c->used = 0;
+        c->records = 0;
+
+        if ( j->tail != NULL ) { j->tail->next = c; } else { j->head = c; }
+        j->tail = c;
+        j->bytes += sizeof(undojournal_chunk) + cap;
+
+    }
+
+    undojournal_rec* rec = (undojournal_rec*)(undojournal_data(c) + c->used);
+    c->used += size;
+    c->records += 1;
+
+    j->recs[j->count++] = rec;
+    j->pos = j->count;
+
+    *out = rec;
+
+    return ERR_NONE;
+
+}
+
+// fold an edit into the last record if it continues it: typing at the end
+// of the last insert, or deleting forwards or backwards from the last
+// delete. returns nonzero if it did.
+static int undojournal_merge(undojournal* j, size_t offset, const char* del, size_t dellen, const char* ins, size_t inslen) {
+
+    if ( !j->open || j->count == 0 || j->pos != j->count ) { return 0; }
+    if ( undojournal_now_ms() - j->last_ms > UNDOJOURNAL_MERGE_MS ) { return 0; }
+
+    undojournal_rec* rec = j->recs[j->count - 1];
+    undojournal_chunk* c = j->tail;
+
+    if ( rec->dellen + rec->inslen + dellen + inslen > UNDOJOURNAL_MERGE_MAX ) { return 0; }
+
+    size_t size = undojournal_size(rec->dellen + dellen, rec->inslen + inslen);
+    size_t at = (size_t)((char*)rec - undojournal_data(c));
+    if ( at + size > c->cap ) { return 0; }
+
+    if ( dellen == 0 && rec->dellen == 0 && offset == rec->offset + rec->inslen ) {
+        memcpy(undojournal_inserted(rec) + rec->inslen, ins, inslen);
+        rec->inslen += inslen;
+    } else if ( inslen == 0 && rec->inslen == 0 && offset == rec->offset ) {
+        memcpy(undojournal_deleted(rec) + rec->dellen, del, dellen);
+        rec->dellen += dellen;
+    } else if ( inslen == 0 && rec->inslen == 0 && offset + dellen == rec->offset ) {
+        memmove(undojournal_deleted(rec) + dellen, undojournal_deleted(rec), rec->dellen);
+        memcpy(undojournal_deleted(rec), del, dellen);
+        rec->dellen += dellen;
+        rec->offset = offset;
+    } else {
+        return 0;
+    }
+
+    c->used = at + size;
+
+    return 1;
+
+}
+
+textErr undojournal_init(undojournal** inst, size_t cap) {
+    #define ref (*inst)
+
+    if ( inst == NULL ) { return ERR_NULL; }
+    if ( ref != NULL ) { return ERR_NULL; }
+
+    ref = (undojournal*)calloc(1, sizeof(undojournal));
+    if ( ref == NULL ) { return ERR_MEM; }
+
+    ref->cap = cap;
+
+    return ERR_NONE;
+
+}
+
+textErr undojournal_destroy(undojournal** inst) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    undojournal_clear(ref);
+    free(ref->recs);
+    free(ref);
+    ref = NULL;
+
+    return ERR_NONE;
+
+}
+
+// change the memory cap, dropping history that no longer fits
+textErr undojournal_limit(undojournal** inst, size_t cap) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+
+    ref->cap = cap;
+    undojournal_trim(ref);
+
+    return ERR_NONE;
+
+}
+
+// record that `dellen` bytes `del` at `offset` were replaced by `inslen`
+// bytes `ins`. anything that could be redone is discarded.
+textErr undojournal_record(undojournal** inst, size_t offset, const char* del, size_t dellen, const char* ins, size_t inslen) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL ) { return ERR_NULL; }
+    if ( (del == NULL && dellen != 0) || (ins == NULL && inslen != 0) ) { return ERR_NULL; }
+    if ( dellen == 0 && inslen == 0 ) { return ERR_NONE; }
+
+    undojournal_truncate(ref);
+
+    // a line break ends a typing burst
+    bool breaks = (inslen > 0 && memchr(ins, '\n', inslen) != NULL) || (dellen > 0 && memchr(del, '\n', dellen) != NULL);
+
+    if ( !breaks && undojournal_merge(ref, offset, del, dellen, ins, inslen) ) {
+        ref->last_ms = undojournal_now_ms();
+        return ERR_NONE;
+    }
+
+    size_t size = undojournal_size(dellen, inslen);
+
+    // an edit too big to keep would leave the history before it unusable
+    if ( size + sizeof(undojournal_chunk) > ref->cap ) {
+        undojournal_clear(ref);
+        return ERR_NONE;
+    }
+
+    undojournal_rec* rec = NULL;
+    textErr ret = undojournal_push(ref, size, &rec);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    rec->offset = offset;
+    rec->dellen = dellen;
+    rec->inslen = inslen;
+    if ( dellen > 0 ) { memcpy(undojournal_deleted(rec), del, dellen); }
+    if ( inslen > 0 ) { memcpy(undojournal_inserted(rec), ins, inslen); }
+
+    ref->open = !breaks;
+    ref->last_ms = undojournal_now_ms();
+
+    undojournal_trim(ref);
+
+    return ERR_NONE;
+
+}
+
+// stop the last record from absorbing the next edit
+void undojournal_seal(undojournal** inst) {
+    if ( inst != NULL && *inst != NULL ) { (*inst)->open = false; }
+}
+
+// step back one record. the caller reverts it: at rec->offset, replace
+// rec->inslen bytes with the deleted bytes. ERR_EOF if there is none.
+textErr undojournal_undo(undojournal** inst, const undojournal_rec** rec) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || rec == NULL ) { return ERR_NULL; }
+    if ( ref->pos == 0 ) { return ERR_EOF; }
+
+    ref->open = false;
+    *rec = ref->recs[--ref->pos];
+
+    return ERR_NONE;
+
+}
+
+// step forward one record. the caller applies it again: at rec->offset,
+// replace rec->dellen bytes with the inserted bytes.
+textErr undojournal_redo(undojournal** inst, const undojournal_rec** rec) {
+    #define ref (*inst)
+
+    if ( inst == NULL || ref == NULL || rec == NULL ) { return ERR_NULL; }
+    if ( ref->pos == ref->count ) { return ERR_EOF; }
+
+    ref->open = false;
+    *rec = ref->recs[ref->pos++];
+
+    return ERR_NONE;
+
+}
@@ -0,0 +1,74 @@
+#ifndef UNDOJOURNAL_H
+#define UNDOJOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "textErr.h"
+
+// records are packed into chunks of this size; bigger ones get a chunk of
+// their own
+#define UNDOJOURNAL_CHUNK ((size_t)64 * 1024)
+
+// typing stops merging into one record after this many bytes or this long
+// a pause
+#define UNDOJOURNAL_MERGE_MAX 1024
+#define UNDOJOURNAL_MERGE_MS 1000
+
+// one edit: at document `offset`, `dellen` bytes were replaced by `inslen`
+// bytes. the deleted bytes follow the header, then the inserted ones.
+typedef struct {
+
+    size_t offset;
+    size_t dellen;
+    size_t inslen;
+
+} undojournal_rec;
+
+#define undojournal_deleted(rec) ((char*)((rec) + 1))
+#define undojournal_inserted(rec) (undojournal_deleted(rec) + (rec)->dellen)
+
+typedef struct undojournal_chunk {
+
+    struct undojournal_chunk* next;
+    struct undojournal_chunk* prev;
+
+    size_t cap;
+    size_t used;
+    size_t records;
+
+} undojournal_chunk;
+
+// undojournal keeps edits as a stack of records in a chunked arena. `pos`
+// records are applied; the ones past it can be redone until a new edit
+// discards them. when the arena outgrows `cap` bytes the oldest chunks are
+// dropped, taking the oldest history with them.
+typedef struct {
+
+    undojournal_chunk* head;
+    undojournal_chunk* tail;
+    size_t bytes;
+    size_t cap;
+
+    undojournal_rec** recs;
+    size_t count;
+    size_t recs_cap;
+    size_t pos;
+
+    // the last record may still grow while this is set
+    bool open;
+    uint64_t last_ms;
+
+} undojournal;
+
+textErr undojournal_init(undojournal** inst, size_t cap);
+textErr undojournal_destroy(undojournal** inst);
+textErr undojournal_limit(undojournal** inst, size_t cap);
+
+textErr undojournal_record(undojournal** inst, size_t offset, const char* del, size_t dellen, const char* ins, size_t inslen);
+void undojournal_seal(undojournal** inst);
+
+textErr undojournal_undo(undojournal** inst, const undojournal_rec** rec);
+textErr undojournal_redo(undojournal** inst, const undojournal_rec** rec);
+
+#endif /* UNDOJOURNAL_H */
@@ -1,36 +1,34 @@
 
 #include "windowMan.h"
 
-textErr windowman_init(windowman_t** inst) {
+textErr windowman_init(windowman_t** inst, termscreen* screen) {
 
-    if ( inst == NULL ) { return ERR_NULL; }
+    if ( inst == NULL || screen == NULL ) { return ERR_NULL; }
 
     windowman_t* ctx = (windowman_t*)calloc(1, sizeof(windowman_t));
     if ( ctx == NULL ) { return ERR_MEM; }
 
-    if ( initscr() == NULL ) {
+    if ( textsearch_init(&ctx->search) != ERR_NONE ) {
         free(ctx);
         return ERR_MEM;
     }
 
-    cbreak();            // disable line buffering
-    noecho();            // don't echo typed characters
-    keypad(stdscr, TRUE);// enable function and arrow keys
-    intrflush(stdscr, FALSE);
-    
-    // try to hide the cursor
-    curs_set(0);
-
-    if ( has_colors() ) {
-        start_color();
-    }
+    ctx->screen = screen;
+    ctx->color = screen->colors;
 
     int h, w;
-    getmaxyx(stdscr, h, w);
+    termscreen_size(screen, &h, &w);
     ctx->win_width = (size_t)w;
     ctx->win_height = (size_t)h;
     ctx->cursor_x = 0;
     ctx->cursor_y = 0;
+    ctx->dirty = true;
+    ctx->quit = false;
+    ctx->wake_ms = -1;
+    ctx->full_redraw = true;
+    ctx->drawn_cursor_y = SIZE_MAX;
+    ctx->wrap = true;
+    ctx->scroll_x = 0;
 
     *inst = ctx;
 
@@ -38,273 +36,1222 @@ textErr windowman_init(windowman_t** inst) {
 
 }
 
-textErr windowman_render(windowman_t* ctx, filebuf* fbuf) {
+// "N" jumps to line N, "N%" to a percentage of the file and "@N" to byte N
+static textErr windowman_goto(windowman_t* ctx, filebuf* fbuf) {
+
+    char input[32] = { 0 };
+    termscreen_prompt(ctx->screen, "Go to line (N, N%, @byte): ", input, (int)sizeof(input));
+
+    char* end = NULL;
+    textErr ret = ERR_NONE;
+
+    if ( input[0] == '@' ) {
+        size_t offset = (size_t)strtoull(&input[1], &end, 10);
+        if ( end == &input[1] ) { return ERR_NONE; }
+        ret = filebuf_goto_offset(&fbuf, offset);
+    } else {
+        size_t value = (size_t)strtoull(input, &end, 10);
+        if ( end == input ) { return ERR_NONE; }
+        if ( *end == '%' ) {
+            ret = filebuf_goto_percent(&fbuf, value);
+        } else {
+            ret = filebuf_goto_line(&fbuf, value);
+        }
+    }
 
-    if ( ctx == NULL ) { return ERR_NULL; }
+    ctx->cursor_x = 0;
+    ctx->cursor_y = 0;
+    ctx->full_redraw = true;
+    termscreen_clear(ctx->screen);
+
+    if ( ret == ERR_BUSY ) {
+        snprintf(ctx->message, sizeof(ctx->message), "Still counting lines");
+        return ERR_NONE;
+    }
+
+    return ret;
+
+}
+
+static textErr windowman_reserve_rows(windowman_t* ctx, size_t rows) {
+
+    if ( rows <= ctx->rows_cap ) { return ERR_NONE; }
+
+    windowman_row* drawn = (windowman_row*)realloc(ctx->drawn, sizeof(windowman_row) * rows);
+    if ( drawn == NULL ) { return ERR_MEM; }
+    ctx->drawn = drawn;
+
+    windowman_row* layout = (windowman_row*)realloc(ctx->layout, sizeof(windowman_row) * rows);
+    if ( layout == NULL ) { return ERR_MEM; }
+    ctx->layout = layout;
+
+    for ( size_t i = ctx->rows_cap; i < rows; i++ ) {
+        ctx->drawn[i].stamp = WINDOWMAN_ROW_STALE;
+    }
+    ctx->rows_cap = rows;
+    ctx->layout_valid = false;
+
+    return ERR_NONE;
+
+}
+
+// printable length of a line, without its newline
+static size_t windowman_line_width(const linebuf* lb) {
+    size_t len = lb->len;
+    if ( len > 0 && lb->line[len-1] == '\n' ) { len -= 1; }
+    return len;
+}
+
+// columns left for text on screen with the view's top line at `headline`:
+// the gutter takes as many digits as the last line number could need, a
+// space and the rule
+static size_t windowman_text_width(const windowman_t* ctx, const filebuf* fbuf, size_t headline, int* digits) {
+
+    size_t maxloc = headline + fbuf->viewlines;
+    int d = 0;
+    do {
+        maxloc /= 10;
+        d += 1;
+    } while ( maxloc > 0 );
+
+    if ( digits != NULL ) { *digits = d; }
+
+    return (ctx->win_width > (size_t)(d+2)) ? (ctx->win_width - (size_t)(d+2)) : 0;
+
+}
+
+// lines the view can scroll from `headline` and keep one text width the
+// whole way; past them the gutter gains or loses a digit
+static size_t windowman_width_run(const filebuf* fbuf, size_t headline, bool up) {
+
+    size_t maxloc = headline + fbuf->viewlines;
+
+    if ( up ) {
+        if ( maxloc < 2 ) { return 1; }
+        size_t low = 1;
+        while ( low <= (maxloc - 1) / 10 ) { low *= 10; }
+        return maxloc - low;
+    }
+
+    size_t high = 10;
+    while ( high <= maxloc + 1 ) { high *= 10; }
+    return high - (maxloc + 1);
+
+}
+
+// map the text rows to slices of the lines in the view; rows past the end of
+// the view are blank. when wrapping, long lines take as many rows as they
+// need, but only as many as are on screen are laid out. otherwise each line
+// gets one row starting at `scroll_x`. either way the work per frame is
+// bounded by the window size, not the line lengths.
+static void windowman_layout(windowman_t* ctx, filebuf* fbuf, size_t textrows, size_t max_text) {
+
+    size_t row = 0;
+
+    for ( size_t i = 0; i < fbuf->view->lines && row < textrows; i++ ) {
+
+        linebuf* cur = viewbuf_line(fbuf->view, i);
+        size_t plen = windowman_line_width(cur);
+
+        uint32_t state = 0;
+        if ( ctx->color && fbuf->syntax != NULL ) { filebuf_syntax_state(&fbuf, i, &state); }
+
+        size_t offset = ctx->wrap ? 0 : ctx->scroll_x;
+        do {
+            size_t seg = 0;
+            if ( offset < plen ) { seg = (plen - offset < max_text) ? plen - offset : max_text; }
+
+            windowman_row* r = &ctx->layout[row];
+            r->lb = cur;
+            r->offset = offset;
+            r->len = seg;
+            r->stamp = cur->stamp;
+            r->lineno = fbuf->view->headline + i;
+            r->state = state;
+
+            offset += seg;
+            row += 1;
+        } while ( ctx->wrap && offset < plen && max_text > 0 && row < textrows );
+
+    }
+
+    ctx->layout_rows = row;
+
+    for ( ; row < textrows; row++ ) {
+        memset(&ctx->layout[row], 0, sizeof(windowman_row));
+    }
+
+    linebuf* head = viewbuf_head(fbuf->view);
+    ctx->layout_head = head != NULL ? head->stamp : 0;
+    ctx->layout_headline = fbuf->view->headline;
+    ctx->layout_text_width = max_text;
+    ctx->layout_valid = true;
+
+}
+
+// without wrapping: put the cursor on `column` of its line, scrolling
+// sideways if the column is off screen. scrolls jump a quarter of the width
+// so moving along a long line doesn't redraw every row on every step.
+static void windowman_show_column(windowman_t* ctx, size_t column, size_t max_text) {
+
+    if ( max_text == 0 ) { return; }
+
+    size_t scroll_x = ctx->scroll_x;
+    size_t step = max_text / 4 > 0 ? max_text / 4 : 1;
+
+    if ( column < scroll_x ) {
+        scroll_x = column > step ? column - step : 0;
+    } else if ( column >= scroll_x + max_text ) {
+        scroll_x = column - max_text + 1 + step;
+        if ( scroll_x > column ) { scroll_x = column; }
+    }
+
+    if ( scroll_x != ctx->scroll_x ) {
+        ctx->scroll_x = scroll_x;
+        ctx->layout_valid = false;
+    }
+    ctx->cursor_x = column - scroll_x;
+
+}
+
+// move the cursor to where an undo or redo left it
+static void windowman_place_cursor(windowman_t* ctx, filebuf* fbuf, size_t max_text) {
+
+    ctx->cursor_pending = false;
+    ctx->cursor_x = 0;
+    ctx->cursor_y = 0;
+
+    if ( ctx->pending_line >= fbuf->view->lines ) { return; }
+    linebuf* lb = viewbuf_line(fbuf->view, ctx->pending_line);
+    size_t pos = ctx->pending_pos;
+
+    for ( size_t i = 0; i < ctx->layout_rows; i++ ) {
+
+        const windowman_row* r = &ctx->layout[i];
+        if ( r->lb != lb ) { continue; }
+
+        if ( !ctx->wrap ) {
+            ctx->cursor_y = i;
+            windowman_show_column(ctx, pos, max_text);
+            return;
+        }
+
+        // a wrapped line spans several rows; stop at the one holding `pos`
+        bool last = i + 1 == ctx->layout_rows || ctx->layout[i+1].lb != lb;
+        if ( pos < r->offset + r->len || last ) {
+            ctx->cursor_y = i;
+            // past the end of the last row shown, the cursor keeps its
+            // column off screen so the next key still edits at `pos`
+            ctx->cursor_x = (pos > r->offset) ? pos - r->offset : 0;
+            return;
+        }
+
+    }
+
+}
+
+// put the cursor on document `offset`, moving the view there if it's not
+// in it
+static textErr windowman_show_offset(windowman_t* ctx, filebuf* fbuf, size_t offset) {
+
+    textErr ret = filebuf_locate(&fbuf, offset, &ctx->pending_line, &ctx->pending_pos);
+    if ( ret == ERR_EOF ) {
+        ret = filebuf_goto_offset(&fbuf, offset);
+        if ( ret == ERR_BUSY ) {
+            // the view can't move until the line count is in
+            snprintf(ctx->message, sizeof(ctx->message), "Still counting lines");
+            ctx->layout_valid = false;
+            return ERR_NONE;
+        }
+        if ( ret != ERR_NONE ) { return ret; }
+        ret = filebuf_locate(&fbuf, offset, &ctx->pending_line, &ctx->pending_pos);
+    }
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ctx->cursor_pending = true;
+    ctx->layout_valid = false;
+
+    return ERR_NONE;
+
+}
+
+// document offset under the cursor
+static size_t windowman_cursor_offset(windowman_t* ctx, filebuf* fbuf) {
+
+    size_t index = 0;
+    size_t offset = 0;
+
+    if ( ctx->cursor_y >= ctx->layout_rows ) { return 0; }
+
+    const windowman_row* row = &ctx->layout[ctx->cursor_y];
+    if ( row->lb != NULL && ctx->layout_valid && viewbuf_find(&fbuf->view, row->lb, &index) == ERR_NONE ) {
+        size_t pos = row->offset + ctx->cursor_x;
+        filebuf_offset(&fbuf, index, (pos < row->lb->len) ? pos : row->lb->len, &offset);
+    }
+
+    return offset;
+
+}
+
+// ctrl+f searches forward from the cursor as the pattern is typed. ctrl+f
+// or down moves to the next match, up to the previous one; enter stays on
+// the match and escape goes back to where the search started.
+static textErr windowman_search_key(windowman_t* ctx, filebuf* fbuf, int keypress) {
+
+    if ( keypress == -1 ) { return ERR_NONE; }
+
+    if ( keypress == 10 ) {
+        ctx->searching = false;
+        return ERR_NONE;
+    }
+    if ( keypress == 27 ) {
+        ctx->searching = false;
+        return windowman_show_offset(ctx, fbuf, ctx->search->origin);
+    }
+
+    if ( keypress == TERMSCREEN_KEY_BACKSPACE || keypress == 127 ) {
+        textsearch_pop(&ctx->search);
+    } else if ( keypress == WINDOWMAN_KEY_FIND || keypress == TERMSCREEN_KEY_DOWN ) {
+        textsearch_next(&ctx->search, false);
+    } else if ( keypress == TERMSCREEN_KEY_UP ) {
+        textsearch_next(&ctx->search, true);
+    } else if ( keypress >= 32 && keypress <= 126 ) {
+        textsearch_push(&ctx->search, (char)keypress);
+    } else {
+        return ERR_NONE;
+    }
+
+    textErr ret = filebuf_search(&fbuf, &ctx->search);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    if ( !ctx->search->found ) { return ERR_NONE; }
+
+    return windowman_show_offset(ctx, fbuf, ctx->search->match);
+
+}
+
+// ctrl+r asks for an extended regular expression and greps the whole
+// document for it in the background. the cursor jumps to the first match
+// after it as soon as that is known; up and down step through the matches,
+// enter stays and escape goes back.
+static textErr windowman_grep(windowman_t* ctx, filebuf* fbuf, size_t origin) {
+
+    char input[sizeof(ctx->grep_pattern)] = { 0 };
+    termscreen_prompt(ctx->screen, "Regex: ", input, (int)sizeof(input));
+
+    ctx->full_redraw = true;
+    termscreen_clear(ctx->screen);
+
+    if ( input[0] == '\0' ) { return ERR_NONE; }
+
+    textErr ret = filebuf_grep(&fbuf, input, origin);
+    if ( ret == ERR_PATTERN ) {
+        snprintf(ctx->message, sizeof(ctx->message), "Invalid pattern");
+        return ERR_NONE;
+    }
+    if ( ret != ERR_NONE ) { return ret; }
+
+    memcpy(ctx->grep_pattern, input, sizeof(input));
+    ctx->grepping = true;
+    ctx->grep_waiting = true;
+    ctx->grep_backward = false;
+    ctx->grep_found = false;
+    ctx->grep_at = origin;
+    ctx->grep_origin = origin;
+
+    return ERR_NONE;
+
+}
+
+// move to the match the last grep key asked for once it's known
+static textErr windowman_grep_poll(windowman_t* ctx, filebuf* fbuf) {
+
+    if ( !ctx->grepping || !ctx->grep_waiting ) { return ERR_NONE; }
+
+    regexsearch_match match;
+    textErr ret = filebuf_grep_next(&fbuf, ctx->grep_at, ctx->grep_backward, &match);
+    if ( ret == ERR_BUSY ) { return ERR_NONE; }
+
+    ctx->grep_waiting = false;
+    if ( ret == ERR_EOF ) { return ERR_NONE; }
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ctx->grep_found = true;
+    ctx->grep_match = match;
+
+    return windowman_show_offset(ctx, fbuf, match.offset);
+
+}
+
+static textErr windowman_grep_key(windowman_t* ctx, filebuf* fbuf, int keypress) {
+
+    if ( keypress == 10 || keypress == 27 ) {
+        ctx->grepping = false;
+        filebuf_grep_stop(&fbuf);
+        if ( keypress == 27 ) { return windowman_show_offset(ctx, fbuf, ctx->grep_origin); }
+        return ERR_NONE;
+    }
+
+    if ( !ctx->grep_found ) { return ERR_NONE; }
+
+    if ( keypress == TERMSCREEN_KEY_DOWN || keypress == WINDOWMAN_KEY_GREP ) {
+        ctx->grep_at = ctx->grep_match.offset + 1;
+        ctx->grep_backward = false;
+        ctx->grep_waiting = true;
+    } else if ( keypress == TERMSCREEN_KEY_UP ) {
+        ctx->grep_at = ctx->grep_match.offset;
+        ctx->grep_backward = true;
+        ctx->grep_waiting = true;
+    }
+
+    return ERR_NONE;
+
+}
+
+static bool windowman_row_equal(const windowman_row* a, const windowman_row* b) {
+    return a->stamp == b->stamp && a->offset == b->offset && a->lineno == b->lineno && a->state == b->state;
+}
+
+// if the laid out rows are the drawn rows moved up or down (the view
+// scrolled), move the screen contents the same way so only the uncovered
+// rows need to be drawn
+static void windowman_scroll_rows(windowman_t* ctx, size_t rows) {
+
+    if ( rows < 2 || ctx->drawn[0].stamp == WINDOWMAN_ROW_STALE ) { return; }
+    if ( windowman_row_equal(&ctx->drawn[0], &ctx->layout[0]) ) { return; }
+
+    long shift = 0;
+    for ( size_t k = 1; k < rows && shift == 0; k++ ) {
+        if ( ctx->drawn[k].stamp != 0 && windowman_row_equal(&ctx->drawn[k], &ctx->layout[0]) ) { shift = (long)k; }
+        else if ( ctx->layout[k].stamp != 0 && windowman_row_equal(&ctx->layout[k], &ctx->drawn[0]) ) { shift = -(long)k; }
+    }
+    if ( shift == 0 ) { return; }
+
+    termscreen_scroll(ctx->screen, 2, (int)rows + 1, (int)shift);
+
+    size_t n = (size_t)(shift > 0 ? shift : -shift);
+    if ( shift > 0 ) {
+        memmove(&ctx->drawn[0], &ctx->drawn[n], sizeof(windowman_row) * (rows - n));
+        for ( size_t i = rows - n; i < rows; i++ ) { ctx->drawn[i].stamp = WINDOWMAN_ROW_STALE; }
+    } else {
+        memmove(&ctx->drawn[n], &ctx->drawn[0], sizeof(windowman_row) * (rows - n));
+        for ( size_t i = 0; i < n; i++ ) { ctx->drawn[i].stamp = WINDOWMAN_ROW_STALE; }
+    }
+
+    // the old cursor highlight moved along with its row
+    if ( ctx->drawn_cursor_y != SIZE_MAX ) {
+        long y = (long)ctx->drawn_cursor_y - shift;
+        ctx->drawn_cursor_y = (y >= 0 && y < (long)rows) ? (size_t)y : SIZE_MAX;
+    }
+
+}
+
+// syntax classes of the bytes row `row` shows, NULL to draw it plain
+static const uint8_t* windowman_row_classes(windowman_t* ctx, filebuf* fbuf, size_t row) {
+
+    if ( !ctx->color || fbuf->syntax == NULL ) { return NULL; }
+
+    // color every row of the line on screen in one go
+    const windowman_row* r = &ctx->layout[row];
+    size_t first = row;
+    size_t last = row;
+    while ( first > 0 && ctx->layout[first-1].lb == r->lb ) { first -= 1; }
+    while ( last + 1 < ctx->layout_rows && ctx->layout[last+1].lb == r->lb ) { last += 1; }
+    size_t from = ctx->layout[first].offset;
+    size_t to = ctx->layout[last].offset + ctx->layout[last].len;
+
+    if ( ctx->classes_stamp == r->stamp && ctx->classes_state == r->state &&
+         ctx->classes_from == from && ctx->classes_to == to ) {
+        return &ctx->classes[r->offset - from];
+    }
+
+    if ( to - from > ctx->classes_cap ) {
+        size_t newcap = ctx->classes_cap ? ctx->classes_cap : 256;
+        while ( newcap < to - from ) { newcap *= 2; }
+        uint8_t* grown = (uint8_t*)realloc(ctx->classes, newcap);
+        if ( grown == NULL ) { return NULL; }
+        ctx->classes = grown;
+        ctx->classes_cap = newcap;
+    }
+
+    if ( filebuf_highlight(&fbuf, r->lineno - fbuf->view->headline, from, to, ctx->classes) != ERR_NONE ) {
+        ctx->classes_stamp = 0;
+        return NULL;
+    }
+
+    ctx->classes_stamp = r->stamp;
+    ctx->classes_state = r->state;
+    ctx->classes_from = from;
+    ctx->classes_to = to;
+
+    return &ctx->classes[r->offset - from];
+
+}
+
+static void windowman_draw_row(windowman_t* ctx, filebuf* fbuf, size_t row, int digits) {
+
+    const windowman_row* r = &ctx->layout[row];
+    int y = (int)row + 2;
+
+    termscreen* screen = ctx->screen;
+    termscreen_clear_row(screen, y, 0);
+
+    // the number goes on the first row of each line
+    bool first = row == 0 || ctx->layout[row-1].lb != r->lb;
+    if ( r->lb != NULL && first ) {
+        char num[24];
+        int n = snprintf(num, sizeof(num), "%zu", r->lineno);
+        termscreen_put(screen, y, 0, num, n, 0);
+    }
+    termscreen_vrule(screen, y, digits+1);
+
+    const uint8_t* classes = (r->lb != NULL && r->len > 0) ? windowman_row_classes(ctx, fbuf, row) : NULL;
+    if ( classes != NULL ) {
+        // one write per run of bytes with the same color; classes[0] is the
+        // row's first byte
+        size_t i = 0;
+        while ( i < r->len ) {
+            size_t j = i + 1;
+            while ( j < r->len && classes[j] == classes[i] ) { j += 1; }
+            termscreen_put(screen, y, digits + 2 + (int)i, &r->lb->line[r->offset + i], (int)(j - i), classes[i]);
+            i = j;
+        }
+    } else if ( r->lb != NULL && r->len > 0 ) {
+        termscreen_put(screen, y, digits+2, &r->lb->line[r->offset], (int)r->len, 0);
+    }
+
+    // Highlight character at cursor position
+    if ( row == ctx->cursor_y && ctx->cursor_x + (size_t)(digits+2) < ctx->win_width ) {
+        termscreen_invert(screen, y, (int)ctx->cursor_x + digits + 2);
+    }
+
+    ctx->drawn[row] = *r;
+    ctx->rows_drawn += 1;
+
+}
+
+// short human-readable byte count
+static void windowman_bytes_str(char* buf, size_t buflen, size_t bytes) {
+    if ( bytes >= ((size_t)1 << 30) ) {
+        snprintf(buf, buflen, "%.1fG", (double)bytes / (double)((size_t)1 << 30));
+    } else if ( bytes >= ((size_t)1 << 20) ) {
+        snprintf(buf, buflen, "%.1fM", (double)bytes / (double)((size_t)1 << 20));
+    } else {
+        snprintf(buf, buflen, "%.1fK", (double)bytes / 1024.0);
+    }
+}
+
+// the last frame's cost and where the text lives: bytes before and after
+// the viewport and the bytes the viewport's lines hold
+static void windowman_draw_hud(windowman_t* ctx, filebuf* fbuf) {
+
+    const framestats* st = ctx->stats;
+
+    size_t held = 0;
+    for ( size_t i = 0; i < fbuf->view->lines; i++ ) { held += viewbuf_line(fbuf->view, i)->cap; }
+
+    char pre[16], post[16], lines[16];
+    windowman_bytes_str(pre, sizeof(pre), fbuf->prewindow_len);
+    windowman_bytes_str(post, sizeof(post), fbuf->postwindow_len);
+    windowman_bytes_str(lines, sizeof(lines), held);
+
+    char hud[160];
+    int len = snprintf(hud, sizeof(hud), " %8.3f ms | %3zu rows | %5zu cells | %3zu allocs %2zu malloc | pre %s post %s lines %s ",
+                       (double)st->last_ns / 1e6, st->last_rows, st->last_cells, st->last_allocs, st->last_mallocs,
+                       pre, post, lines);
+    if ( len < 0 ) { return; }
+
+    size_t shown = (size_t)len < ctx->win_width ? (size_t)len : ctx->win_width;
+    if ( shown < ctx->hud_len ) { termscreen_hrule(ctx->screen, 1, (int)shown, (int)(ctx->hud_len - shown)); }
+    termscreen_put(ctx->screen, 1, 0, hud, (int)shown, 0);
+    ctx->hud_len = shown;
+
+}
+
+// lay the rows out again if the view changed under them, and put the cursor
+// where an undo, a search or a run of typing left it
+static void windowman_update_layout(windowman_t* ctx, filebuf* fbuf, size_t textrows, size_t max_text) {
+
+    linebuf* head = viewbuf_head(fbuf->view);
+    if ( !ctx->layout_valid
+      || ctx->layout_text_width != max_text
+      || ctx->layout_headline != fbuf->view->headline
+      || ctx->layout_head != (head != NULL ? head->stamp : 0) ) {
+        windowman_layout(ctx, fbuf, textrows, max_text);
+    }
+
+    if ( ctx->cursor_pending ) {
+        windowman_place_cursor(ctx, fbuf, max_text);
+        // bringing the cursor into view may have scrolled sideways
+        if ( !ctx->layout_valid ) { windowman_layout(ctx, fbuf, textrows, max_text); }
+    }
+
+    // keep the cursor on a row that has text
+    if ( ctx->layout_rows > 0 && ctx->cursor_y >= ctx->layout_rows ) { ctx->cursor_y = ctx->layout_rows - 1; }
+
+}
+
+static textErr windowman_key(windowman_t* ctx, filebuf* fbuf, int keypress, size_t max_text);
+
+static bool windowman_typable(int key) {
+    return key >= 32 && key <= 126;
+}
+
+// a run of typed characters goes in with one insert; the cursor lands after
+// it when the rows are laid out again. a single key goes through here too,
+// so typing fast or slow leaves the cursor in the same place.
+static textErr windowman_type(windowman_t* ctx, filebuf* fbuf, const char* text, size_t len, size_t max_text) {
+
+    if ( ctx->cursor_y >= ctx->layout_rows ) { return ERR_NONE; }
+
+    const windowman_row* row = &ctx->layout[ctx->cursor_y];
+    if ( row->lb == NULL || !ctx->layout_valid ) { return ERR_NONE; }
+
+    size_t pos = row->offset + ctx->cursor_x;
+    if ( pos > windowman_line_width(row->lb) ) { pos = windowman_line_width(row->lb); }
+
+    size_t index = 0;
+    textErr ret = viewbuf_find(&fbuf->view, row->lb, &index);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = filebuf_insert(&fbuf, index, pos, text, len);
+    ctx->layout_valid = false;
+    if ( ret != ERR_NONE ) { return ret; }
+
+    // without wrapping, scroll sideways as each key would have
+    if ( !ctx->wrap ) {
+        for ( size_t k = 1; k <= len; k++ ) { windowman_show_column(ctx, pos + k, max_text); }
+    }
+
+    ctx->cursor_pending = true;
+    ctx->pending_line = index;
+    ctx->pending_pos = pos + len;
+
+    return ERR_NONE;
+
+}
+
+// rows a line is laid out in, and the length of its `seg`th, the way
+// windowman_layout cuts it
+static size_t windowman_line_rows(const windowman_t* ctx, const linebuf* lb, size_t max_text) {
+    size_t plen = windowman_line_width(lb);
+    if ( !ctx->wrap || max_text == 0 || plen == 0 ) { return 1; }
+    return (plen + max_text - 1) / max_text;
+}
+
+static size_t windowman_seg_len(const windowman_t* ctx, const linebuf* lb, size_t seg, size_t max_text) {
+    size_t plen = windowman_line_width(lb);
+    size_t offset = ctx->wrap ? seg * max_text : ctx->scroll_x;
+    if ( offset >= plen ) { return 0; }
+    return (plen - offset < max_text) ? plen - offset : max_text;
+}
+
+// length of the row `row` rows down from the top of view line `line`, as
+// if the view started there; 0 past the end of the view
+static size_t windowman_view_row_len(const windowman_t* ctx, filebuf* fbuf, size_t line, size_t row, size_t max_text) {
+
+    for ( ; line < fbuf->view->lines; line++ ) {
+        const linebuf* lb = viewbuf_line(fbuf->view, line);
+        size_t rows = windowman_line_rows(ctx, lb, max_text);
+        if ( row < rows ) { return windowman_seg_len(ctx, lb, row, max_text); }
+        row -= rows;
+    }
+
+    return 0;
+
+}
+
+// a run of `n` up or down keys: the cursor walks as far as it would have,
+// and the view scrolls by the rest a block of lines at a time. key by key,
+// the cursor column is cut to every row the cursor lands on, walking or
+// with the view scrolling under it, so here it is cut to the shortest of
+// those rows. a block is as many lines as can scroll past the cursor's row
+// and still be in view to measure afterwards, and stops where the gutter
+// changes width, so every row measured in it wraps the same way.
+static textErr windowman_move_rows(windowman_t* ctx, filebuf* fbuf, bool up, size_t n) {
+
+    size_t min_x = ctx->cursor_x;
+
+    size_t steps = 0;
+    if ( up ) {
+        steps = n < ctx->cursor_y ? n : ctx->cursor_y;
+    } else if ( ctx->cursor_y < ctx->win_height-4 ) {
+        size_t room = ctx->win_height-4 - ctx->cursor_y;
+        steps = n < room ? n : room;
+    }
+    for ( size_t i = 0; i < steps; i++ ) {
+        ctx->cursor_y = up ? ctx->cursor_y - 1 : ctx->cursor_y + 1;
+        if ( ctx->layout[ctx->cursor_y].len < min_x ) { min_x = ctx->layout[ctx->cursor_y].len; }
+    }
+
+    const size_t r = ctx->cursor_y;
+    size_t rest = n - steps;
+    while ( rest > 0 && fbuf->view->lines > 0 ) {
+
+        // the cursor's row before the block's first line scrolls
+        size_t headline = fbuf->view->headline;
+        size_t max_text = windowman_text_width(ctx, fbuf, headline, NULL);
+        size_t len = windowman_view_row_len(ctx, fbuf, 0, r, max_text);
+        if ( len < min_x ) { min_x = len; }
+
+        // the width every later row in the block is laid out at
+        size_t most = windowman_width_run(fbuf, headline, up);
+        if ( most > WINDOWMAN_SCROLL_BLOCK ) { most = WINDOWMAN_SCROLL_BLOCK; }
+        if ( most > fbuf->view->lines ) { most = fbuf->view->lines; }
+        size_t width = windowman_text_width(ctx, fbuf, up ? headline - 1 : headline + 1, NULL);
+
+        // going down, the lines that scroll out are gone afterwards, so
+        // note how many rows each takes
+        size_t rows[WINDOWMAN_SCROLL_BLOCK];
+        size_t block = 1;
+        if ( up ) {
+            block = rest < most ? rest : most;
+        } else {
+            size_t above = 0;
+            while ( block < rest && block < most ) {
+                size_t k = windowman_line_rows(ctx, viewbuf_line(fbuf->view, block), width);
+                if ( above + k > r ) { break; }
+                above += k;
+                rows[block++] = k;
+            }
+        }
+
+        size_t moved = 0;
+        textErr ret = filebuf_scroll_by(&fbuf, up ? -(long)block : (long)block, &moved);
+        if ( ret != ERR_EOF && ret != ERR_NONE ) { return ret; }
+        if ( moved > 0 ) { ctx->layout_valid = false; }
+
+        // the rows that came through the cursor's during the block
+        size_t below = 0;
+        for ( size_t j = moved; j-- > 1; ) {
+            if ( up ) {
+                len = windowman_view_row_len(ctx, fbuf, j, r, width);
+            } else {
+                below += rows[j];
+                len = windowman_view_row_len(ctx, fbuf, 0, r - below, width);
+            }
+            if ( len < min_x ) { min_x = len; }
+        }
+
+        // at an end, the keys left over stay on the last row
+        if ( moved < block ) {
+            len = windowman_view_row_len(ctx, fbuf, 0, r, moved > 0 ? width : max_text);
+            if ( len < min_x ) { min_x = len; }
+            break;
+        }
+        rest -= block;
+
+    }
+
+    ctx->cursor_x = min_x;
+
+    return ERR_NONE;
+
+}
+
+// page up and down move the view a screen less a line, so the cursor keeps
+// its row; once the view runs into an end the cursor goes the rest of the
+// way
+static textErr windowman_page(windowman_t* ctx, filebuf* fbuf, bool up) {
+
+    size_t page = ctx->win_height > 3 ? ctx->win_height - 3 : 1;
+
+    size_t moved = 0;
+    textErr ret = filebuf_scroll_by(&fbuf, up ? -(long)page : (long)page, &moved);
+    if ( ret != ERR_EOF && ret != ERR_NONE ) { return ret; }
+    if ( moved > 0 ) { ctx->layout_valid = false; }
+
+    size_t rest = page - moved;
+    if ( up ) {
+        ctx->cursor_y -= rest < ctx->cursor_y ? rest : ctx->cursor_y;
+    } else if ( ctx->cursor_y < ctx->win_height-4 ) {
+        size_t room = ctx->win_height-4 - ctx->cursor_y;
+        ctx->cursor_y += rest < room ? rest : room;
+    }
+
+    size_t max_x = ctx->layout[ctx->cursor_y].len;
+    if ( ctx->cursor_x > max_x ) { ctx->cursor_x = max_x; }
+
+    return ERR_NONE;
+
+}
+
+// home shows the top of the document; end the bottom, with the last line on
+// the cursor's lowest row
+static textErr windowman_home_end(windowman_t* ctx, filebuf* fbuf, bool end) {
+
+    ctx->layout_valid = false;
+    ctx->scroll_x = 0;
+
+    if ( !end ) {
+        ctx->cursor_y = 0;
+        ctx->cursor_x = 0;
+        return filebuf_goto_line(&fbuf, 1);
+    }
+
+    textErr ret = filebuf_goto_percent(&fbuf, 100);
+    if ( ret == ERR_BUSY ) {
+        snprintf(ctx->message, sizeof(ctx->message), "Still counting lines");
+        return ERR_NONE;
+    }
+    if ( ret != ERR_NONE ) { return ret; }
+
+    size_t above = 0;
+    if ( ctx->win_height > 4 ) {
+        ret = filebuf_scroll_by(&fbuf, -(long)(ctx->win_height - 4), &above);
+        if ( ret != ERR_EOF && ret != ERR_NONE ) { return ret; }
+    }
+
+    ctx->cursor_pending = true;
+    ctx->pending_line = above;
+    ctx->pending_pos = 0;
+
+    return ERR_NONE;
+
+}
+
+// apply the keys read this frame in order. the rows are laid out again
+// between keys that changed them, but nothing is drawn until they are all
+// done. outside the search prompts, runs of typed characters become one
+// insert and runs of up or down one scroll.
+static textErr windowman_keys(windowman_t* ctx, filebuf* fbuf, const int* keys, size_t n, size_t textrows) {
+
+    if ( n == 0 ) { return windowman_key(ctx, fbuf, -1, windowman_text_width(ctx, fbuf, fbuf->view->headline, NULL)); }
+
+    textErr ret = ERR_NONE;
+    size_t i = 0;
+    while ( i < n && ret == ERR_NONE && !ctx->quit ) {
+
+        // a key may have scrolled the view far enough for the gutter to
+        // need another digit, which narrows the text
+        size_t max_text = windowman_text_width(ctx, fbuf, fbuf->view->headline, NULL);
+
+        if ( i > 0 ) {
+            ret = filebuf_resize(&fbuf);
+            if ( ret != ERR_NONE ) { break; }
+            windowman_update_layout(ctx, fbuf, textrows, max_text);
+        }
+
+        int key = keys[i];
+        size_t run = 1;
+        if ( !ctx->searching && !ctx->grepping ) {
+            if ( windowman_typable(key) ) {
+                while ( i + run < n && windowman_typable(keys[i + run]) ) { run += 1; }
+            } else if ( key == TERMSCREEN_KEY_UP || key == TERMSCREEN_KEY_DOWN ) {
+                while ( i + run < n && keys[i + run] == key ) { run += 1; }
+            }
+        }
+
+        if ( run == 1 ) {
+            ret = windowman_key(ctx, fbuf, key, max_text);
+        } else if ( windowman_typable(key) ) {
+            char text[WINDOWMAN_KEY_BATCH];
+            for ( size_t k = 0; k < run; k++ ) { text[k] = (char)keys[i + k]; }
+            ret = windowman_type(ctx, fbuf, text, run, max_text);
+        } else {
+            ret = windowman_move_rows(ctx, fbuf, key == TERMSCREEN_KEY_UP, run);
+        }
+
+        i += run;
+
+    }
+
+    return ret;
+
+}
+
+static textErr windowman_frame(windowman_t* ctx, filebuf* fbuf) {
+
+    TRACE_SCOPE("render");
 
     int _h, _w;
-    getmaxyx(stdscr, _h, _w);
+    termscreen_size(ctx->screen, &_h, &_w);
+    if ( (size_t)_h != ctx->win_height || (size_t)_w != ctx->win_width ) {
+        termscreen_clear(ctx->screen);
+        ctx->full_redraw = true;
+        ctx->layout_valid = false;
+    }
     ctx->win_height = _h;
     ctx->win_width = _w;
+    ctx->rows_drawn = 0;
 
-    // clear();
-    if (fbuf->viewlines != ctx->win_height - 2) { clear(); }
+    if ( ctx->win_height < 3 ) {
+        termscreen_refresh(ctx->screen);
+        return ERR_NONE;
+    }
+
+    const size_t textrows = ctx->win_height - 2;
 
-    fbuf->viewlines = ctx->win_height - 2;
+    fbuf->viewlines = textrows;
     textErr ret = filebuf_resize(&fbuf);
     if ( ret != ERR_NONE ) { 
         return ret;
     }
 
-    // Display window size at top left
-    mvprintw(0, 0, "File: %s | Size: %zu x %zu", fbuf->fname, ctx->win_width, ctx->win_height);
+    ret = windowman_reserve_rows(ctx, textrows);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    ret = windowman_grep_poll(ctx, fbuf);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    TRACE_BEGIN("status");
+
+    // Status row: file name and window size on the left, line position on
+    // the right; the total shows up once indexing is done
+    char status[256];
+    char linepos[48];
+    size_t total_lines = 0;
+    if ( filebuf_line_count(&fbuf, &total_lines) == ERR_NONE ) {
+        snprintf(linepos, sizeof(linepos), " Line %zu/%zu", fbuf->view->headline + ctx->cursor_y, total_lines);
+        ctx->wake_ms = -1;
+    } else {
+        snprintf(linepos, sizeof(linepos), " Line %zu/...", fbuf->view->headline + ctx->cursor_y);
+        // check back for the total once indexing is done
+        ctx->wake_ms = 100;
+    }
 
-    // Non-blocking keyboard input
-    // nodelay(stdscr, TRUE);
-    timeout(1);
-    int ch = getch();
-    const int keypress = ch == ERR ? -1 : ch;
-    (void)keypress; // silence unused warning for now
-    // nodelay(stdscr, FALSE);
+    // a background save shows its progress, then how it went
+    char saving[32] = "";
+    size_t written = 0;
+    size_t total = 0;
+    ret = filebuf_save_poll(&fbuf, &written, &total);
+    if ( ret == ERR_BUSY ) {
+        snprintf(saving, sizeof(saving), " | Saving %zu%%", total ? (size_t)((double)written * 100.0 / (double)total) : 0);
+        ctx->wake_ms = 100;
+    } else if ( ret == ERR_NONE ) {
+        snprintf(ctx->message, sizeof(ctx->message), "Saved %zu bytes", total);
+    } else if ( ret != ERR_EOF ) {
+        snprintf(ctx->message, sizeof(ctx->message), "Save failed: %s", textErr_tostr(ret));
+    }
 
-    if ( keypress != ERR ) { mvprintw(0, 32, "keypress: %03d", keypress); }
-    mvprintw(0, 48, "cursor x: %ld y: %ld", ctx->cursor_x, ctx->cursor_y);
+    if ( ctx->grepping ) {
+        size_t done = 0;
+        size_t chunks = 0;
+        size_t matches = 0;
+        filebuf_grep_progress(&fbuf, &done, &chunks, &matches);
+        char scanned[32] = "";
+        if ( done < chunks ) {
+            snprintf(scanned, sizeof(scanned), " | %zu%% scanned", done * 100 / chunks);
+            // keep the count and the cursor moving while workers run
+            ctx->wake_ms = 50;
+        }
+        snprintf(status, sizeof(status), "Regex: %s | %zu%s match%s%s", ctx->grep_pattern,
+                 matches, done < chunks ? "+" : "", matches == 1 ? "" : "es", scanned);
+    } else if ( ctx->searching ) {
+        const textsearch* search = ctx->search;
+        snprintf(status, sizeof(status), "Find: %.*s%s", (int)search->len, search->pattern,
+                 search->len > 0 && search->failed ? " (not found)" : "");
+    } else {
+        snprintf(status, sizeof(status), "File: %s | Size: %zu x %zu%s%s%s%s%s", fbuf->fname, ctx->win_width, ctx->win_height,
+                 ctx->wrap ? "" : " | No wrap", fbuf->map != NULL && fbuf->map->failed ? " | Read error" : "",
+                 saving, ctx->message[0] ? " | " : "", ctx->message);
+    }
 
-    // LINES / SPACERS
+    termscreen_clear_row(ctx->screen, 0, 0);
+    termscreen_put(ctx->screen, 0, 0, status, (int)strnlen(status, ctx->win_width), 0);
+    if ( strlen(linepos) + strlen(status) < ctx->win_width ) {
+        termscreen_put(ctx->screen, 0, (int)(ctx->win_width - strlen(linepos)), linepos, (int)strlen(linepos), 0);
+    }
 
-    // Horizontal file name line
-    mvhline(1, 0, ACS_HLINE, ctx->win_width);
+    // Non-blocking keyboard input: take every key that is waiting, so keys
+    // that arrive faster than frames are drawn cost one frame between them.
+    // a key that opens a prompt ends the batch, the prompt reads what follows,
+    // and so does a paste, whose text only lasts until the next key is read.
+    int keys[WINDOWMAN_KEY_BATCH];
+    size_t nkeys = 0;
+    while ( nkeys < WINDOWMAN_KEY_BATCH ) {
+        int key = termscreen_key(ctx->screen);
+        if ( key == -1 ) { break; }
+        keys[nkeys++] = key;
+        if ( key == WINDOWMAN_KEY_GOTO || (key == WINDOWMAN_KEY_GREP && !ctx->grepping) ) { break; }
+        if ( key == TERMSCREEN_KEY_PASTE ) { break; }
+    }
+    ctx->dirty = nkeys > 0;
+    if ( nkeys > 0 ) { ctx->message[0] = '\0'; }
+    TRACE_END("status");
 
-    // Vertical LOC line
+    // LINES / SPACERS
 
-    int maxloc = (int)(fbuf->view->headline + fbuf->viewlines);
     int digits = 0;
-    do {
-        maxloc /= 10;
-        digits += 1;
-    } while ( maxloc > 0 );
+    size_t max_text = windowman_text_width(ctx, fbuf, fbuf->view->headline, &digits);
+
+    // the gutter moved, so every row is off
+    if ( digits != ctx->drawn_digits ) { ctx->full_redraw = true; }
+
+    if ( ctx->full_redraw ) {
+        // Horizontal file name line
+        termscreen_hrule(ctx->screen, 1, 0, (int)ctx->win_width);
+        for ( size_t i = 0; i < textrows; i++ ) { ctx->drawn[i].stamp = WINDOWMAN_ROW_STALE; }
+        ctx->drawn_cursor_y = SIZE_MAX;
+        ctx->drawn_digits = digits;
+        ctx->full_redraw = false;
+        ctx->hud_len = 0;
+    }
 
-    mvvline(2, digits+1, ACS_VLINE, ctx->win_height-2);
+    if ( ctx->stats != NULL ) { windowman_draw_hud(ctx, fbuf); }
 
-    // Write text and line numbers
+    // LAYOUT
 
-    int lineno = 0;
-    int lineposition = 0;
+    TRACE_BEGIN("layout");
 
-    size_t* linelen_lut = (size_t*)malloc(sizeof(size_t) * fbuf->viewlines);
-    linebuf** linebuf_lut = (linebuf**)malloc(sizeof(linebuf*) * fbuf->viewlines);
-    if ( linebuf_lut == NULL ) { return ERR_MEM; }
-    if ( linelen_lut == NULL ) { return ERR_MEM; }
+    windowman_update_layout(ctx, fbuf, textrows, max_text);
+    TRACE_END("layout");
 
-    linebuf* cur = fbuf->view->head;
-    while ( cur != NULL ) {
-        if (lineposition >= (int)(ctx->win_height - 2)) { break; }
-        if (lineno >= fbuf->viewlines) { break; }
+    // DRAW
 
-        mvprintw(lineposition+2, 0, "%zu", fbuf->view->headline+lineno);
+    TRACE_BEGIN("draw");
+    windowman_scroll_rows(ctx, textrows);
 
-        // clear line
-        move(lineposition+2, digits+2);
-        clrtoeol();
+    bool cursor_moved = ctx->cursor_x != ctx->drawn_cursor_x || ctx->cursor_y != ctx->drawn_cursor_y;
 
-        // compute printable length excluding trailing newline to avoid moving the cursor
-        size_t plen = cur->len;
-        if ( plen > 0 && cur->line[plen-1] == '\n' ) { plen -= 1; }
+    for ( size_t i = 0; i < textrows; i++ ) {
+        bool damaged = !windowman_row_equal(&ctx->drawn[i], &ctx->layout[i]);
+        if ( cursor_moved && (i == ctx->cursor_y || i == ctx->drawn_cursor_y) ) { damaged = true; }
+        if ( damaged ) { windowman_draw_row(ctx, fbuf, i, digits); }
+    }
 
-        // clip to available width
-        size_t max_text = (ctx->win_width > (size_t)(digits+2)) ? (ctx->win_width - (size_t)(digits+2)) : 0;
-        size_t to_print = (plen < max_text) ? plen : max_text;
+    ctx->drawn_cursor_x = ctx->cursor_x;
+    ctx->drawn_cursor_y = ctx->cursor_y;
+    TRACE_END("draw");
 
-        if (to_print > 0) {
-            linebuf_lut[lineposition] = cur;
-            linelen_lut[lineposition] = to_print;
-            mvprintw(lineposition+2, digits+2, "%.*s", (int)to_print, cur->line);
-        }
+    // INPUT
 
-        if ( max_text < plen ) {
-            lineposition += 1;
-            linebuf_lut[lineposition] = cur;
-            linelen_lut[lineposition] = (int)(plen-max_text);
-            for ( int j = 0; j < digits; j++ ) { mvprintw(lineposition+2, j, " "); }
-            mvprintw(lineposition+2, digits+2, "%.*s", (int)(plen-max_text), &cur->line[to_print]);
-        }
+    TRACE_BEGIN("input");
+    ret = windowman_keys(ctx, fbuf, keys, nkeys, textrows);
+    TRACE_END("input");
+
+    // a cleared screen stays as it was until the next frame redraws it
+    if ( !ctx->full_redraw ) { termscreen_refresh(ctx->screen); }
+
+    return ret;
+
+}
+
+// act on a key read by the frame just drawn; `max_text` is the width of
+// the text columns
+static textErr windowman_key(windowman_t* ctx, filebuf* fbuf, int keypress, size_t max_text) {
 
-        lineno += 1;
-        cur = cur->next;
-        lineposition += 1;
+    textErr ret = ERR_NONE;
 
+    if ( ctx->grepping && keypress != -1 ) {
+        return windowman_grep_key(ctx, fbuf, keypress);
     }
 
-    int char_at_cursor = mvinch(ctx->cursor_y+2, ctx->cursor_x+digits+2);    
-    // Highlight character at cursor position
-    attron(A_REVERSE);
-    mvaddch(ctx->cursor_y + 2, ctx->cursor_x + digits + 2, char_at_cursor);
-    attroff(A_REVERSE);
+    if ( ctx->searching ) {
+        return windowman_search_key(ctx, fbuf, keypress);
+    }
 
-    if ( keypress == KEY_RIGHT ) {
+    // only the laid out rows are read; past them there is no line
+    const windowman_row* rows = ctx->layout;
+    const linebuf* current = ctx->cursor_y < ctx->layout_rows ? rows[ctx->cursor_y].lb : NULL;
+    const size_t column = current != NULL ? rows[ctx->cursor_y].offset + ctx->cursor_x : 0;
+
+    if ( !ctx->wrap && keypress == TERMSCREEN_KEY_RIGHT && current != NULL ) {
+        if ( column < windowman_line_width(current) ) {
+            windowman_show_column(ctx, column + 1, max_text);
+        } else if ( ctx->cursor_y + 1 < ctx->layout_rows ) {
+            ctx->cursor_y += 1;
+            windowman_show_column(ctx, 0, max_text);
+        }
+    } else if ( !ctx->wrap && keypress == TERMSCREEN_KEY_LEFT ) {
+        if ( column > 0 ) {
+            windowman_show_column(ctx, column - 1, max_text);
+        } else if ( ctx->cursor_y > 0 ) {
+            ctx->cursor_y -= 1;
+            windowman_show_column(ctx, windowman_line_width(rows[ctx->cursor_y].lb), max_text);
+        }
+    } else if ( keypress == TERMSCREEN_KEY_RIGHT ) {
         ctx->cursor_x = ctx->cursor_x + 1;
-        if ( ctx->cursor_x > linelen_lut[ctx->cursor_y] ) {
-            if ( ctx->cursor_y < ctx->win_height-2 ) {
+        if ( ctx->cursor_x > rows[ctx->cursor_y].len ) {
+            if ( ctx->cursor_y + 1 < ctx->win_height-2 ) {
                 ctx->cursor_y += 1;
                 ctx->cursor_x = 0;
             } else {
-                ctx->cursor_x = linelen_lut[ctx->cursor_y];
+                ctx->cursor_x = rows[ctx->cursor_y].len;
             }
         }
         if ( ctx->cursor_x > ctx->win_width-5 ) { ctx->cursor_x = ctx->win_width-5; }
-    } else if ( keypress == KEY_LEFT ) {
+    } else if ( keypress == TERMSCREEN_KEY_LEFT ) {
         
         if ( ctx->cursor_x == 0 && ctx->cursor_y > 0 ) {
-            ctx->cursor_x = linelen_lut[ctx->cursor_y-1]-1;
+            ctx->cursor_x = rows[ctx->cursor_y-1].len-1;
             ctx->cursor_y -= 1;
         } else if ( ctx->cursor_x > 0 ) { ctx->cursor_x = ctx->cursor_x - 1; }
 
-    } else if ( keypress == KEY_DOWN ) {
+    } else if ( keypress == TERMSCREEN_KEY_DOWN ) {
         if ( ctx->cursor_y < ctx->win_height-4 ) { ctx->cursor_y = ctx->cursor_y + 1; }
         else {
             // handle scroll down
             ret = filebuf_scroll_down(&fbuf);
-            if ( ret != ERR_EOF && ret != ERR_NONE ) {
-                free(linelen_lut);
-                free(linebuf_lut);
-                return ret;
-            }
+            if ( ret != ERR_EOF && ret != ERR_NONE ) { return ret; }
+            ctx->layout_valid = false;
         }
-        size_t max_x = linelen_lut[ctx->cursor_y];
+        size_t max_x = rows[ctx->cursor_y].len;
         if (ctx->cursor_x > (int)max_x) {
             ctx->cursor_x = (int)max_x;
         }
     
-    } else if ( keypress == KEY_UP ) {
+    } else if ( keypress == TERMSCREEN_KEY_UP ) {
         if ( ctx->cursor_y > 0 ) { ctx->cursor_y = ctx->cursor_y - 1; }
         else {
             // handle scroll down
             ret = filebuf_scroll_up(&fbuf);
-            if ( ret != ERR_EOF && ret != ERR_NONE ) {
-                free(linelen_lut);
-                free(linebuf_lut);
-                return ret;
-            }
+            if ( ret != ERR_EOF && ret != ERR_NONE ) { return ret; }
+            ctx->layout_valid = false;
         }
-        size_t max_x = linelen_lut[ctx->cursor_y];
+        size_t max_x = rows[ctx->cursor_y].len;
         if (ctx->cursor_x > (int)max_x) {
             ctx->cursor_x = (int)max_x;
         }
+    } else if ( keypress == TERMSCREEN_KEY_PAGE_UP || keypress == TERMSCREEN_KEY_PAGE_DOWN ) {
+        return windowman_page(ctx, fbuf, keypress == TERMSCREEN_KEY_PAGE_UP);
+    } else if ( keypress == TERMSCREEN_KEY_HOME || keypress == TERMSCREEN_KEY_END ) {
+        return windowman_home_end(ctx, fbuf, keypress == TERMSCREEN_KEY_END);
+    } else if ( keypress == WINDOWMAN_KEY_QUIT ) {
+        ctx->quit = true;
+    } else if ( keypress == WINDOWMAN_KEY_SAVE ) {
+        ret = filebuf_save(&fbuf, fbuf->fname);
+        if ( ret == ERR_BUSY ) {
+            snprintf(ctx->message, sizeof(ctx->message), "Still saving");
+        } else if ( ret != ERR_NONE ) {
+            snprintf(ctx->message, sizeof(ctx->message), "Save failed: %s", textErr_tostr(ret));
+        }
+    } else if ( keypress == WINDOWMAN_KEY_WRAP ) {
+        ctx->wrap = !ctx->wrap;
+        ctx->scroll_x = 0;
+        ctx->cursor_x = 0;
+        ctx->layout_valid = false;
+    } else if ( keypress == WINDOWMAN_KEY_GOTO ) {
+        ctx->layout_valid = false;
+        return windowman_goto(ctx, fbuf);
+    } else if ( keypress == WINDOWMAN_KEY_FIND ) {
+        textsearch_begin(&ctx->search, windowman_cursor_offset(ctx, fbuf), false);
+        ctx->searching = true;
+    } else if ( keypress == WINDOWMAN_KEY_GREP ) {
+        size_t origin = windowman_cursor_offset(ctx, fbuf);
+        ctx->layout_valid = false;
+        return windowman_grep(ctx, fbuf, origin);
+    } else if ( keypress == WINDOWMAN_KEY_UNDO || keypress == WINDOWMAN_KEY_REDO ) {
+        bool undo = keypress == WINDOWMAN_KEY_UNDO;
+        size_t offset = 0;
+        ret = undo ? filebuf_undo(&fbuf, &offset) : filebuf_redo(&fbuf, &offset);
+        ctx->layout_valid = false;
+        if ( ret == ERR_EOF ) {
+            snprintf(ctx->message, sizeof(ctx->message), undo ? "Nothing to undo" : "Nothing to redo");
+        } else if ( ret != ERR_NONE ) {
+            return ret;
+        } else {
+            ret = windowman_show_offset(ctx, fbuf, offset);
+            if ( ret != ERR_NONE ) { return ret; }
+        }
     }
 
-    // calculate cursor index in buffer (for line manupulation)
-
-    size_t textposition = ctx->cursor_x;
-    if ( ctx->cursor_y > 0 ) {
-        for ( size_t i = ctx->cursor_y-1; i > 0; i-- ) {
-            if ( linebuf_lut[i] == linebuf_lut[ctx->cursor_y] ) {
-                textposition += (ctx->win_width - (size_t)(digits+2));
-            } else {
-                break;
-            }
-        }
+    // nothing below applies without a line under the cursor, and a scroll
+    // may have freed the lines the layout points at
+    linebuf* target = ctx->cursor_y < ctx->layout_rows ? rows[ctx->cursor_y].lb : NULL;
+    if ( target == NULL || !ctx->layout_valid ) { return ERR_NONE; }
+
+    // cursor index in the line (for line manipulation), never past its
+    // line break
+    size_t textposition = rows[ctx->cursor_y].offset + ctx->cursor_x;
+    if ( textposition > windowman_line_width(target) ) { textposition = windowman_line_width(target); }
+
+    // edits go through the filebuf so they land in the undo journal
+    size_t index = 0;
+    ret = viewbuf_find(&fbuf->view, target, &index);
+    if ( ret != ERR_NONE ) { return ret; }
+
+    // a paste goes in as one edit however big it is, and the cursor lands
+    // after it
+    if ( keypress == TERMSCREEN_KEY_PASTE ) {
+        size_t end = 0;
+        ret = filebuf_insert_bulk(&fbuf, index, textposition, ctx->screen->paste, ctx->screen->paste_len, &end);
+        ctx->layout_valid = false;
+        if ( ret != ERR_NONE ) { return ret; }
+        return windowman_show_offset(ctx, fbuf, end);
     }
 
     // insert newline at character (yikes!)
     if ( keypress == 10 ) {
 
-        mvprintw(0, 64, "enter!");
-
-        linebuf* newline;
-        ret = linebuf_init(&newline, &linebuf_lut[ctx->cursor_y]->line[textposition], linebuf_lut[ctx->cursor_y]->len-textposition);
-        if ( ret != ERR_NONE ) {
-            free(linebuf_lut);
-            free(linelen_lut);
-            return ret;
-        }
-
-        linebuf* next = linebuf_lut[ctx->cursor_y]->next;
-        linebuf_lut[ctx->cursor_y]->next = newline;
-        newline->prev = linebuf_lut[ctx->cursor_y];
-        newline->next = next;
-        next->prev = newline;
+        // the first half keeps the line break, the rest moves to a new line
+        ret = filebuf_insert(&fbuf, index, textposition, "\n", 1);
+        ctx->layout_valid = false;
+        if ( ret != ERR_NONE ) { return ret; }
 
-        linebuf_lut[ctx->cursor_y]->len = textposition;
-        linebuf_lut[ctx->cursor_y]->line[textposition] = '\0';    
-        
-        fbuf->view->lines += 1;
+        if ( ctx->cursor_y < ctx->win_height-3 ) { ctx->cursor_y += 1; }
+        ctx->cursor_x = 0;
+        ctx->scroll_x = 0;
 
     }
 
-    if ( keypress == KEY_BACKSPACE || keypress == KEY_DL ) {
+    if ( keypress == TERMSCREEN_KEY_BACKSPACE || keypress == TERMSCREEN_KEY_DELETE ) {
 
-        // shift text
-        memmove(&linebuf_lut[ctx->cursor_y]->line[textposition], &linebuf_lut[ctx->cursor_y]->line[textposition+1], linebuf_lut[ctx->cursor_y]->len-textposition);
+        // drop the character under the cursor
+        ret = filebuf_erase(&fbuf, index, textposition, 1);
+        if ( ret != ERR_NONE && ret != ERR_EOF ) { return ret; }
 
-        // insert character
-        linebuf_lut[ctx->cursor_y]->len -= 1;
-
-        // ctx->cursor_x += 1;
-
-        if ( ctx->cursor_x == 0 && ctx->cursor_y > 0 ) {
-            ctx->cursor_x = linelen_lut[ctx->cursor_y-1]-1;
+        if ( !ctx->wrap ) {
+            if ( textposition > 0 ) {
+                windowman_show_column(ctx, textposition - 1, max_text);
+            } else if ( ctx->cursor_y > 0 ) {
+                ctx->cursor_y -= 1;
+                windowman_show_column(ctx, windowman_line_width(rows[ctx->cursor_y].lb), max_text);
+            }
+        } else if ( ctx->cursor_x == 0 && ctx->cursor_y > 0 ) {
+            ctx->cursor_x = rows[ctx->cursor_y-1].len-1;
             ctx->cursor_y -= 1;
         } else if ( ctx->cursor_x > 0 ) { ctx->cursor_x = ctx->cursor_x - 1; }
 
-        if ( ctx->cursor_x > linelen_lut[ctx->cursor_y]-1 ) {
-            if ( ctx->cursor_y < ctx->win_height-2 ) {
+        if ( ctx->wrap && ctx->cursor_x > rows[ctx->cursor_y].len-1 ) {
+            if ( ctx->cursor_y + 1 < ctx->win_height-2 ) {
                 ctx->cursor_y += 1;
                 ctx->cursor_x = 0;
             } else {
-                ctx->cursor_x = linelen_lut[ctx->cursor_y]-1;
+                ctx->cursor_x = rows[ctx->cursor_y].len-1;
             }
         }
-        if ( ctx->cursor_x > ctx->win_width-5 ) { ctx->cursor_x = ctx->win_width-5; }
-
+        if ( ctx->wrap && ctx->cursor_x > ctx->win_width-5 ) { ctx->cursor_x = ctx->win_width-5; }
 
+        ctx->layout_valid = false;
 
     }
 
     // Check if keypress is a typable character
-    if (keypress >= 32 && keypress <= 126) {
-
-        // reallocate memory
-        if ( linebuf_lut[ctx->cursor_y]->cap < linebuf_lut[ctx->cursor_y]->len+1 ) {
-            size_t newcap = linebuf_lut[ctx->cursor_y]->cap*2;
-            linebuf_lut[ctx->cursor_y]->line = realloc(linebuf_lut[ctx->cursor_y]->line, newcap);
-            if ( linebuf_lut[ctx->cursor_y]->line == NULL ) {
-                return ERR_MEM;
-            }
-            linebuf_lut[ctx->cursor_y]->cap = newcap;
-        }
-
-        // shift text
-        memmove(&linebuf_lut[ctx->cursor_y]->line[textposition+1], &linebuf_lut[ctx->cursor_y]->line[textposition], linebuf_lut[ctx->cursor_y]->len-textposition);
-
-        // insert character
-        linebuf_lut[ctx->cursor_y]->line[textposition] = (char)keypress;
-        linebuf_lut[ctx->cursor_y]->len += 1;
-
-        ctx->cursor_x += 1;
-
-        if ( ctx->cursor_x >= (ctx->win_width - (size_t)(digits+2)) ) {
-            if ( ctx->cursor_y < ctx->win_height-2 ) {
-                ctx->cursor_y += 1;
-                ctx->cursor_x = 0;
-            } else {
-                ctx->cursor_x = linelen_lut[ctx->cursor_y];
-            }
-        }
-
+    if ( windowman_typable(keypress) ) {
+        char c = (char)keypress;
+        return windowman_type(ctx, fbuf, &c, 1, max_text);
     }
 
-    free(linelen_lut);
-    free(linebuf_lut);
-
+    size_t lines = fbuf->view->lines;
     ret = viewbuf_remove_empty_lines(&fbuf->view);
     if ( ret != ERR_NONE ) {
         return ret;
     }
+    if ( fbuf->view->lines != lines ) { ctx->layout_valid = false; }
 
+    return ERR_NONE;
 
-    refresh();
+}
 
-    return ERR_NONE;
+textErr windowman_render(windowman_t* ctx, filebuf* fbuf) {
+
+    if ( ctx == NULL ) { return ERR_NULL; }
+    if ( ctx->stats == NULL ) { return windowman_frame(ctx, fbuf); }
+
+    const linepool* pool = fbuf->pool;
+    size_t cells = ctx->screen->cells;
+    size_t allocs = pool->allocs;
+    size_t mallocs = pool->mallocs;
+
+    uint64_t start = framestats_now();
+    textErr ret = windowman_frame(ctx, fbuf);
+    uint64_t ns = framestats_now() - start;
+
+    framestats_record(&ctx->stats, ns, ctx->rows_drawn, ctx->screen->cells - cells,
+                      pool->allocs - allocs, pool->mallocs - mallocs);
+
+    return ret;
 
 }
 
@@ -312,9 +1259,11 @@ textErr windowman_destroy(windowman_t** inst) {
 
     if ( inst == NULL || *inst == NULL ) { return ERR_NULL; }
 
-    /* End ncurses mode and free context */
-    endwin();
-
+    /* the screen belongs to the caller */
+    textsearch_destroy(&(*inst)->search);
+    free((*inst)->classes);
+    free((*inst)->drawn);
+    free((*inst)->layout);
     free(*inst);
     *inst = NULL;
 
@@ -1,25 +1,158 @@
 #ifndef WINDOWMAN_H
 #define WINDOWMAN_H
 
-#include <ncurses.h>
+#include "termScreen.h"
+#include "frameStats.h"
 #include "textMan.h"
 #include "textErr.h"
+#include "textTrace.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+// ctrl+f
+#define WINDOWMAN_KEY_FIND 6
+// ctrl+g
+#define WINDOWMAN_KEY_GOTO 7
+// ctrl+o
+#define WINDOWMAN_KEY_SAVE 15
+// ctrl+r
+#define WINDOWMAN_KEY_GREP 18
+// ctrl+u
+#define WINDOWMAN_KEY_UNDO 21
+// ctrl+w
+#define WINDOWMAN_KEY_WRAP 23
+// ctrl+x
+#define WINDOWMAN_KEY_QUIT 24
+// ctrl+y
+#define WINDOWMAN_KEY_REDO 25
+
+// most keys read and applied in one frame
+#define WINDOWMAN_KEY_BATCH 1024
+
+// most lines a run of up or down keys scrolls in one step
+#define WINDOWMAN_SCROLL_BLOCK 64
+
+// what one text row shows: `len` bytes of `lb` starting at `offset`. rows
+// with the same stamp, offset, line number and lexer state look the same on
+// screen.
+typedef struct {
+
+    linebuf* lb;
+    size_t offset;
+    size_t len;
+
+    uint64_t stamp;
+    size_t lineno;
+
+    // state the highlighter starts the line in; an edit above can recolor a
+    // line without touching its text
+    uint32_t state;
+
+} windowman_row;
+
+// stamp of a row whose screen contents aren't known
+#define WINDOWMAN_ROW_STALE UINT64_MAX
+
 typedef struct {
 
+    // where frames are drawn and keys come from
+    termscreen* screen;
+
     size_t win_width;
     size_t win_height;
 
     size_t cursor_x;
     size_t cursor_y;
 
+    // long lines either wrap onto more rows or are cut at the window edge;
+    // without wrapping every row shows the line from column `scroll_x`
+    bool wrap;
+    size_t scroll_x;
+
+    // after an undo or redo the cursor goes to byte `pending_pos` of view
+    // line `pending_line`, once the layout shows it
+    bool cursor_pending;
+    size_t pending_line;
+    size_t pending_pos;
+
+    // set by windowman_render when a key changed the state, meaning another
+    // frame should be drawn before waiting for input
+    bool dirty;
+    bool quit;
+
+    // how long the caller may sleep before the next frame is needed to
+    // refresh something on screen, -1 for no limit
+    int wake_ms;
+
+    // shown on the status row until the next key
+    char message[64];
+
+    // while `searching`, keys edit the search pattern on the status row
+    // and the cursor follows the match
+    textsearch* search;
+    bool searching;
+
+    // while `grepping`, the filebuf's regex search runs in the background
+    // and up/down step through its matches. `grep_waiting` is set until the
+    // match after (or before) `grep_at` is known.
+    bool grepping;
+    bool grep_waiting;
+    bool grep_backward;
+    bool grep_found;
+    size_t grep_at;
+    size_t grep_origin;
+    regexsearch_match grep_match;
+    char grep_pattern[64];
+
+    // `layout` maps every text row to the slice of the view it shows and
+    // is kept across frames; edits, resizes and scrolls clear
+    // `layout_valid`. `layout_head` and `layout_headline` catch view changes
+    // made behind the renderer's back.
+    windowman_row* layout;
+    size_t layout_rows;
+    size_t layout_text_width;
+    uint64_t layout_head;
+    size_t layout_headline;
+    bool layout_valid;
+
+    // damage tracking: `drawn` is what the text rows currently show. only
+    // rows that differ from the layout get redrawn, and a viewport shift is
+    // replayed as a terminal scroll first.
+    windowman_row* drawn;
+    size_t rows_cap;
+
+    int drawn_digits;
+    size_t drawn_cursor_x;
+    size_t drawn_cursor_y;
+    bool full_redraw;
+
+    // text rows written by the last frame
+    size_t rows_drawn;
+
+    // when set, every frame is timed into it and the last frame's numbers
+    // are shown over the rule below the status row; `hud_len` is how much
+    // of the rule they cover
+    framestats* stats;
+    size_t hud_len;
+
+    // syntax colors, when the terminal has them. `classes` holds the colors
+    // of bytes [classes_from, classes_to) of the line with stamp
+    // `classes_stamp`: all the rows of it on screen, so a wrapped line is
+    // lexed once and a long one only colored where it shows.
+    bool color;
+    uint8_t* classes;
+    size_t classes_cap;
+    uint64_t classes_stamp;
+    uint32_t classes_state;
+    size_t classes_from;
+    size_t classes_to;
+
 } windowman_t;
 
-textErr windowman_init(windowman_t** inst);
+textErr windowman_init(windowman_t** inst, termscreen* screen);
 textErr windowman_render(windowman_t* ctx, filebuf* fbuf);
 textErr windowman_destroy(windowman_t** inst);
 